@@ -14,7 +14,7 @@
  * the chip. Press 'P' to enter programming mode. Once in programming mode, 
  * just copy-paste the .hex -file contents into the terminal window. 
  *
- * Note that the serial port speed is limited to only 1200bps. JTAG protocol
+ * Note that the serial port starts at 1200bps (LinkSpeed.h). JTAG protocol
  * is created by bit banging the PORTB register directly. Not making use
  * of Arduino digitalWrite method, since it proved too slow for the purpose.
  * If using on a different Arduino than my old NG, you should probably check 
@@ -88,7 +88,19 @@
 
 #include "Arduino.h"
 #include "Pic32JTAGDevice.h"
+#include "MultiPort.h"
 #include "MySerial.h"
+#include "JTAGBridge.h"
+#include "XsvfPlayer.h"
+#include "TckCalibration.h"
+#include "PackedImage.h"
+#include "RowImage.h"
+#include "TargetMonitor.h"
+#include "Script.h"
+#include "ReadOut.h"
+#include "ErasePlan.h"
+#include "Metrics.h"
+#include "LinkSpeed.h"
 
 #define VERSION_STRING F("ArduPIC32 v1.4")
 
@@ -99,19 +111,63 @@ void PrintHelp(bool conn)
     if ( conn )
     {   
         Serial.println(F("   p    - .hex program+verify mode"));
+        Serial.println(F("   r    - .hex resume program+verify"));
         Serial.println(F("   P    - .hex programming only"));
         Serial.println(F("   v    - .hex verify mode"));
+        Serial.println(F("   z    - packed image program+verify"));
+        Serial.println(F("   w    - row image program+verify (host/p32rows)"));
         Serial.println(F("   d    - dump memory"));
+        Serial.println(F("   b    - read-out to .hex"));
+        Serial.println(F("   B    - binary read-out (host/p32read)"));
         Serial.println(F("   e    - Erase flash"));
+        Serial.println(F("   E    - Erase only the pages the last image used"));
+        Serial.println(F("   k    - Calibrate TCK rate"));
+        Serial.println(F("   m    - Toggle quiet (status frame) mode"));
+        Serial.println(F("   u    - Set unit patches / serial counter"));
     }
     else
     {
         Serial.println(F("   c    - Connect PIC in programming mode"));
         Serial.println(F("   e    - JTAG MCHP_ERASE (erase flash)"));
+        Serial.println(F("   k    - Calibrate TCK rate (IDCODE only)"));
     }
+#ifdef JTAG_TRACE
+    Serial.println(F("   T    - Dump the scan trace (host/trace2vcd)"));
+#endif
+#if JTAG_PORTS > 1
+    Serial.println(F("   jN   - Continue on JTAG port N"));
+    Serial.println(F("   JN   - Erase the target on port N in the background"));
+#endif
+    Serial.println(F("   M    - Print station metrics"));
+    Serial.println(F("   s    - Set production script (runs on attach)"));
+    Serial.println(F("   g    - Run the production script now"));
     Serial.println(F("   x    - exit"));
 }
 
+void PrintMemoryPaths( uint8_t dma )
+{
+    Serial.print(F("Memory access: "));
+    if ( !dma )
+    {
+        Serial.println(F("PrAcc"));
+        return;
+    }
+    Serial.print(F("DMA"));
+    if ( dma & DMA_READ )
+    {
+        Serial.print(F(" read"));
+    }
+    if ( dma & DMA_BLOCK )
+    {
+        Serial.print(F(" block"));
+    }
+    if ( dma & DMA_WRITE )
+    {
+        Serial.print(F(" write"));
+    }
+    Serial.println();
+}
+
 void PrintPICInfo( Pic32JTAGDevice &pic32 )
 {
     if ( !pic32.GetDeviceID() || pic32.GetDeviceID() == 0xffffffff )
@@ -123,10 +179,14 @@ void PrintPICInfo( Pic32JTAGDevice &pic32 )
     else
     {
         Serial.print(F("Detected:      "));
-        Serial.print(F("PIC32MX"));
+        Serial.print(F("PIC32"));
+        Serial.print( pic32.GetFamilyName() );
         Serial.println( pic32.GetDeviceName() );
         Serial.print(F("DeviceID:      0x"));
-        Serial.println( pic32.GetDeviceID(), HEX );
+        Serial.print( pic32.GetDeviceID(), HEX );
+        Serial.print(F(" (rev "));
+        Serial.print( pic32.GetRevision() );
+        Serial.println(F(")"));
 
         Serial.print(F("Row size:      "));
         Serial.print( pic32.GetRowSize() );
@@ -134,6 +194,9 @@ void PrintPICInfo( Pic32JTAGDevice &pic32 )
         Serial.print(F("Page size:     "));
         Serial.print( pic32.GetPageSize() );
         Serial.println(F("B"));
+        Serial.print(F("RAM:           "));
+        Serial.print( pic32.GetRAMSize() );
+        Serial.println(F("B"));
 
         Serial.print(F("Boot Flash:    0x"));
         Serial.print( pic32.GetBootFlashStart(), HEX );
@@ -155,19 +218,81 @@ void PrintPICInfo( Pic32JTAGDevice &pic32 )
     }
 }
 
+    // True if an 'H' is waiting in the RX buffer, the rest is dropped
+bool MenuRequested()
+{
+    bool menu = false;
+
+    while ( Serial.available() > 0 )
+    {
+        char c = Serial.read();
+        menu |= ( c == 'H' || c == 'h' );
+    }
+    return menu;
+}
+
+void PlayXsvf()
+{
+    XsvfPlayer player( RXStreamByte );
+    uint8_t    err;
+
+    RXStreamBegin();
+    err = player.Play();
+
+    if ( err == XSVF_OK )
+    {
+        Serial.print(F("XSVF OK, commands: "));
+        Serial.println( player.CommandCount() );
+    }
+    else
+    {
+        Serial.print(F("XSVF FAIL "));
+        Serial.print( err );
+        Serial.print(F(" at command "));
+        Serial.println( player.CommandCount() );
+        ConsumeRestOfFile();
+    }
+}
+
 void setup() {
-  Serial.begin(1200);
+  LinkSpeedBegin();
+  LoadTckDelay();
 }
 
 void loop() 
 {
     Serial.println(VERSION_STRING);
 
-    Pic32JTAGDevice pic32;
+    Pic32JTAGDevice pic32( false, ActivePort );
+    TargetMonitor   monitor;
     uint32_t addr;
     bool exit = false;
-      
+
+    Serial.println(F("Waiting for target..."));
+    monitor.WaitReady( pic32 );
+    pic32.AutoDetect();
+    Serial.print(F("Attached in "));
+    Serial.print( monitor.GetLatency() );
+    Serial.println(F(" ms"));
+
     PrintPICInfo( pic32 );
+
+        // Unattended: an 'H' sent while waiting for the board
+        // gets the menu instead
+    if ( HasScript() && !MenuRequested() )
+    {
+        RunScript( pic32 );
+        if ( pic32.IsConnected() )
+        {
+            pic32.ExitPgmMode();
+        }
+        pic32.SetReset(false);
+        MetricsSessionEnd( pic32 );
+        monitor.WaitRemoved( pic32 );
+        Serial.println(F("Target removed"));
+        return;
+    }
+
     Serial.println(F("Press \"H\" to start!"));
 
         // Get back out of reset to allow PIC
@@ -177,7 +302,40 @@ void loop()
     char cmd = '!';
     while ( cmd != 'H' && cmd != 'h' )
     {
+        if ( !Serial.available() )
+        {
+                // Board swapped before anything was done with it
+            if ( monitor.Poll( pic32 ) == TARGET_ABSENT )
+            {
+                Serial.println(F("Target removed"));
+                return;
+            }
+            JTAG_PORTS_YIELD();
+            delay( ATTACH_POLL_MS );
+            continue;
+        }
         cmd = RXChar();
+
+        if ( cmd == 'B' )
+        {
+                // Host driven bit vector mode, see JTAGBridge.h
+            JTAGBridge bridge;
+            bridge.Run();
+        }
+        else if ( cmd == 'S' )
+        {
+            PlayXsvf();
+        }
+        else if ( cmd == 'L' )
+        {
+                // Start over at the rate in use, see LinkSpeed.h
+            LinkNegotiate();
+            return;
+        }
+        else if ( cmd == LINK_SYNC )
+        {
+            return;
+        }
     }
 
     pic32.SetReset(true);
@@ -219,6 +377,25 @@ void loop()
                 }
                 break;
 
+            case 'r':
+                if ( pic32.IsConnected() )
+                {
+                    HexCheckpoint_t cp;
+                    if ( LoadCheckpoint( pic32.GetDeviceID(), cp ) )
+                    {
+                        Serial.print(F("Resume after line "));
+                        Serial.println( cp.Line );
+                        Serial.println(F("Start line (Enter: the whole file)?"));
+                        HexPgm( pic32, true, true, cp.Line, cp.Addr, RXDecimal() );
+                        Serial.println(F("."));
+                    }
+                    else
+                    {
+                        Serial.println(F("No checkpoint for this device"));
+                    }
+                }
+                break;
+
             case 'v':
                 if ( pic32.IsConnected() )
                 {
@@ -228,10 +405,30 @@ void loop()
                 }
                 break;
 
+            case 'z':
+                if ( pic32.IsConnected() )
+                {
+                    Serial.println(F("Packed program+verify mode"));
+                    PackedPgm( pic32, true, true );
+                    Serial.println(F("."));
+                }
+                break;
+
+            case 'w':
+                if ( pic32.IsConnected() )
+                {
+                    Serial.println(F("Row image program+verify mode"));
+                    RowPgm( pic32, true, true );
+                    Serial.println(F("."));
+                }
+                break;
+
             case 'e':
                 if ( pic32.IsConnected() )
                 {
                     Serial.println(F("Erase"));
+                    SaveCheckpoint( 0xffffffff, 0, 0 );
+                    PatchesReset();
                     pic32.FlashOperation( NVMOP_NOP,  0x00000000, 0 );
 
                     addr = pic32.GetBootFlashStart();
@@ -248,7 +445,7 @@ void loop()
                     addr = pic32.GetProgramFlashStart();
                     Serial.print( F("Erasing: ") );
                     Serial.println( addr, HEX );
-                    pic32.FlashOperation( NVMOP_ERASE_PFM, addr, 0 );
+                    pic32.EraseProgramFlash();
                     pic32.FlashOperation( NVMOP_NOP, 0, 0 );
 
                     Serial.println(F(" - Done!"));
@@ -256,12 +453,21 @@ void loop()
                 else
                 {
                     Serial.print(F("MCHP_Erase"));
+                    SaveCheckpoint( 0xffffffff, 0, 0 );
+                    PatchesReset();
                     //pic32.CheckStatus();
                     pic32.JTAGErase();
                     Serial.println(F(" - Done!"));
                 }
                 break;
 
+            case 'E':
+                if ( pic32.IsConnected() )
+                {
+                    ErasePlanned( pic32 );
+                }
+                break;
+
             case 't':
                 if ( pic32.IsConnected() )
                 {
@@ -284,6 +490,14 @@ void loop()
                 }
                 break;
 
+            case 'b':
+            case 'B':
+                if ( pic32.IsConnected() )
+                {
+                    ReadOut( pic32, cmd == 'B' );
+                }
+                break;
+
             case 'd':
                 if ( pic32.IsConnected() )
                 {
@@ -315,11 +529,54 @@ void loop()
                     {
                         pic32.EnterPgmMode();
                         pic32.FlashOperation( NVMOP_NOP,  0x00000000, 0 );
+                        PrintMemoryPaths( pic32.SelectMemoryPaths() );
                         PrintHelp( pic32.IsConnected() );
                     }
                 }
                 break;
 
+            case 'm':
+                QuietMode = !QuietMode;
+                Serial.println( QuietMode ? F("Quiet mode") : F("Text mode") );
+                break;
+
+            case 'u':
+                SetPatches();
+                break;
+
+            case 'M':
+                PrintMetrics();
+                break;
+
+            case 's':
+                SetScript();
+                break;
+
+            case 'g':
+                RunScript( pic32 );
+                break;
+
+            case 'k':
+                Serial.println(F("TCK calibration"));
+                CalibrateTCK( pic32 );
+                break;
+
+#ifdef JTAG_TRACE
+            case 'T':
+                JTAGTraceDump();
+                break;
+#endif
+
+#if JTAG_PORTS > 1
+            case 'j':
+                exit = PortSelect( RXChar() - '0' );
+                break;
+
+            case 'J':
+                PortErase( RXChar() - '0' );
+                break;
+#endif
+
             case 'h':
             case 'H':
                 PrintHelp( pic32.IsConnected() );
@@ -341,13 +598,23 @@ void loop()
     }
 
     Serial.println(F("THE END!"));
-    while ( 1 )
+    pic32.SetReset(false);
+    MetricsSessionEnd( pic32 );
+
+#if JTAG_PORTS > 1
+        // 'j', the board stays on its port and the next session is on
+        // the new one
+    if ( pic32.GetPort() != ActivePort )
     {
-        delay(1000); 
+        return;
+    }
+#endif
 
-        pic32.SetReset(false);
-    } 
+        // Let the target run until it is unplugged, then start over
+        // for the next one
+    monitor.WaitRemoved( pic32 );
+    Serial.println(F("Target removed"));
 }
 
 
-
+
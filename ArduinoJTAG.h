@@ -31,6 +31,56 @@
 
 #include <Arduino.h>
 
+/**
+ * Number of JTAG ports. Port 0 is always on PORTB (D8..D12). With
+ * JTAG_PORTS > 1 more targets hang off PORTC (A0..A4) and PORTD
+ * (D2..D6), in the same TMS, TDI, TDO, TCK, MCLR order, and each
+ * ArduinoJTAG object drives the port it was constructed for. The pins
+ * are then reached through pointers, a few cycles more per TCK, so the
+ * default build keeps the fixed single port. See MultiPort.h.
+ */
+//#define JTAG_PORTS 3
+
+#ifndef JTAG_PORTS
+#define JTAG_PORTS 1
+#endif
+
+#if JTAG_PORTS > 3
+#error "JTAG_PORTS: only PORTB, PORTC and PORTD are available"
+#endif
+
+#if JTAG_PORTS > 1
+
+struct JTAGPins_t {
+    volatile uint8_t * Out;
+    volatile uint8_t * In;
+    volatile uint8_t * Dir;
+    uint8_t Tms;
+    uint8_t Tdi;
+    uint8_t Tdo;
+    uint8_t Tck;
+    uint8_t Mclr;
+};
+
+PROGMEM const JTAGPins_t JTAGPorts[] =
+{
+    { &PORTB, &PINB, &DDRB, 0x01, 0x02, 0x04, 0x08, 0x10 },    // D8..D12
+    { &PORTC, &PINC, &DDRC, 0x01, 0x02, 0x04, 0x08, 0x10 },    // A0..A4
+    { &PORTD, &PIND, &DDRD, 0x04, 0x08, 0x10, 0x20, 0x40 }     // D2..D6
+};
+
+#define _TMS    pins_.Out, pins_.Tms
+#define _TDI    pins_.Out, pins_.Tdi
+#define _TDO    pins_.In,  pins_.Tdo
+#define _TCK    pins_.Out, pins_.Tck
+#define _MCLR   pins_.Out, pins_.Mclr
+
+    // Called while the foreground target waits, MultiPort.h
+void PortsYield();
+#define JTAG_PORTS_YIELD() PortsYield()
+
+#else
+
 /**
  * Ports and Pins for fast lowlevel access
  */
@@ -41,6 +91,10 @@
 #define _MCLR   &PORTB, 0x10
 //#define _LED    &PORTB, 0x20 // just for debugging..
 
+#define JTAG_PORTS_YIELD()
+
+#endif
+
  /**
   * Pins as per Arduino digitalRead/digitalWrite/pinMode compatible pin index.
   */
@@ -68,26 +122,90 @@ inline bool getBIT( volatile uint8_t * PORT, uint8_t bit )
     return ((*PORT) & bit) != 0;
 }
 
+#include "JTAGTrace.h"
+
+#if JTAG_PORTS > 1 && defined(JTAG_TRACE)
+#error "JTAG_TRACE records the PORTB pins only, build it with JTAG_PORTS 1"
+#endif
+
+/**
+ * TCK timing. The delay is added to both halves of each TCK period,
+ * the safe rate depends on the wiring (voltage dividers etc.):
+ *   TCK_DELAY_NONE               as fast as the code runs
+ *   1 .. TCK_DELAY_US-1          n turns of a 3 cycle loop (~n*0.19us @16MHz)
+ *   TCK_DELAY_US + n             n microseconds
+ * Calibrated per station with the 'k' command, kept in EEPROM.
+ */
+#define TCK_DELAY_NONE     0
+#define TCK_DELAY_US       64
+#define TCK_DELAY_DEFAULT  (TCK_DELAY_US + 2)
+
+uint8_t JTAGTckDelay = TCK_DELAY_DEFAULT;
+
+inline void TckDelay( void )
+{
+    uint8_t n = JTAGTckDelay;
+
+    if ( n == TCK_DELAY_NONE )
+    {
+        return;
+    }
+    if ( n < TCK_DELAY_US )
+    {
+#ifdef __AVR__
+        asm volatile ( "1: dec %0" "\n\t" "brne 1b" : "+r" (n) );
+#else
+        while ( n-- )
+        {
+            asm volatile ( "" );
+        }
+#endif
+    }
+    else
+    {
+        delayMicroseconds( n - TCK_DELAY_US );
+    }
+}
+
 
 class ArduinoJTAG 
 {
 private:
     bool tdo_;
+#if JTAG_PORTS > 1
+    JTAGPins_t pins_;
+    uint8_t    port_;
+
+public:
+    uint8_t GetPort()
+    {
+        return port_;
+    }
+#endif
 
 protected:    
 
-    ArduinoJTAG()
+    ArduinoJTAG( uint8_t port = 0 )
     {
+#if JTAG_PORTS > 1
+        memcpy_P( &pins_, &JTAGPorts[port], sizeof(pins_) );
+        port_ = port;
+#endif
         ClearTMS();
         ClearTDI();
         ClearTCK();
         SetMCLR ();
 
+#if JTAG_PORTS > 1
+        *pins_.Dir |= pins_.Tms | pins_.Tdi | pins_.Tck | pins_.Mclr;
+        *pins_.Dir &= ~pins_.Tdo;
+#else
         pinMode( PIN_TMS,  OUTPUT );
         pinMode( PIN_TDI,  OUTPUT );
         pinMode( PIN_TDO,  INPUT  );
         pinMode( PIN_TCK,  OUTPUT );
         pinMode( PIN_MCLR, OUTPUT );
+#endif
     }
 
     inline bool ClockPulse(void)
@@ -96,13 +214,14 @@ protected:
         setBIT(_LED);
 #endif
         ClearTCK();
-        //delayMicroseconds(1);
-        tdo_ = digitalRead( PIN_TDO );
-        //tdo_ = getBIT( _TDO );
+        TckDelay();
+        tdo_ = getBIT( _TDO );
         SetTCK();
+        JTAG_TRACE_CLOCK( tdo_ );
 #ifdef _LED
         clearBIT(_LED);
 #endif
+        TckDelay();
         return tdo_;
     }
 
@@ -151,7 +270,155 @@ protected:
         clearBIT(_TDI);
     }
 
+        //
+        // TAP level scans. All of these start and end in Run-Test/Idle,
+        // and shift LSB first. Pic32JTAG is written against these only,
+        // so that the same logic can run on top of another transport
+        // (see JTAGBridge.h and host/HostJTAG.h).
+        //
+
+        // Clock a TMS sequence with TDI low, returns captured TDO.
+    uint32_t ShiftTMS(unsigned char bits, uint32_t tms)
+    {
+        uint32_t data = 0;
+        unsigned char bitnum = 0;
+
+        JTAG_TRACE_MARK( TRACE_SCAN_TMS );
+        ClearTDI();
+        while ( bits-- )
+        {
+            if ( tms & 0x01 )
+            {
+                SetTMS();
+            }
+            else
+            {
+                ClearTMS();
+            }
+            tms >>= 1;
+
+            data |= (uint32_t)ClockPulse() << bitnum;
+            ++bitnum;
+        }
+        return data;
+    }
+
+    uint32_t ScanIR(unsigned char bits, uint32_t tdi)
+    {
+        uint32_t data;
+
+        EnterShift( true );
+        data = ShiftBits( bits, tdi );
+        LeaveShift();
+        return data;
+    }
+
+    uint32_t ScanDR(unsigned char bits, uint32_t tdi)
+    {
+        uint32_t data;
+
+        EnterShift( false );
+        data = ShiftBits( bits, tdi );
+        LeaveShift();
+        return data;
+    }
+
+        // DR scan of bits+1 bits, where the first (TDI low) bit is
+        // returned in 'lead'. Used for the 33-bit FASTDATA register.
+    uint32_t ScanDR(unsigned char bits, uint32_t tdi, bool & lead)
+    {
+        uint32_t data;
+
+        EnterShift( false );
+        ClearTDI();
+        lead = ClockPulse();
+        data = ShiftBits( bits, tdi );
+        LeaveShift();
+        return data;
+    }
+
+        // Write-only variants: the captured data is not needed, so a
+        // batching transport does not have to wait for it.
+    void WriteIR(unsigned char bits, uint32_t tdi)
+    {
+        ScanIR( bits, tdi );
+    }
+
+    void WriteDR(unsigned char bits, uint32_t tdi)
+    {
+        ScanDR( bits, tdi );
+    }
+
+        // Repeat a DR scan until any of the 'mask' bits is captured
+        // set. Returns false if that did not happen in 'tries' scans.
+    bool PollDR(unsigned char bits, uint32_t tdi, uint32_t mask, uint16_t tries)
+    {
+        while ( tries-- )
+        {
+            if ( ScanDR( bits, tdi ) & mask )
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+protected:
+        // Run-Test/Idle -> Shift-DR or Shift-IR
+    void EnterShift( bool ir )
+    {
+        JTAG_TRACE_MARK( ir ? TRACE_SCAN_IR : TRACE_SCAN_DR );
+        ClearTDI();
+        SetTMS();
+        ClockPulse();
+        if ( ir )
+        {
+            ClockPulse();
+        }
+        ClearTMS();
+        ClockPulse();
+        ClockPulse();
+    }
+
+        // Shift-xR -> Exit1-xR, TMS raised on the last bit
+    uint32_t ShiftBits(unsigned char bits, uint32_t tdi)
+    {
+        uint32_t data = 0;
+        unsigned char bitnum = 0;
+
+        while ( bits-- )
+        {
+            if ( !bits )
+            {
+                SetTMS();
+            }
+
+            if ( tdi & 0x01 )
+            {
+                SetTDI();
+            }
+            else
+            {
+                ClearTDI();
+            }
+            tdi >>= 1;
+
+            data |= (uint32_t)ClockPulse() << bitnum;
+            bitnum++;
+        }
+        return data;
+    }
+
+        // Exit1-xR -> Update-xR -> Run-Test/Idle
+    void LeaveShift()
+    {
+        ClearTDI();
+        ClockPulse();
+        ClearTMS();
+        ClockPulse();
+    }
+
 };
 
 
-#endif
+#endif
@@ -0,0 +1,53 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef EEPROM_MAP_H
+#define EEPROM_MAP_H
+
+#include <avr/eeprom.h>
+
+/**
+ * Byte addresses of the settings kept in the AVR EEPROM. An erased
+ * EEPROM reads 0xFF everywhere, every user treats that as "not set".
+ */
+enum eeprom_addr_e {
+    EE_TCK_DELAY  = 0x000,  // uint8_t, ArduinoJTAG TCK delay setting
+    EE_CHECKPOINT = 0x004,  // HexCheckpoint_t, 12 bytes, HexPgm resume point
+    EE_SCRIPT     = 0x010,  // char[EE_SCRIPT_SIZE], production script
+    EE_SERIAL     = 0x050,  // PatchCounter_t, 8 bytes, serial number counter
+    EE_FOOTPRINT  = 0x058,  // Footprint_t, 39 bytes, image pages for ErasePlan
+    EE_METRICS    = 0x080,  // Metrics_t[METRICS_SLOTS], 4 x 54 bytes, station metrics
+    EE_LINK_RATE  = 0x158,  // uint8_t, LinkRates[] index the host agreed on
+};
+
+#define EE_SCRIPT_SIZE 64
+
+#define EE_ADDR(a) ((uint8_t *)(uintptr_t)(a))
+
+#endif
@@ -0,0 +1,240 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef ERASE_PLAN_H
+#define ERASE_PLAN_H
+
+#include <Arduino.h>
+#include "Pic32JTAGDevice.h"
+#include "MySerial.h"
+#include "Footprint.h"
+#include "Patch.h"
+#include "Progress.h"
+
+/**
+ * Erase planner: erases what the stored image footprint (Footprint.h)
+ * is going to write and nothing else, so a bootloader or calibration
+ * pages outside of the image survive. Of the strategies that keep all
+ * untouched pages the cheapest one is used:
+ *
+ *   PLAN_PAGES  NVMOP_ERASE_PAGE on every touched page
+ *   PLAN_PFM    the family's program flash erase, boot flash by page,
+ *               only if every program flash page is touched
+ *   PLAN_CHIP   MCHP_ERASE, only if every page is touched, or if the
+ *               device is code protected and nothing else can work
+ *
+ * The cost is the family's typical erase times plus the JTAG overhead
+ * of one FlashOperation(), measured on the spot.
+ */
+
+enum erase_plan_e {
+    PLAN_NONE = 0,
+    PLAN_PAGES,
+    PLAN_PFM,
+    PLAN_CHIP
+};
+
+struct ErasePlan_t {
+    uint8_t  Kind;
+    uint16_t PfmPages;      // touched pages
+    uint8_t  BfmPages;
+    uint32_t Ms;            // estimate
+};
+
+uint16_t PlanCountPages( const uint8_t *map, uint16_t n )
+{
+    uint16_t i, count = 0;
+
+    for ( i = 0; i < n; ++i )
+    {
+        count += FootprintPage( map, i );
+    }
+    return count;
+}
+
+    // False if there is no footprint of this device to plan from
+bool MakeErasePlan( Pic32JTAGDevice & pic32, ErasePlan_t & plan )
+{
+    uint32_t pageSize = pic32.GetPageSize();
+    uint16_t pfmTotal = pic32.GetProgramFlashMemorySize() / pageSize;
+    uint8_t  bfmTotal = pic32.GetBootFlashMemorySize() / pageSize;
+    uint32_t opMs     = 0;
+    uint32_t pageMs, cost;
+
+    plan.Kind = PLAN_NONE;
+    if ( !pic32.IsConnected() )
+    {
+        if ( pic32.NeedsErase() )
+        {
+            plan.Kind = PLAN_CHIP;
+            plan.Ms   = pic32.GetEraseAllMs();
+            return true;
+        }
+    }
+    if ( !FootprintLoad( pic32.GetDeviceID() ) ||
+         pfmTotal > FOOTPRINT_PFM_PAGES || bfmTotal > FOOTPRINT_BFM_PAGES )
+    {
+        return false;
+    }
+
+        // Connected the way ScriptConnect() and 'c' do it, once there
+        // is a plan to make
+    if ( !pic32.IsConnected() )
+    {
+        pic32.EnterPgmMode();
+        pic32.FlashOperation( NVMOP_NOP, 0, 0 );
+        pic32.SelectMemoryPaths();
+    }
+
+    opMs = millis();
+    pic32.FlashOperation( NVMOP_NOP, 0, 0 );
+    opMs = millis() - opMs;
+
+    plan.PfmPages = PlanCountPages( Footprint.Pfm, pfmTotal );
+    plan.BfmPages = PlanCountPages( Footprint.Bfm, bfmTotal );
+    pageMs        = pic32.GetPageEraseMs() + opMs;
+
+    plan.Kind = PLAN_PAGES;
+    plan.Ms   = (plan.PfmPages + plan.BfmPages) * pageMs;
+
+    if ( plan.PfmPages == pfmTotal )
+    {
+        cost = pic32.GetEraseAllMs() + opMs + plan.BfmPages * pageMs;
+        if ( cost < plan.Ms )
+        {
+            plan.Kind = PLAN_PFM;
+            plan.Ms   = cost;
+        }
+        if ( plan.BfmPages == bfmTotal )
+        {
+                // Leaving and entering programming mode around it
+            cost = pic32.GetEraseAllMs() + 2 * opMs;
+            if ( cost < plan.Ms )
+            {
+                plan.Kind = PLAN_CHIP;
+                plan.Ms   = cost;
+            }
+        }
+    }
+    return true;
+}
+
+void ErasePages( Pic32JTAGDevice & pic32, const uint8_t *map, uint16_t n, uint32_t start )
+{
+    uint16_t i;
+
+    for ( i = 0; i < n; ++i )
+    {
+        if ( FootprintPage( map, i ) )
+        {
+            pic32.FlashOperation( NVMOP_ERASE_PAGE, start + i * pic32.GetPageSize(), 0 );
+            pic32.FlashOperation( NVMOP_NOP, 0, 0 );
+        }
+    }
+}
+
+    // Plans and erases, false if there is no footprint to plan from
+bool ErasePlanned( Pic32JTAGDevice & pic32 )
+{
+    ErasePlan_t plan;
+    uint32_t    start = millis();
+
+    if ( !MakeErasePlan( pic32, plan ) )
+    {
+        if ( !QuietMode )
+        {
+            Serial.println(F("No footprint, send the image with 'n' first"));
+        }
+        return false;
+    }
+
+    if ( !QuietMode )
+    {
+        Serial.print(F("Erase plan: "));
+        if ( plan.Kind == PLAN_CHIP )
+        {
+            Serial.print(F("chip erase"));
+        }
+        else
+        {
+            if ( plan.Kind == PLAN_PFM )
+            {
+                Serial.print(F("program flash, "));
+            }
+            else
+            {
+                Serial.print( plan.PfmPages );
+                Serial.print(F(" program, "));
+            }
+            Serial.print( plan.BfmPages );
+            Serial.print(F(" boot pages"));
+        }
+        Serial.print(F(", ~"));
+        Serial.print( plan.Ms );
+        Serial.println(F(" ms"));
+    }
+
+    SaveCheckpoint( 0xffffffff, 0, 0 );
+    PatchesReset();
+
+    if ( plan.Kind == PLAN_CHIP )
+    {
+        if ( pic32.IsConnected() )
+        {
+            pic32.ExitPgmMode();
+        }
+        pic32.JTAGErase();
+        pic32.EnterPgmMode();
+        pic32.FlashOperation( NVMOP_NOP, 0, 0 );
+        pic32.SelectMemoryPaths();
+    }
+    else
+    {
+        if ( plan.Kind == PLAN_PFM )
+        {
+            pic32.EraseProgramFlash();
+            pic32.FlashOperation( NVMOP_NOP, 0, 0 );
+        }
+        else
+        {
+            ErasePages( pic32, Footprint.Pfm, FOOTPRINT_PFM_PAGES, FOOTPRINT_PFM_START );
+        }
+        ErasePages( pic32, Footprint.Bfm, FOOTPRINT_BFM_PAGES, FOOTPRINT_BFM_START );
+    }
+
+    if ( !QuietMode )
+    {
+        Serial.print(F(" - Done! "));
+        Serial.print( millis() - start );
+        Serial.println(F(" ms"));
+    }
+    return true;
+}
+
+#endif
@@ -0,0 +1,492 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef FLASH_WRITER_H
+#define FLASH_WRITER_H
+
+#include <Arduino.h>
+#include "Pic32JTAGDevice.h"
+#include "Progress.h"
+#include "Patch.h"
+#include "Footprint.h"
+
+/**
+ * Word sink shared by the image loaders: programs and/or verifies flash.
+ *
+ * Programming goes by row (NVMOP_WRITE_ROW). Words are stored straight
+ * into a row buffer in target RAM as they arrive and only a bitmap of
+ * the words seen is kept here, so no row is ever held on the AVR. A row
+ * is closed when it is full or the address leaves it; the words never
+ * sent are filled with 0xFFFFFFFF and the row then waits in its buffer
+ * while the next one fills the other. It is programmed by Commit(),
+ * which HexPgm() calls once a record's checksum is good, or when yet
+ * another row is closed. Rows of nothing but 0xFFFFFFFF are not
+ * programmed.
+ *
+ * Verify goes by row too, programmed or not: a loop in target RAM
+ * compares the row with its buffer (Pic32JTAGDevice::CompareRow()) and
+ * only a mismatch count and map come back, not the flash words. In
+ * verify-only sessions the words an image leaves out are copied from
+ * flash into the buffer, so they always match.
+ *
+ * Dry-run sessions, and devices without the RAM for two row buffers
+ * (and the compare loop), use aligned chunks of the family's widest
+ * write instead (Pic32JTAGDevice::WriteWide()), so on MZ a quad word is
+ * never programmed twice. Verify follows the write. A chunk is written
+ * as soon as it fills, so there Commit() holds nothing back and a
+ * record or block that fails its check may already be partly in flash.
+ *
+ * Per-device patches (Patch.h) override the image words they hit and
+ * are folded into the row or chunk they fall in, image data or not.
+ * Finish() writes the rest and counts the serial number up.
+ *
+ * Every word Put() also marks its erase page in the Footprint.
+ *
+ * A PrAcc poll timeout (Pic32JTAG::XferInstruction()) leaves the target
+ * out of step with the instructions fed to it, so once one happens
+ * Put(), Commit() and Finish() fail and FailStatus() says why.
+ *
+ * Static RAM: rowMap_ is ROW_MAP_BYTES (one bit per word of the largest
+ * row, 512 words on MZ), the rest of the object about 40 bytes. Images
+ * are expected in address order, as the toolchains write them, a row
+ * that is left and entered again is programmed twice.
+ */
+
+#define ROW_MAP_BYTES     64
+#define ROW_NONE          0xffffffff
+#define VERIFY_REPORT_MAX 8     // mismatching words printed per row
+
+class FlashWriter {
+
+private:
+    Pic32JTAGDevice & pic32_;
+    bool              program_;
+    bool              verify_;
+    uint32_t          written_;
+    uint16_t          opened_;    // rows or chunks started
+    uint16_t          timeouts_;  // GetPollTimeouts() at the start
+
+        // Chunk mode
+    uint32_t          chunk_[4];
+    uint32_t          chunkAddr_;
+    uint8_t           chunkWords_;
+    uint8_t           pending_;   // bitmap of chunk_ words Put() so far
+
+        // Row mode
+    bool              rows_;
+    uint16_t          rowWords_;
+    uint32_t          rowAddr_;   // open row or ROW_NONE
+    uint8_t           rowBuf_;    // its buffer, 0 or 1
+    uint16_t          rowCount_;  // distinct words in it
+    bool              rowUsed_;   // any of them not 0xFFFFFFFF
+    uint8_t           rowMap_[ROW_MAP_BYTES];
+    uint32_t          waitAddr_;  // closed row in the other buffer or ROW_NONE
+    bool              waitUsed_;
+
+        // Starts a blank chunk with the patches that fall inside it
+    void Open( uint32_t base )
+    {
+        uint8_t i;
+
+        chunkAddr_ = base;
+        ++opened_;
+        for ( i = 0; i < chunkWords_; ++i )
+        {
+            chunk_[i] = 0xffffffff;
+            if ( PatchFind( base + 4 * i, chunk_[i] ) )
+            {
+                pending_ |= 1 << i;
+            }
+        }
+    }
+
+    bool PutChunk( uint32_t addr, uint32_t word )
+    {
+        uint32_t base = addr & ~((uint32_t)chunkWords_ * 4 - 1);
+        uint8_t  i    = (addr - base) / 4;
+
+        if ( pending_ && base != chunkAddr_ && !FlushChunk() )
+        {
+            return false;
+        }
+        if ( !pending_ )
+        {
+            Open( base );
+        }
+
+        chunk_[i]  = word;
+        pending_  |= 1 << i;
+
+        if ( pending_ == (1 << chunkWords_) - 1 )
+        {
+            return FlushChunk();
+        }
+        return true;
+    }
+
+        // Writes and verifies a partly filled chunk
+    bool FlushChunk()
+    {
+        uint8_t i;
+        bool    blank = true;
+
+        if ( !pending_ )
+        {
+            return true;
+        }
+
+        for ( i = 0; i < chunkWords_; ++i )
+        {
+            blank &= chunk_[i] == 0xffffffff;
+        }
+        if ( program_ && !blank )
+        {
+            pic32_.WriteWide( chunkAddr_, chunk_ );
+            written_ += 4 * chunkWords_;
+        }
+
+        for ( i = 0; verify_ && i < chunkWords_; ++i )
+        {
+            uint32_t addr = chunkAddr_ + 4 * i;
+
+            if ( (pending_ & (1 << i)) &&
+                 !Compare( addr, chunk_[i], pic32_.ReadFlashData( addr ) ) )
+            {
+                pending_ = 0;
+                return false;
+            }
+        }
+
+        pending_ = 0;
+        if ( !LinkOk() )
+        {
+            return false;
+        }
+        if ( program_ )
+        {
+            PatchesApplied( chunkAddr_, 4 * chunkWords_ );
+        }
+        return true;
+    }
+
+    bool Compare( uint32_t addr, uint32_t expect, uint32_t fdata )
+    {
+        if ( expect != fdata && !QuietMode )
+        {
+            Serial.print (F("Verify failed at 0x"));
+            Serial.println ( addr, HEX );
+            Serial.print ( F(" 0x"));
+            Serial.print ( fdata, HEX );
+            Serial.print ( F(" <> 0x") );
+            Serial.print ( expect, HEX );
+            Serial.println();
+        }
+        return expect == fdata;
+    }
+
+    uint16_t RowBytes() const { return rowWords_ * 4; }
+
+        // Target RAM offset of row buffer 0 or 1
+    uint16_t RowBase( uint8_t buf ) const { return buf * RowBytes(); }
+
+        // Target RAM offset of the compare loop, above both buffers
+    uint16_t CompareBase() const
+    {
+        return (RowBase( 2 ) + ROW_COMPARE_ALIGN - 1) & ~(ROW_COMPARE_ALIGN - 1);
+    }
+
+        // Prints the words the compare map marks in the row at addr,
+        // the first VERIFY_REPORT_MAX of them, then how many there are
+    bool ReportRow( uint32_t addr, uint16_t base, uint16_t bad )
+    {
+        uint32_t map = 0;
+        uint16_t i;
+        uint8_t  shown = 0;
+
+        if ( QuietMode )
+        {
+            return false;
+        }
+        for ( i = 0; i < rowWords_ && shown < VERIFY_REPORT_MAX; ++i )
+        {
+            if ( i % 32 == 0 )
+            {
+                map = pic32_.CompareMap( i / 32 );
+            }
+            if ( map & (1UL << (i % 32)) )
+            {
+                Compare( addr + 4 * i,
+                         pic32_.ReadFlashData( 0xA0000000 + base + 4 * i ),
+                         pic32_.ReadFlashData( addr + 4 * i ) );
+                ++shown;
+            }
+        }
+        Serial.print( bad );
+        Serial.println(F(" word(s) differ in the row"));
+        return false;
+    }
+
+    void RowWord( uint16_t i, uint32_t word )
+    {
+        pic32_.RowBufferWord( RowBase( rowBuf_ ), i, word );
+        if ( !(rowMap_[i / 8] & (1 << (i % 8))) )
+        {
+            rowMap_[i / 8] |= 1 << (i % 8);
+            ++rowCount_;
+        }
+        rowUsed_ |= word != 0xffffffff;
+    }
+
+        // Starts an empty row with the patches that fall inside it
+    void OpenRow( uint32_t base )
+    {
+        uint8_t i;
+
+        rowAddr_  = base;
+        ++opened_;
+        rowCount_ = 0;
+        rowUsed_  = false;
+        memset( rowMap_, 0, (rowWords_ + 7) / 8 );
+
+        for ( i = 0; i <= PATCH_COUNTER; ++i )
+        {
+            if ( PatchUsed( i ) && Patches.Item[i].Addr - base < RowBytes() )
+            {
+                RowWord( (Patches.Item[i].Addr - base) / 4, Patches.Item[i].Value );
+            }
+        }
+    }
+
+        // The open row becomes the waiting one, holes filled
+    bool CloseRow()
+    {
+        uint16_t i;
+
+        if ( !Commit() )
+        {
+            return false;
+        }
+        if ( rowUsed_ || verify_ )
+        {
+            for ( i = 0; rowCount_ < rowWords_; ++i )
+            {
+                if ( !(rowMap_[i / 8] & (1 << (i % 8))) )
+                {
+                        // Verify only: what flash holds, not part of the image
+                    RowWord( i, program_ ? 0xffffffff
+                                         : pic32_.ReadFlashData( rowAddr_ + 4 * i ) );
+                }
+            }
+            waitAddr_ = rowAddr_;
+            waitUsed_ = rowUsed_;
+            rowBuf_  ^= 1;
+        }
+        rowAddr_ = ROW_NONE;
+        return true;
+    }
+
+    bool PutRow( uint32_t addr, uint32_t word )
+    {
+        uint32_t base = addr & ~((uint32_t)RowBytes() - 1);
+
+        if ( rowAddr_ != ROW_NONE && base != rowAddr_ && !CloseRow() )
+        {
+            return false;
+        }
+        if ( rowAddr_ == ROW_NONE )
+        {
+            OpenRow( base );
+        }
+
+        RowWord( (addr - base) / 4, word );
+
+        if ( rowCount_ == rowWords_ )
+        {
+            return CloseRow();
+        }
+        return true;
+    }
+
+public:
+    FlashWriter( Pic32JTAGDevice & pic32, bool program, bool verify ):
+        pic32_(pic32),
+        program_(program),
+        verify_(verify),
+        written_(0),
+        opened_(0),
+        timeouts_(pic32.GetPollTimeouts()),
+        chunkAddr_(0),
+        chunkWords_(pic32.GetWriteBytes() / 4),
+        pending_(0),
+        rowWords_(pic32.GetRowSize() / 4),
+        rowAddr_(ROW_NONE),
+        rowBuf_(0),
+        rowCount_(0),
+        rowUsed_(false),
+        waitAddr_(ROW_NONE),
+        waitUsed_(false)
+    {
+        rows_ = (program || verify) && rowWords_ <= 8 * ROW_MAP_BYTES &&
+                pic32.GetRAMSize() >= ( verify ? (uint32_t)CompareBase() + ROW_COMPARE_BYTES
+                                               : 2UL * RowBytes() );
+        PatchesBegin();
+        FootprintBegin( pic32.GetDeviceID(), pic32.GetPageSize() );
+    }
+
+        // False (after printing the mismatch) if the verify failed
+    bool Put( uint32_t addr, uint32_t word )
+    {
+        if ( !LinkOk() )
+        {
+            return false;
+        }
+        FootprintMark( addr );
+        PatchFind( addr, word );
+
+        return rows_ ? PutRow( addr, word ) : PutChunk( addr, word );
+    }
+
+        // Programs and verifies the waiting row, if any
+    bool Commit()
+    {
+        uint32_t addr = waitAddr_;
+        uint16_t base = RowBase( rowBuf_ ^ 1 );
+        uint16_t i;
+        uint16_t bad;
+
+        if ( addr == ROW_NONE )
+        {
+            return true;
+        }
+        waitAddr_ = ROW_NONE;
+
+        if ( program_ && waitUsed_ )
+        {
+            pic32_.FlashOperation( NVMOP_WRITE_ROW, addr, base );
+            written_ += RowBytes();
+        }
+        if ( verify_ )
+        {
+            i = pic32_.CompareRow( addr, base, rowWords_, CompareBase(), bad );
+            if ( i == ROW_COMPARE_FAILED )
+            {
+                if ( !QuietMode )
+                {
+                    Serial.print(F("Row compare did not run at 0x"));
+                    Serial.println( addr, HEX );
+                }
+                return false;
+            }
+            if ( i < rowWords_ )
+            {
+                return ReportRow( addr, base, bad );
+            }
+        }
+        if ( !LinkOk() )
+        {
+            return false;
+        }
+        if ( program_ )
+        {
+            PatchesApplied( addr, RowBytes() );
+        }
+        return true;
+    }
+
+        // Writes and verifies everything Put() so far
+    bool Flush()
+    {
+        if ( !rows_ )
+        {
+            return FlushChunk();
+        }
+        if ( rowAddr_ != ROW_NONE && !CloseRow() )
+        {
+            return false;
+        }
+        return Commit();
+    }
+
+        // End of a good image: the patches it did not cover, then the
+        // serial counter. False if a verify failed
+    bool Finish()
+    {
+        uint8_t i;
+
+        if ( !Flush() || !LinkOk() )
+        {
+            return false;
+        }
+        for ( i = 0; i <= PATCH_COUNTER; ++i )
+        {
+            if ( PatchUsed( i ) && !(Patches.Applied & (1 << i)) )
+            {
+                if ( !Put( Patches.Item[i].Addr, Patches.Item[i].Value ) || !Flush() )
+                {
+                    return false;
+                }
+            }
+        }
+        if ( program_ )
+        {
+            PatchesCommit();
+        }
+        return true;
+    }
+
+        // True while Put() data is not yet in flash
+    bool Pending() const
+    {
+        return pending_ != 0 || rowAddr_ != ROW_NONE || waitAddr_ != ROW_NONE;
+    }
+
+        // Changes whenever a Put() starts a new row or chunk
+    uint16_t Opened() const { return opened_; }
+
+    uint32_t BytesWritten() const { return written_; }
+
+        // No PrAcc poll timed out since the writer was made
+    bool LinkOk() { return pic32_.GetPollTimeouts() == timeouts_; }
+
+        // Why Put(), Commit() or Finish() failed, a status_error_e
+    uint8_t FailStatus()
+    {
+        if ( LinkOk() )
+        {
+            return STATUS_VERIFY;
+        }
+        if ( !QuietMode )
+        {
+            Serial.println(F("PrAcc timeout, the target is out of step"));
+        }
+        return STATUS_PRACC;
+    }
+};
+
+#endif
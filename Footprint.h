@@ -0,0 +1,120 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef FOOTPRINT_H
+#define FOOTPRINT_H
+
+#include <Arduino.h>
+#include "EepromMap.h"
+#include "Pic32.h"
+
+/**
+ * Footprint of an image: the erase pages it writes to, one bit per
+ * page. FlashWriter marks the pages as words go by, a session that
+ * completes saves the map to EEPROM for the erase planner (ErasePlan.h)
+ * so a dry run ('n') of the image is enough to plan its erase, also
+ * after a power cycle.
+ */
+
+#define FOOTPRINT_PFM_PAGES 256
+#define FOOTPRINT_BFM_PAGES 16
+
+#define FOOTPRINT_PFM_START 0x1D000000
+#define FOOTPRINT_BFM_START 0x1FC00000
+
+struct Footprint_t {
+    uint32_t DevID;     // without revision, the page size depends on it
+    uint8_t  Overflow;  // pages beyond the map were written
+    uint8_t  Pfm[FOOTPRINT_PFM_PAGES / 8];
+    uint8_t  Bfm[FOOTPRINT_BFM_PAGES / 8];
+};
+
+Footprint_t Footprint;
+uint32_t    FootprintPageSize;
+uint32_t    FootprintLastPage;
+
+void FootprintBegin( uint32_t devID, uint32_t pageSize )
+{
+    memset( &Footprint, 0, sizeof(Footprint) );
+    Footprint.DevID   = devID & ~PIC32_REVISION_MASK;
+    FootprintPageSize = pageSize;
+    FootprintLastPage = 0xffffffff;
+}
+
+void FootprintMark( uint32_t addr )
+{
+    uint32_t page = addr & ~(FootprintPageSize - 1);
+    uint32_t n;
+
+        // Only the first word of each page pays for the division
+    if ( page == FootprintLastPage )
+    {
+        return;
+    }
+    FootprintLastPage = page;
+
+    if ( page >= FOOTPRINT_BFM_START )
+    {
+        n = (page - FOOTPRINT_BFM_START) / FootprintPageSize;
+        if ( n < FOOTPRINT_BFM_PAGES )
+        {
+            Footprint.Bfm[n / 8] |= 1 << (n % 8);
+            return;
+        }
+    }
+    else if ( page >= FOOTPRINT_PFM_START )
+    {
+        n = (page - FOOTPRINT_PFM_START) / FootprintPageSize;
+        if ( n < FOOTPRINT_PFM_PAGES )
+        {
+            Footprint.Pfm[n / 8] |= 1 << (n % 8);
+            return;
+        }
+    }
+    Footprint.Overflow = 1;
+}
+
+void FootprintSave()
+{
+    eeprom_update_block( &Footprint, EE_ADDR(EE_FOOTPRINT), sizeof(Footprint) );
+}
+
+    // False unless a footprint of this device is stored
+bool FootprintLoad( uint32_t devID )
+{
+    eeprom_read_block( &Footprint, EE_ADDR(EE_FOOTPRINT), sizeof(Footprint) );
+    return Footprint.DevID == (devID & ~PIC32_REVISION_MASK) && !Footprint.Overflow;
+}
+
+bool FootprintPage( const uint8_t *map, uint16_t n )
+{
+    return map[n / 8] & (1 << (n % 8));
+}
+
+#endif
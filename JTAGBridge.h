@@ -0,0 +1,253 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef JTAG_BRIDGE_H
+#define JTAG_BRIDGE_H
+
+#include <Arduino.h>
+#include "ArduinoJTAG.h"
+#include "MySerial.h"
+
+/**
+ * Bridge mode: ArduinoJTAG exposed over the serial line as a batched
+ * bit vector shifter. All the PIC32 knowledge stays on the host (see
+ * host/BridgeLink.h), the Arduino only replays the vectors.
+ *
+ * Frames, multibyte values little endian. Vector bits are packed LSB
+ * first, eight bits per {tms,tdi,cap} byte triplet:
+ *
+ *   'V' n:u16 {tms,tdi,cap}*((n+7)/8)
+ *        Shift n bits. Replies the captured TDO bits packed LSB first,
+ *        (popcount(cap)+7)/8 bytes.
+ *   'P' n:u8 tries:u16 {tms,tdi,cap}*((n+7)/8)      (n <= 64)
+ *        Repeat the vector until any captured TDO bit reads one.
+ *   'R' level:u8   Drive MCLR to the given level.
+ *   'W' ms:u16     Wait.
+ *   'S'            Sync, replies "AP32" and BRIDGE_VERSION.
+ *   'X'            Leave bridge mode.
+ *
+ * Every frame is finished with one status byte. The host counts them
+ * to keep no more than the serial RX buffer's worth of data in flight.
+ */
+
+#define BRIDGE_VERSION       1
+#define BRIDGE_MAX_POLL_BITS 64
+
+enum bridge_status_e {
+    BRIDGE_OK           = 0x00,
+    BRIDGE_POLL_TIMEOUT = 0x01,
+    BRIDGE_BAD_FRAME    = 0xEE
+};
+
+class JTAGBridge: public ArduinoJTAG {
+
+private:
+    uint8_t out_;
+    uint8_t outBits_;
+
+    uint16_t RXWordLE()
+    {
+        uint8_t lo = RXChar();
+        uint8_t hi = RXChar();
+        return ((uint16_t)hi << 8) | lo;
+    }
+
+    void PutTDO( bool tdo )
+    {
+        if ( tdo )
+        {
+            out_ |= (1 << outBits_);
+        }
+        if ( ++outBits_ == 8 )
+        {
+            Serial.write( out_ );
+            out_     = 0;
+            outBits_ = 0;
+        }
+    }
+
+        // Clock up to eight bits, returns true if any captured TDO was set
+    bool ShiftByte( uint8_t n, uint8_t tms, uint8_t tdi, uint8_t cap, bool reply )
+    {
+        bool any = false;
+        uint8_t m;
+
+        for ( m = 1; n--; m <<= 1 )
+        {
+            if ( tms & m )
+            {
+                SetTMS();
+            }
+            else
+            {
+                ClearTMS();
+            }
+
+            if ( tdi & m )
+            {
+                SetTDI();
+            }
+            else
+            {
+                ClearTDI();
+            }
+
+            bool tdo = ClockPulse();
+            if ( cap & m )
+            {
+                any |= tdo;
+                if ( reply )
+                {
+                    PutTDO( tdo );
+                }
+            }
+        }
+        return any;
+    }
+
+        // Vectors are executed as they arrive, nothing is buffered
+    void ShiftVector( uint16_t bits )
+    {
+        out_     = 0;
+        outBits_ = 0;
+
+        while ( bits )
+        {
+            uint8_t tms = RXChar();
+            uint8_t tdi = RXChar();
+            uint8_t cap = RXChar();
+            uint8_t n   = bits < 8 ? bits : 8;
+
+            ShiftByte( n, tms, tdi, cap, true );
+            bits -= n;
+        }
+
+        if ( outBits_ )
+        {
+            Serial.write( out_ );
+        }
+    }
+
+    uint8_t PollVector()
+    {
+        uint8_t  vec[3 * BRIDGE_MAX_POLL_BITS / 8];
+        uint8_t  bits  = RXChar();
+        uint16_t tries = RXWordLE();
+        uint8_t  len   = 3 * ((bits + 7) / 8);
+        uint8_t  i;
+
+        if ( bits > BRIDGE_MAX_POLL_BITS )
+        {
+                // Drained, so the next frame starts in step
+            for ( i = 0; i < len; ++i )
+            {
+                RXChar();
+            }
+            return BRIDGE_BAD_FRAME;
+        }
+
+        for ( i = 0; i < len; ++i )
+        {
+            vec[i] = RXChar();
+        }
+
+        while ( tries-- )
+        {
+            bool    any  = false;
+            uint8_t left = bits;
+
+            for ( i = 0; i < len; i += 3 )
+            {
+                uint8_t n = left < 8 ? left : 8;
+                any |= ShiftByte( n, vec[i], vec[i+1], vec[i+2], false );
+                left -= n;
+            }
+
+            if ( any )
+            {
+                return BRIDGE_OK;
+            }
+        }
+        return BRIDGE_POLL_TIMEOUT;
+    }
+
+public:
+    void Run()
+    {
+        bool done = false;
+
+        while ( !done )
+        {
+            uint8_t status = BRIDGE_OK;
+
+            switch ( RXChar() )
+            {
+                case 'V':
+                    ShiftVector( RXWordLE() );
+                    break;
+
+                case 'P':
+                    status = PollVector();
+                    break;
+
+                case 'R':
+                    if ( RXChar() )
+                    {
+                        SetMCLR();
+                    }
+                    else
+                    {
+                        ClearMCLR();
+                    }
+                    break;
+
+                case 'W':
+                    delay( RXWordLE() );
+                    break;
+
+                case 'S':
+                    Serial.print(F("AP32"));
+                    Serial.write( BRIDGE_VERSION );
+                    break;
+
+                case 'X':
+                    done = true;
+                    break;
+
+                default:
+                    status = BRIDGE_BAD_FRAME;
+                    break;
+            }
+
+            Serial.write( status );
+        }
+    }
+};
+
+#endif
@@ -0,0 +1,140 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef JTAG_TRACE_H
+#define JTAG_TRACE_H
+
+/**
+ * Scan trace. With JTAG_TRACE defined every TCK period is recorded into
+ * a RAM ring buffer, one byte each, and 'T' dumps the buffer as hex for
+ * host/trace2vcd to turn into a waveform. Nothing is printed while the
+ * scans run, so the trace shows the timing as it is without tracing,
+ * apart from the few cycles the store takes.
+ *
+ * Without JTAG_TRACE the hooks expand to nothing and the shifting code
+ * is the same as before they were added.
+ *
+ * Entry bytes:
+ *   0000 mcit   clock: t=TMS, i=TDI, c=TDO, m=MCLR as driven for it
+ *   1000 kkkk   marker, k = trace_mark_e, written before the scan
+ */
+//#define JTAG_TRACE             // costs JTAG_TRACE_SIZE bytes of RAM
+
+#ifndef JTAG_TRACE_SIZE
+#define JTAG_TRACE_SIZE  256     // power of two
+#endif
+
+#define TRACE_TMS_BIT    0x01
+#define TRACE_TDI_BIT    0x02
+#define TRACE_TDO_BIT    0x04
+#define TRACE_MCLR_BIT   0x08
+#define TRACE_MARKER     0x80
+
+enum trace_mark_e {
+    TRACE_SCAN_IR  = 1,
+    TRACE_SCAN_DR  = 2,
+    TRACE_SCAN_TMS = 3
+};
+
+#ifdef JTAG_TRACE
+
+uint8_t  JTAGTraceBuf[JTAG_TRACE_SIZE];
+uint16_t JTAGTraceHead;
+uint32_t JTAGTraceTotal;
+
+inline void JTAGTracePut( uint8_t entry )
+{
+    JTAGTraceBuf[JTAGTraceHead] = entry;
+    JTAGTraceHead = (JTAGTraceHead + 1) & (JTAG_TRACE_SIZE - 1);
+    ++JTAGTraceTotal;
+}
+
+inline void JTAGTraceClock( bool tdo )
+{
+    uint8_t entry = tdo ? TRACE_TDO_BIT : 0;
+
+    if ( getBIT( _TMS ) )
+    {
+        entry |= TRACE_TMS_BIT;
+    }
+    if ( getBIT( _TDI ) )
+    {
+        entry |= TRACE_TDI_BIT;
+    }
+    if ( getBIT( _MCLR ) )
+    {
+        entry |= TRACE_MCLR_BIT;
+    }
+    JTAGTracePut( entry );
+}
+
+    // Prints the buffered entries oldest first, then starts over.
+    // "Trace <entries> <dropped>", hex lines, "End of trace".
+void JTAGTraceDump()
+{
+    uint16_t count = JTAGTraceTotal < JTAG_TRACE_SIZE ? JTAGTraceTotal : JTAG_TRACE_SIZE;
+    uint16_t pos   = (JTAGTraceHead - count) & (JTAG_TRACE_SIZE - 1);
+    uint16_t n;
+
+    Serial.print(F("Trace "));
+    Serial.print(count);
+    Serial.print(' ');
+    Serial.println(JTAGTraceTotal - count);
+
+    for ( n = 0; n < count; ++n )
+    {
+        uint8_t entry = JTAGTraceBuf[(pos + n) & (JTAG_TRACE_SIZE - 1)];
+
+        if ( entry < 0x10 )
+        {
+            Serial.print('0');
+        }
+        Serial.print(entry, HEX);
+        if ( (n & 31) == 31 || n + 1 == count )
+        {
+            Serial.println();
+        }
+    }
+    Serial.println(F("End of trace"));
+
+    JTAGTraceHead  = 0;
+    JTAGTraceTotal = 0;
+}
+
+#define JTAG_TRACE_CLOCK(tdo)   JTAGTraceClock( tdo )
+#define JTAG_TRACE_MARK(kind)   JTAGTracePut( TRACE_MARKER | (kind) )
+
+#else
+
+#define JTAG_TRACE_CLOCK(tdo)
+#define JTAG_TRACE_MARK(kind)
+
+#endif
+
+#endif
@@ -0,0 +1,175 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef LINK_SPEED_H
+#define LINK_SPEED_H
+
+#include <Arduino.h>
+#include <util/crc16.h>
+#include "EepromMap.h"
+
+/**
+ * Serial link speed negotiation. Sessions start at LINK_BASE_BAUD
+ * unless a faster rate has been agreed on before and saved in EEPROM.
+ *
+ * Remembered rate: after reset the sketch runs at that rate for
+ * LINK_SYNC_MS, sending LINK_SYNC every LINK_ANNOUNCE_MS. A host that
+ * answers LINK_SYNC gets LINK_ACK and the session stays there. Without
+ * an answer it carries on at LINK_BASE_BAUD, so plain terminals and
+ * older tools only see the banner a little later. A LINK_SYNC at the
+ * start prompt has the prompt printed again, for a host that was
+ * listening at the other rates meanwhile.
+ *
+ * Negotiation, from the start prompt, host first:
+ *
+ *   'L' rate:u8                    index into LinkRates[]
+ *        LINK_ACK (LINK_NAK for a bad index), both ends switch
+ *   pattern:u8*LINK_PATTERN_LEN crc:u16
+ *        each byte comes back inverted as it arrives, then the CRC of
+ *        the inverted bytes
+ *   LINK_ACK
+ *        LINK_ACK, the rate is saved
+ *
+ * CRCs are _crc_ccitt_update() from 0xffff, little endian. Anything
+ * missing for LINK_TEST_MS or a bad CRC puts the sketch back at the
+ * rate it had before. Either way the main loop starts over and prints
+ * the prompt again, at the rate in use. The host walks down its ladder
+ * with one 'L' per rung until a rate passes.
+ */
+
+#define LINK_BASE_BAUD    1200
+#define LINK_SYNC_MS      2000
+#define LINK_ANNOUNCE_MS  100
+#define LINK_TEST_MS      1000
+#define LINK_PATTERN_LEN  32
+#define LINK_SYNC         'U'
+#define LINK_ACK          0x06    // not text, the banner may be coming too
+#define LINK_NAK          0x15
+
+PROGMEM const uint32_t LinkRates[] =
+{
+    LINK_BASE_BAUD, 9600, 19200, 38400, 57600, 115200
+};
+
+#define LINK_RATES (sizeof(LinkRates) / sizeof(LinkRates[0]))
+
+uint8_t LinkRate = 0;       // LinkRates[] index in use
+
+void LinkSwitch( uint8_t rate )
+{
+    Serial.flush();
+    Serial.end();
+    Serial.begin( pgm_read_dword( &LinkRates[rate] ) );
+    LinkRate = rate;
+}
+
+    // -1 on timeout
+int LinkRead( uint16_t ms )
+{
+    unsigned long start = millis();
+
+    while ( !Serial.available() )
+    {
+        if ( millis() - start >= ms )
+        {
+            return -1;
+        }
+    }
+    return Serial.read();
+}
+
+    // Replaces Serial.begin() in setup()
+void LinkSpeedBegin()
+{
+    uint8_t rate = eeprom_read_byte( EE_ADDR(EE_LINK_RATE) );
+
+    if ( rate && rate < LINK_RATES )
+    {
+        unsigned long start = millis();
+
+        LinkSwitch( rate );
+        while ( millis() - start < LINK_SYNC_MS )
+        {
+            Serial.write( LINK_SYNC );
+            if ( LinkRead( LINK_ANNOUNCE_MS ) == LINK_SYNC )
+            {
+                Serial.write( LINK_ACK );
+                return;
+            }
+        }
+    }
+    LinkSwitch( 0 );
+}
+
+    // 'L', the index byte is next. True if the new rate was kept.
+bool LinkNegotiate()
+{
+    uint8_t  rate = RXChar();
+    uint8_t  old  = LinkRate;
+    uint16_t crc  = 0xffff;
+    uint16_t echo = 0xffff;
+    uint8_t  i;
+    int      c = 0;
+
+    if ( rate >= LINK_RATES )
+    {
+        Serial.write( LINK_NAK );
+        return false;
+    }
+    Serial.write( LINK_ACK );
+    LinkSwitch( rate );
+
+    for ( i = 0; i < LINK_PATTERN_LEN && c >= 0; ++i )
+    {
+        if ( ( c = LinkRead( LINK_TEST_MS ) ) >= 0 )
+        {
+            crc  = _crc_ccitt_update( crc, c );
+            echo = _crc_ccitt_update( echo, ~c );
+            Serial.write( (uint8_t)~c );
+        }
+    }
+
+    if ( c >= 0 && LinkRead( LINK_TEST_MS ) == ( crc & 0xff )
+                && LinkRead( LINK_TEST_MS ) == ( crc >> 8 ) )
+    {
+        Serial.write( echo & 0xff );
+        Serial.write( echo >> 8 );
+        if ( LinkRead( LINK_TEST_MS ) == LINK_ACK )
+        {
+            eeprom_update_byte( EE_ADDR(EE_LINK_RATE), rate );
+            Serial.write( LINK_ACK );
+            return true;
+        }
+    }
+
+    LinkSwitch( old );
+    return false;
+}
+
+#endif
@@ -0,0 +1,224 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <Arduino.h>
+#include <util/crc16.h>
+#include "EepromMap.h"
+#include "Progress.h"
+#include "Pic32JTAGDevice.h"
+
+/**
+ * Station metrics kept in EEPROM over power cycles: sessions, targets
+ * programmed per device type, bytes programmed, session times and the
+ * failures seen. During a session only RAM is touched (SessionState,
+ * Progress.h), the record is written once when the target goes.
+ *
+ * Wear levelling: the record has METRICS_SLOTS copies, each update
+ * goes to the slot after the newest one. Loading takes the valid slot
+ * with the highest sequence number, so a write broken off by a reset
+ * costs one session at most.
+ *
+ * 'M' prints the record as one line of key=value pairs:
+ *
+ *   metrics seq=.. sessions=.. programmed=.. bytes=.. mean_ms=..
+ *           worst_ms=.. verify=.. checksum=.. poll=.. other=..
+ *           [dev_<DevID hex>=<programmed>]*
+ */
+
+#define METRICS_SLOTS 4
+#define METRICS_TYPES 4
+
+struct MetricsType_t {
+    uint32_t DevID;             // without revision, 0 = unused
+    uint16_t Count;
+};
+
+struct Metrics_t {
+    uint16_t Seq;
+    uint32_t Sessions;          // attaches that did any programming/verify
+    uint32_t Programmed;        // ... of which programmed successfully
+    uint32_t Bytes;             // bytes programmed
+    uint32_t TotalDs;           // session times, 0.1s units
+    uint16_t WorstDs;
+    uint16_t VerifyFails;
+    uint16_t ChecksumErrors;    // HexPgm record checksums
+    uint16_t PollTimeouts;
+    uint16_t Other;             // programmed, type table full
+    MetricsType_t Type[METRICS_TYPES];
+    uint16_t Check;             // CRC-CCITT of the above
+};
+
+uint16_t MetricsCheck( const Metrics_t & m )
+{
+    const uint8_t * p = (const uint8_t *)&m;
+    uint16_t crc = 0xffff;
+    uint8_t  n;
+
+    for ( n = 0; p + n < (const uint8_t *)&m.Check; ++n )
+    {
+        crc = _crc_ccitt_update( crc, p[n] );
+    }
+    return crc;
+}
+
+uint8_t * MetricsSlot( uint8_t slot )
+{
+    return EE_ADDR(EE_METRICS + slot * sizeof(Metrics_t));
+}
+
+    // Newest valid copy, or a cleared record. Returns its slot,
+    // METRICS_SLOTS - 1 if none so that slot 0 is written first.
+uint8_t MetricsLoad( Metrics_t & m )
+{
+    Metrics_t c;
+    uint8_t   slot, newest = METRICS_SLOTS;
+
+    for ( slot = 0; slot < METRICS_SLOTS; ++slot )
+    {
+        eeprom_read_block( &c, MetricsSlot( slot ), sizeof(c) );
+        if ( c.Check != MetricsCheck( c ) )
+        {
+            continue;
+        }
+        if ( newest == METRICS_SLOTS || (int16_t)(c.Seq - m.Seq) > 0 )
+        {
+            m      = c;
+            newest = slot;
+        }
+    }
+
+    if ( newest == METRICS_SLOTS )
+    {
+        memset( &m, 0, sizeof(m) );
+        return METRICS_SLOTS - 1;
+    }
+    return newest;
+}
+
+void MetricsAdd16( uint16_t & counter, uint16_t n )
+{
+    counter = counter > 0xffff - n ? 0xffff : counter + n;
+}
+
+void MetricsCountType( Metrics_t & m, uint32_t devID )
+{
+    uint8_t n;
+
+    devID &= ~PIC32_REVISION_MASK;
+    for ( n = 0; n < METRICS_TYPES; ++n )
+    {
+        if ( m.Type[n].DevID == devID || !m.Type[n].DevID )
+        {
+            m.Type[n].DevID = devID;
+            MetricsAdd16( m.Type[n].Count, 1 );
+            return;
+        }
+    }
+    MetricsAdd16( m.Other, 1 );
+}
+
+    // Called once per attach, after the target is done with. Sessions
+    // that did not program or verify anything are not recorded.
+void MetricsSessionEnd( Pic32JTAGDevice & pic32 )
+{
+    Metrics_t m;
+    uint8_t   slot;
+    uint32_t  ds;
+
+    if ( SessionState.Started )
+    {
+        slot = MetricsLoad( m );
+        ds   = (SessionState.EndMs - SessionState.StartMs + 50) / 100;
+
+        ++m.Sessions;
+        m.Bytes   += SessionState.Bytes;
+        m.TotalDs += ds;
+        if ( ds > m.WorstDs )
+        {
+            m.WorstDs = ds > 0xffff ? 0xffff : ds;
+        }
+        if ( SessionState.Programmed )
+        {
+            ++m.Programmed;
+            MetricsCountType( m, pic32.GetDeviceID() );
+        }
+        MetricsAdd16( m.VerifyFails,    SessionState.VerifyFails );
+        MetricsAdd16( m.ChecksumErrors, SessionState.ChecksumErrors );
+        MetricsAdd16( m.PollTimeouts,   pic32.GetPollTimeouts() );
+
+        ++m.Seq;
+        m.Check = MetricsCheck( m );
+        eeprom_update_block( &m, MetricsSlot( (slot + 1) % METRICS_SLOTS ), sizeof(m) );
+    }
+
+    memset( &SessionState, 0, sizeof(SessionState) );
+}
+
+void PrintMetrics()
+{
+    Metrics_t m;
+    uint8_t   n;
+
+    MetricsLoad( m );
+
+    Serial.print(F("metrics seq="));
+    Serial.print( m.Seq );
+    Serial.print(F(" sessions="));
+    Serial.print( m.Sessions );
+    Serial.print(F(" programmed="));
+    Serial.print( m.Programmed );
+    Serial.print(F(" bytes="));
+    Serial.print( m.Bytes );
+    Serial.print(F(" mean_ms="));
+    Serial.print( m.Sessions ? m.TotalDs / m.Sessions * 100 : 0 );
+    Serial.print(F(" worst_ms="));
+    Serial.print( (uint32_t)m.WorstDs * 100 );
+    Serial.print(F(" verify="));
+    Serial.print( m.VerifyFails );
+    Serial.print(F(" checksum="));
+    Serial.print( m.ChecksumErrors );
+    Serial.print(F(" poll="));
+    Serial.print( m.PollTimeouts );
+    Serial.print(F(" other="));
+    Serial.print( m.Other );
+
+    for ( n = 0; n < METRICS_TYPES && m.Type[n].DevID; ++n )
+    {
+        Serial.print(F(" dev_"));
+        Serial.print( m.Type[n].DevID, HEX );
+        Serial.print('=');
+        Serial.print( m.Type[n].Count );
+    }
+    Serial.println();
+}
+
+#endif
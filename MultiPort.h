@@ -0,0 +1,229 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef MULTI_PORT_H
+#define MULTI_PORT_H
+
+#include <Arduino.h>
+#include "Pic32JTAGDevice.h"
+
+/**
+ * One target per JTAG port, JTAG_PORTS > 1 (see ArduinoJTAG.h).
+ *
+ * The menu session runs on the active port and 'j' moves it to another
+ * one. The other ports can be given a job that is mostly waiting on the
+ * target, a chip erase ('J'), and PortsYield() moves those on by at most
+ * one scan each whenever the active session waits anyway: in the middle
+ * of each of its own flash writes, for serial input and for a board to
+ * come or go. The next boards get erased while the current one is being
+ * programmed, each port at its own step and with its own part.
+ *
+ * Only jobs that need no data run in the background: there is one
+ * serial line, and it is busy with the active port's image.
+ */
+
+#if JTAG_PORTS > 1
+
+#define PORT_POLL_MS  10        // MCHP_STATUS interval while erasing
+
+enum port_state_e {
+    PORT_IDLE = 0,
+    PORT_ERASING,
+    PORT_ERASED,
+    PORT_NO_TARGET
+};
+
+class PortJob: public Pic32JTAG {
+private:
+    uint8_t       state_;       // port_state_e
+    uint32_t      idcode_;
+    unsigned long next_;
+
+public:
+    PortJob( uint8_t port )
+        : Pic32JTAG( port )
+    {
+        state_  = PORT_IDLE;
+        idcode_ = 0;
+        next_   = 0;
+    }
+
+    uint8_t GetState()
+    {
+        return state_;
+    }
+
+    uint32_t GetIDCode()
+    {
+        return idcode_;
+    }
+
+    bool Busy()
+    {
+        return state_ == PORT_ERASING;
+    }
+
+        // Holds the target in reset and starts MCHP_ERASE on it
+    void StartErase()
+    {
+        SetReset(true);
+        SetMode(6, 0x1f);
+        SendCommand(MTAP_SW_MTAP);
+        SendCommand(MTAP_IDCODE);
+        idcode_ = XferData(DATA_IDCODE);
+
+        if ( !idcode_ || idcode_ == 0xffffffff )
+        {
+            SetReset(false);
+            state_ = PORT_NO_TARGET;
+            return;
+        }
+
+        EraseStart();
+        state_ = PORT_ERASING;
+        next_  = millis() + 1;
+    }
+
+        // One MCHP_STATUS read at most, when it is due
+    void Step()
+    {
+        if ( state_ != PORT_ERASING || (long)(millis() - next_) < 0 )
+        {
+            return;
+        }
+
+        uint32_t status = XferData(MCHP_STATUS);
+
+        if ( (status & CFGRDY) && !(status & FCBUSY) )
+        {
+            SetReset(false);
+            state_ = PORT_ERASED;
+        }
+        else
+        {
+            next_ = millis() + PORT_POLL_MS;
+        }
+    }
+};
+
+uint8_t ActivePort = 0;
+
+PortJob PortJobs[JTAG_PORTS] =
+{
+    PortJob( 0 ),
+    PortJob( 1 ),
+#if JTAG_PORTS > 2
+    PortJob( 2 ),
+#endif
+};
+
+void PortsYield()
+{
+    for ( uint8_t i = 0; i < JTAG_PORTS; ++i )
+    {
+        if ( i != ActivePort )
+        {
+            PortJobs[i].Step();
+        }
+    }
+}
+
+    // Waits for the job on a port that is about to become the active one
+void PortsFinish( uint8_t port )
+{
+    while ( PortJobs[port].Busy() )
+    {
+        PortsYield();
+    }
+}
+
+void PrintPorts()
+{
+    for ( uint8_t i = 0; i < JTAG_PORTS; ++i )
+    {
+        Serial.print(F("Port "));
+        Serial.print( i );
+        Serial.print(F(": "));
+
+        if ( i == ActivePort )
+        {
+            Serial.println(F("active"));
+            continue;
+        }
+
+        switch ( PortJobs[i].GetState() )
+        {
+            case PORT_IDLE:
+                Serial.println(F("idle"));
+                break;
+
+            case PORT_ERASING:
+            case PORT_ERASED:
+                Serial.print( PortJobs[i].Busy() ? F("erasing 0x") : F("erased 0x") );
+                Serial.println( PortJobs[i].GetIDCode(), HEX );
+                break;
+
+            default:
+                Serial.println(F("no target"));
+                break;
+        }
+    }
+}
+
+    // 'J' <port>: background chip erase
+void PortErase( uint8_t port )
+{
+    if ( port < JTAG_PORTS && port != ActivePort && !PortJobs[port].Busy() )
+    {
+        PortJobs[port].StartErase();
+    }
+    PrintPorts();
+}
+
+    // 'j' <port>: true if the menu is to start over on that port
+bool PortSelect( uint8_t port )
+{
+    if ( port >= JTAG_PORTS || port == ActivePort )
+    {
+        PrintPorts();
+        return false;
+    }
+
+    PortsFinish( port );
+    ActivePort = port;
+    return true;
+}
+
+#else
+
+const uint8_t ActivePort = 0;
+
+#endif
+
+#endif
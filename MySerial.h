@@ -32,6 +32,9 @@
 
 #include <Arduino.h>
 #include "Pic32JTAGDevice.h"
+#include "EepromMap.h"
+#include "FlashWriter.h"
+#include "Progress.h"
 
 uint8_t GlobalCheckSum = 0;
 
@@ -41,6 +44,7 @@ char RXChar(void)
     // Wait for inc character
     while(!Serial.available())
     {
+        JTAG_PORTS_YIELD();
         asm(" nop");
     }
 
@@ -48,39 +52,65 @@ char RXChar(void)
 }
 
 
-unsigned char Ascii2Hex(unsigned char a)
+/**
+ * Binary streams (XSVF etc.) use credit based flow control: one XON is
+ * sent for every RX_CREDIT_BYTES taken out of the RX buffer, and the
+ * host keeps at most RX_CREDITS such chunks unacknowledged. This keeps
+ * the 64 byte RX buffer from overflowing while the programmer is busy.
+ */
+#define RX_CREDIT_BYTES 32
+#define RX_CREDITS      2
+#define XON             0x11
+
+uint8_t RXCreditCount = 0;
+
+void RXStreamBegin(void)
 {
-    if (a >= '0' && a <='9')
-    {
-        return a-'0';
-    }
-    else if (a >= 'A' && a <='F')
-    {
-        return 10+(a-'A');
-    }
-    else if (a >= 'a' && a <='f')
+    uint8_t i;
+
+    RXCreditCount = 0;
+    for ( i = 0; i < RX_CREDITS; ++i )
     {
-        return 10+(a-'a');
+        Serial.write( XON );
     }
-    else
+}
+
+uint8_t RXStreamByte(void)
+{
+    uint8_t c = RXChar();
+
+    if ( ++RXCreditCount == RX_CREDIT_BYTES )
     {
-        return 0;
+        RXCreditCount = 0;
+        Serial.write( XON );
     }
+    return c;
 }
 
-unsigned char RXAsciiByte(void)
+
+    // Hex digit values by the low five bits of the character: '0'-'9'
+    // are 0x10-0x19, 'A'-'F' and 'a'-'f' both 0x01-0x06. Anything else
+    // decodes to some digit too and is left to the record checksum.
+PROGMEM const uint8_t HexNibble[32] =
 {
-    unsigned char b1,b2;
+    0, 10, 11, 12, 13, 14, 15, 0,  0, 0, 0, 0, 0, 0, 0, 0,
+    0,  1,  2,  3,  4,  5,  6, 7,  8, 9, 0, 0, 0, 0, 0, 0
+};
+
+unsigned char Ascii2Hex(unsigned char a)
+{
+    return pgm_read_byte( &HexNibble[a & 0x1f] );
+}
 
-    b1 = RXChar();
-    b2 = RXChar();
+unsigned char RXAsciiByte(void)
+{
+    unsigned char b;
 
-    b1 = Ascii2Hex(b1);
-    b2 = Ascii2Hex(b2);
-    b1 = ((b1<<4) + b2);
+    b  = Ascii2Hex( RXChar() ) << 4;
+    b |= Ascii2Hex( RXChar() );
 
-    GlobalCheckSum += b1;
-    return b1;
+    GlobalCheckSum += b;
+    return b;
 }
 
 uint16_t RXAsciiWord(void)
@@ -93,56 +123,221 @@ uint16_t RXAsciiWord(void)
     return ((((uint16_t)b1)<<8) + b2);
 }
 
+    // Decimal number up to CR or LF, 0 without digits
+uint32_t RXDecimal(void)
+{
+    uint32_t value = 0;
+    char     c;
+
+    while ( (c = RXChar()) != '\r' && c != '\n' )
+    {
+        if ( c >= '0' && c <= '9' )
+        {
+            value = value * 10 + (c - '0');
+        }
+    }
+    return value;
+}
+
 
 void ConsumeRestOfFile( void )
 {
     uint16_t phase = 0;
   
-    Serial.println (F("\nPlease wait, throwing away the rest of the file."));
+    if ( !QuietMode )
+    {
+        Serial.println (F("\nPlease wait, throwing away the rest of the file."));
+    }
 
     do
     {
         while ( Serial.available() > 0 )
             Serial.read();
 
-        Serial.print(F("\x1b[1;0H"));  // goto row 1, column 0
-        switch ((phase++)&0x3)
+        if ( !QuietMode )
         {
-            case 0: Serial.print(F("-"));  break;
-            case 1: Serial.print(F("\\")); break;
-            case 2: Serial.print(F("|"));  break;
-            case 3: Serial.print(F("/"));  break;
+            Serial.print(F("\x1b[1;0H"));  // goto row 1, column 0
+            switch ((phase++)&0x3)
+            {
+                case 0: Serial.print(F("-"));  break;
+                case 1: Serial.print(F("\\")); break;
+                case 2: Serial.print(F("|"));  break;
+                case 3: Serial.print(F("/"));  break;
+            }
         }
 
         delay(1000);
     } while( Serial.available() > 0 );
     
-    Serial.println();
-    Serial.println();
-    Serial.println();
+    if ( !QuietMode )
+    {
+        Serial.println();
+        Serial.println();
+        Serial.println();
+    }
 }
 
-void printNumBytesFlashed(uint16_t & bytesFlashed)
+void printNumBytesFlashed(uint32_t & bytesFlashed)
 {
-    if ( bytesFlashed > 0 )
+        // Summary only, dropped rather than waited for
+    if ( bytesFlashed > 0 && !QuietMode && TXRoom( 24 ) )
     {
         Serial.print(F(" wrote "));
         Serial.print(bytesFlashed, DEC);
         Serial.println(F(" bytes"));
-        bytesFlashed = 0;
     }
+    bytesFlashed = 0;
+}
+
+/**
+ * Resume checkpoint: the last HEX record (line) that was completely
+ * programmed, and verified if verifying, with its flash address. Kept
+ * in RAM while programming and written to EEPROM only when a session
+ * fails, so the EEPROM is not worn by every record.
+ */
+struct HexCheckpoint_t {
+    uint32_t DevID;
+    uint32_t Line;      // 0 = no checkpoint
+    uint32_t Addr;
+};
+
+void SaveCheckpoint( uint32_t devID, uint32_t line, uint32_t addr )
+{
+    HexCheckpoint_t cp = { devID, line, addr };
+
+    eeprom_update_block( &cp, EE_ADDR(EE_CHECKPOINT), sizeof(cp) );
+
+    if ( line && !QuietMode )
+    {
+        Serial.print(F("Checkpoint: line "));
+        Serial.print(line);
+        Serial.print(F(" @ 0x"));
+        Serial.println(addr, HEX);
+    }
+}
+
+bool LoadCheckpoint( uint32_t devID, HexCheckpoint_t & cp )
+{
+    eeprom_read_block( &cp, EE_ADDR(EE_CHECKPOINT), sizeof(cp) );
+
+    return cp.DevID == devID && cp.Line != 0 && cp.Line != 0xffffffff;
+}
+
+/**
+ * Reads one line of per-device patches (Patch.h), hex numbers:
+ *
+ *   addr=value     unit patch for the next programming session
+ *   #addr=next     serial counter at addr, next value to program
+ *   #-             no serial counter
+ *
+ * An empty line clears the unit patches. False on a malformed entry,
+ * e.g. "addr=" without a value; then no unit patch of the line is kept.
+ */
+bool SetPatches()
+{
+    uint32_t num[2]  = { 0, 0 };
+    uint8_t  n       = 0;
+    bool     counter = false;
+    bool     off     = false;
+    bool     digits  = false;   // any in the entry
+    bool     value   = false;   // any after the '='
+    bool     ok      = true;
+    char     c;
+
+    if ( !QuietMode )
+    {
+        Serial.println(F("Patches (addr=value #addr=next #-):"));
+    }
+    Patches.Count    = 0;
+    Patches.Applied &= 1 << PATCH_COUNTER;
+
+    do
+    {
+        c = RXChar();
+        if ( c == '#' )
+        {
+            counter = true;
+        }
+        else if ( c == '-' && counter )
+        {
+            off = true;
+        }
+        else if ( c == '=' && n == 0 && digits )
+        {
+            n = 1;
+        }
+        else if ( isxdigit( c ) )
+        {
+            num[n] = (num[n] << 4) | Ascii2Hex( c );
+            digits = true;
+            value |= n == 1;
+        }
+        else if ( c == ' ' || c == ';' || c == ',' || c == '\t' || c == '\r' || c == '\n' )
+        {
+            if ( off )
+            {
+                PatchSetCounter( 0xffffffff, 0xffffffff );
+            }
+            else if ( value && counter )
+            {
+                PatchSetCounter( num[0], num[1] );
+            }
+            else if ( value )
+            {
+                ok &= PatchAdd( num[0], num[1] );
+            }
+            else if ( digits || counter )
+            {
+                ok = false;
+            }
+            num[0] = num[1] = 0;
+            n       = 0;
+            counter = off = digits = value = false;
+        }
+        else
+        {
+            ok = false;
+        }
+    } while ( c != '\r' && c != '\n' );
+
+    if ( !ok )
+    {
+        Patches.Count = 0;
+    }
+    if ( !QuietMode )
+    {
+        PrintPatches();
+        if ( !ok )
+        {
+            Serial.println(F("Bad patch"));
+        }
+    }
+    return ok;
 }
 
-void HexPgm( Pic32JTAGDevice pic32, bool program, bool verify )
+    //
+    // A resumed session (resumeLine set) may get the file from record
+    // startLine on instead of all of it, with the type 02 or 04 record
+    // in force there sent first (host/p32send -r). 0 or 1: all of it.
+    //
+void HexPgm( Pic32JTAGDevice & pic32, bool program, bool verify,
+             uint32_t resumeLine = 0, uint32_t resumeAddr = 0,
+             uint32_t startLine = 0 )
 {
     uint32_t flashAddr;
-    uint8_t  data[128];
-    uint16_t line = 0;
+    uint32_t recordAddr;
+    uint32_t word      = 0;
+    uint32_t firstWord = 0;
+    uint16_t opened    = 0;
+    bool     startsRow = false;
+    uint32_t line = 0;     // images over 1 MB have more than 64K records
 
     uint16_t startCode  = 0x0a;
     uint16_t byteCount  = 0;
     uint32_t address    = 0;
-    uint32_t addressHi  = 0;
+    uint32_t baseAddr   = 0;   // from type 02 or 04 records
+    uint32_t extentEnd  = ROW_NONE;
+    uint32_t value;
     uint16_t recordType = 0;
     uint8_t  checkSum   = 0;
     uint8_t  checkSumC  = 0;
@@ -151,18 +346,48 @@ void HexPgm( Pic32JTAGDevice pic32, bool program, bool verify )
     uint16_t Status;
     uint16_t phase = 0;
 
-    bool     printAddress = false;
-    uint16_t bytesFlashed = 0;
+    uint32_t bytesFlashed = 0;     // extents run across type 04 records
 
-    Serial.println (F("Send your .hex -file now."));
+    uint32_t doneLine = resumeLine;
+    uint32_t doneAddr = resumeAddr;
+    uint32_t prevLine = resumeLine;
+    uint32_t prevAddr = resumeAddr;
+    bool     resuming = resumeLine != 0;
+    bool     skip     = false;
+
+    FlashWriter writer( pic32, program, verify );
+
+    if ( !QuietMode )
+    {
+        Serial.println (F("Send your .hex -file now."));
+    }
+    ProgressBegin( program ? PHASE_PROGRAM : verify ? PHASE_VERIFY : PHASE_DRY_RUN );
+
+    if ( startLine > 1 )
+    {
+        if ( !resuming || startLine > resumeLine )
+        {
+                // Records between the checkpoint and startLine would be lost
+            if ( !QuietMode )
+            {
+                Serial.println(F("Start line is past the checkpoint!"));
+            }
+            ProgressEnd( STATUS_CHECKPOINT );
+            ConsumeRestOfFile();
+            return;
+        }
+            // The address record sent first is line startLine - 1
+        line = startLine - 2;
+    }
 
     while (recordType != 01)  // end
     {
         ++line;
+        skip = resuming && line <= resumeLine;
         do
         {
             startCode = RXChar();
-            if ( line == 1 )
+            if ( line == 1 && !QuietMode && TXRoom( 11 ) )
             {
                 // ANSI clear screen
                 Serial.print(F("\x1b[2J\x1b[0;0H"));
@@ -171,16 +396,24 @@ void HexPgm( Pic32JTAGDevice pic32, bool program, bool verify )
 
         if (startCode != ':')
         {   
-            Serial.print(F("Start code fail! Got "));
-            Serial.write(startCode);
-            Serial.println();
-            Serial.print(F("Line          "));
-            Serial.println(line);
-            Serial.print(F("Last address  0x"));
-            Serial.println(address, HEX);
-            Serial.println();
+            if ( !QuietMode )
+            {
+                Serial.print(F("Start code fail! Got "));
+                Serial.write(startCode);
+                Serial.println();
+                Serial.print(F("Line          "));
+                Serial.println(line);
+                Serial.print(F("Last address  0x"));
+                Serial.println(address, HEX);
+                Serial.println();
+            }
             
             // error
+            ProgressEnd( STATUS_START_CODE );
+            if ( program )
+            {
+                SaveCheckpoint( pic32.GetDeviceID(), doneLine, doneAddr );
+            }
             ConsumeRestOfFile();
             return;
         }
@@ -193,98 +426,151 @@ void HexPgm( Pic32JTAGDevice pic32, bool program, bool verify )
         switch (recordType)
         {
             case 0:
+                flashAddr  = baseAddr + address;
+                recordAddr = flashAddr;
+
+                    // Words go to the writer as they arrive. In row mode
+                    // it does not program them before Commit() below;
+                    // on parts without the RAM for two row buffers it
+                    // writes each chunk as it fills, before the record's
+                    // checksum is in (FlashWriter.h)
                 for (i = 0; i < byteCount; ++i)
                 {
-                    data[i] = RXAsciiByte();
+                    word = (word >> 8) | ((uint32_t)RXAsciiByte() << 24);
+                    if ( (i & 3) != 3 && i + 1 != byteCount )
+                    {
+                        continue;
+                    }
+                    if ( (i & 3) != 3 )
+                    {
+                            // Odd length record, pad with erased bytes
+                        word = (word >> (8 * (3 - (i & 3)))) | (0xffffffffUL << (8 * ((i & 3) + 1)));
+                    }
+                    if ( i < 4 )
+                    {
+                        firstWord = word;
+                        opened    = writer.Opened();
+                    }
+
+                    if ( !skip && !writer.Put( flashAddr, word ) )
+                    {
+                        ProgressEnd( writer.FailStatus() );
+                        if ( program )
+                        {
+                            SaveCheckpoint( pic32.GetDeviceID(), doneLine, doneAddr );
+                        }
+                        ConsumeRestOfFile();
+                        return;
+                    }
+                    if ( i < 4 )
+                    {
+                        startsRow = writer.Opened() != opened;
+                    }
+                    flashAddr += 4;
                 }
                 
                 checkSumC = ((uint8_t)0 - GlobalCheckSum);
                 checkSum  = RXAsciiByte(); /* checksum */
 
-                if ( checkSumC == checkSum )
-                {   
-                    flashAddr = (addressHi<<16) + (address);
-
-                    if ( program )
+                if ( checkSumC == checkSum && skip )
+                {
+                        // Done before the session was broken off
+                    if ( line == resumeLine && recordAddr != resumeAddr )
                     {
-                        uint32_t *curData;
-                        uint32_t  byte = 0;
-                        uint32_t  pgmAddr = flashAddr;
-                        curData = (uint32_t*)(data);
-
-                        if (printAddress)
+                        if ( !QuietMode )
                         {
-                            Serial.print(F("0x"));
-                            Serial.print(flashAddr, HEX);
-                            Serial.print(F(": 0x"));
-                            Serial.print((*curData), HEX);
-                            printAddress = false;
-                            bytesFlashed = 0;
+                            Serial.println(F("File does not match the checkpoint!"));
                         }
-                        else
+                        ProgressEnd( STATUS_CHECKPOINT );
+                        ConsumeRestOfFile();
+                        return;
+                    }
+                }
+                else if ( checkSumC == checkSum )
+                {   
+                    if ( !writer.Commit() )
+                    {
+                        ProgressEnd( writer.FailStatus() );
+                        if ( program )
                         {
-                            Serial.print(".");
+                            SaveCheckpoint( pic32.GetDeviceID(), doneLine, doneAddr );
                         }
-                        
-                        while ( byte < byteCount )
-                        {
-                            //Serial.print (F("Flashing 0x"));Serial.print(pgmAddr, HEX);
-                            //Serial.print (F(" = 0x"));Serial.println( (*curData), HEX);
-                            pic32.DownloadData( 0, (*curData) );
-                            pic32.FlashOperation( NVMOP_WRITE_WORD, pgmAddr, 0 );
-                            byte += 4;
-                            pgmAddr += 4;
-                            bytesFlashed += 4;
-                            ++curData;
-                        }    
+                        ConsumeRestOfFile();
+                        return;
                     }
 
-                    if ( verify )
+                        // Records that follow on from the one before
+                        // make one extent, reported once
+                    if ( program && recordAddr != extentEnd )
                     {
-                        uint32_t *curData;
-                        int16_t   byte = 0;
-                        curData = (uint32_t*)(data);
-                        while ( byte < byteCount )
-                        {
-                            //Serial.print (F("Verifying 0x"));Serial.print(flashAddr, HEX);
-                            uint32_t fdata = pic32.ReadFlashData( flashAddr );
-                            if ( (*curData) != fdata )
-                            {
-                                Serial.print (F("Verify failed at 0x"));
-                                Serial.println ( flashAddr, HEX );
-                                Serial.print ( F(" 0x"));
-                                Serial.print ( fdata, HEX );
-                                Serial.print ( F(" <> 0x") );
-                                Serial.print ( (*curData), HEX );             
-                                ConsumeRestOfFile();
-                                return;
-                            }
-                            byte += 4;
-                            flashAddr += 4;
-                            ++curData;
-                        }                        
+                        printNumBytesFlashed( bytesFlashed );
+                        ProgressAddress( recordAddr, firstWord );
                     }
+                    if ( program )
+                    {
+                        bytesFlashed += byteCount;
+                    }
+                    extentEnd = recordAddr + byteCount;
+
+                        // A record that ends mid row or chunk is only
+                        // done once that has been written. One that
+                        // starts a row means the records before it are.
+                        // Sessions that do not program leave the
+                        // checkpoint of the last one that did alone.
+                    if ( program && !writer.Pending() )
+                    {
+                        doneLine = line;
+                        doneAddr = recordAddr;
+                    }
+                    else if ( program && startsRow )
+                    {
+                        doneLine = prevLine;
+                        doneAddr = prevAddr;
+                    }
+                    prevLine = line;
+                    prevAddr = recordAddr;
+                    ProgressStep( recordAddr, byteCount );
                 }
 
                 break;
 
-            case 1:
-                //end
-                printNumBytesFlashed( bytesFlashed );
-                checkSumC = ((uint8_t)0 - GlobalCheckSum);
-                checkSum  = RXAsciiByte();  /*checksum */
-                break;
-
-            case 4:
-                addressHi = RXAsciiWord();
+            case 1:     // end of file
+            case 2:     // extended segment address, base = value << 4
+            case 3:     // start segment address (CS:IP), not needed
+            case 4:     // extended linear address, base = value << 16
+            case 5:     // start linear address (EIP), not needed
+                value = 0;
+                for (i = 0; i < byteCount; ++i)
+                {
+                    value = (value << 8) | RXAsciiByte();
+                }
                 checkSumC = ((uint8_t)0 - GlobalCheckSum);
                 checkSum  = RXAsciiByte();  /* checksum */
-                printNumBytesFlashed( bytesFlashed );
-                printAddress = true;
+
+                if ( recordType == 1 )
+                {
+                    printNumBytesFlashed( bytesFlashed );
+                }
+                else if ( recordType == 2 )
+                {
+                    baseAddr = value << 4;
+                }
+                else if ( recordType == 4 )
+                {
+                    baseAddr = value << 16;
+                }
                 break;
 
             default:
-                Serial.println(F("HEXfile error!"));
+                if ( !QuietMode )
+                {
+                    Serial.println(F("HEXfile error!"));
+                }
+                ProgressEnd( STATUS_RECORD_TYPE );
+                if ( program )
+                {
+                    SaveCheckpoint( pic32.GetDeviceID(), doneLine, doneAddr );
+                }
                 ConsumeRestOfFile();
                 return;
     
@@ -293,21 +579,53 @@ void HexPgm( Pic32JTAGDevice pic32, bool program, bool verify )
         if ( checkSumC != checkSum )
         {   
             // checksum error
-            Serial.print(F("Chksum fail line "));
-            Serial.println(line);
+            if ( !QuietMode )
+            {
+                Serial.print(F("Chksum fail line "));
+                Serial.println(line);
 
-            Serial.print(F("Checksum    0x"));
-            Serial.println(checkSum, HEX);
-            Serial.print(F("Calculated  0x"));
-            Serial.println(checkSumC, HEX);
+                Serial.print(F("Checksum    0x"));
+                Serial.println(checkSum, HEX);
+                Serial.print(F("Calculated  0x"));
+                Serial.println(checkSumC, HEX);
+            }
+            ProgressEnd( STATUS_CHECKSUM );
+            if ( program )
+            {
+                SaveCheckpoint( pic32.GetDeviceID(), doneLine, doneAddr );
+            }
             ConsumeRestOfFile();
             return;
         }
     }
     
-    Serial.println(F(""));
-    Serial.println(F("Done!"));
+    if ( !writer.Finish() )
+    {
+        ProgressEnd( writer.FailStatus() );
+        if ( program )
+        {
+            SaveCheckpoint( pic32.GetDeviceID(), doneLine, doneAddr );
+        }
+        return;
+    }
+
+    if ( program )
+    {
+            // no-op in EEPROM unless a checkpoint was left behind
+        SaveCheckpoint( 0xffffffff, 0, 0 );
+    }
+    if ( !resuming )
+    {
+        FootprintSave();
+    }
+
+    ProgressEnd( STATUS_OK );
+    if ( !QuietMode )
+    {
+        Serial.println(F(""));
+        Serial.println(F("Done!"));
+    }
 }
 
 
-#endif
+#endif
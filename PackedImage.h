@@ -0,0 +1,338 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef PACKED_IMAGE_H
+#define PACKED_IMAGE_H
+
+#include <Arduino.h>
+#include <util/crc16.h>
+#include "Pic32JTAGDevice.h"
+#include "FlashWriter.h"
+#include "MySerial.h"
+#include "Progress.h"
+
+/**
+ * Packed image loader, the binary counterpart of HexPgm(). A HEX file
+ * spends two ASCII characters per byte plus the record overhead, the
+ * packed stream (host/p32pack) sends erased gaps as a few bytes and
+ * repeated code as back references. Multibyte values little endian:
+ *
+ *   'Z' 'P' PACK_VERSION
+ *   { 'S' addr:u32 len:u32 { token* crc:u16 }* }  len and addr word aligned
+ *   'E'
+ *
+ * A segment is cut into blocks at every PACK_BLOCK aligned address, and
+ * at its end. Tokens, until the block's bytes have been produced:
+ *
+ *   0LLLLLLL             L+1 literal bytes follow
+ *   10FLLLLL [n:u16]     L+1 bytes of 0xFF (F=0) or 0x00 (F=1),
+ *                        L=31: 32+n bytes
+ *   11LLLLLL offset:u8   copy L+3 bytes from offset+1 bytes back,
+ *                        within the last PACK_WINDOW bytes
+ *
+ * No token runs past the end of its block. crc is CRC-CCITT
+ * (_crc_ccitt_update, initial 0xffff) over the unpacked bytes of the
+ * block. Every row size divides by PACK_BLOCK, so a block lies in one
+ * row, and a row is only programmed (FlashWriter::Commit()) once the
+ * CRCs of all its blocks have been checked. Parts without the RAM for
+ * two row buffers are the exception, FlashWriter writes chunks there
+ * as they fill.
+ */
+
+#define PACK_VERSION  2
+#define PACK_WINDOW   128     // power of two, costs as many bytes of RAM
+#define PACK_BLOCK    128     // divides every family's row size
+
+enum pack_status_e {
+    PACK_OK = 0,
+    PACK_BAD_HEADER,
+    PACK_BAD_TOKEN,
+    PACK_BAD_CRC,
+    PACK_VERIFY_FAIL
+};
+
+class PackedImage {
+
+private:
+    FlashWriter & writer_;
+    uint8_t       window_[PACK_WINDOW];
+    uint8_t       pos_;
+    uint16_t      crc_;
+    uint32_t      addr_;
+    uint32_t      word_;
+    uint8_t       wordBytes_;
+    uint8_t       stepWords_;     // Put() since the last ProgressStep()
+    uint32_t      bytes_;
+
+    uint16_t RXWordLE()
+    {
+        uint8_t lo = RXStreamByte();
+        uint8_t hi = RXStreamByte();
+        return ((uint16_t)hi << 8) | lo;
+    }
+
+    uint32_t RXLongLE()
+    {
+        uint16_t lo = RXWordLE();
+        uint16_t hi = RXWordLE();
+        return ((uint32_t)hi << 16) | lo;
+    }
+
+    bool Emit( uint8_t b )
+    {
+        window_[pos_++ & (PACK_WINDOW - 1)] = b;
+        crc_   = _crc_ccitt_update( crc_, b );
+        word_ |= (uint32_t)b << (8 * wordBytes_);
+
+        if ( ++wordBytes_ == 4 )
+        {
+            bool ok = writer_.Put( addr_, word_ );
+            addr_     += 4;
+            word_      = 0;
+            wordBytes_ = 0;
+
+                // By output, not by token, so that a long fill run
+                // keeps the host hearing from us while it is written
+            if ( ++stepWords_ == PROGRESS_DOT_BYTES / 4 )
+            {
+                ProgressStep( addr_, PROGRESS_DOT_BYTES );
+                stepWords_ = 0;
+            }
+            return ok;
+        }
+        return true;
+    }
+
+    uint8_t Segment()
+    {
+        uint32_t len;
+        uint8_t  block;     // bytes left in the block
+        uint8_t  offset = 0;
+
+        addr_      = RXLongLE();
+        len        = RXLongLE();
+        crc_       = 0xffff;
+        word_      = 0;
+        wordBytes_ = 0;
+
+        if ( (addr_ | len) & 3 )
+        {
+            return PACK_BAD_HEADER;
+        }
+        block = PACK_BLOCK - (addr_ & (PACK_BLOCK - 1));
+        if ( block > len )
+        {
+            block = len;
+        }
+
+        while ( len )
+        {
+            uint8_t  token = RXStreamByte();
+            uint32_t n;
+
+            if ( (token & 0x80) == 0 )
+            {
+                n = (token & 0x7f) + 1;
+            }
+            else if ( (token & 0x40) == 0 )
+            {
+                n = (token & 0x1f) + 1;
+                if ( n == 32 )
+                {
+                    n += RXWordLE();
+                }
+            }
+            else
+            {
+                n      = (token & 0x3f) + 3;
+                offset = RXStreamByte();
+                if ( offset >= PACK_WINDOW )
+                {
+                    return PACK_BAD_TOKEN;
+                }
+            }
+
+            if ( n > block )
+            {
+                return PACK_BAD_TOKEN;
+            }
+            len    -= n;
+            block  -= n;
+            bytes_ += n;
+
+            if ( (token & 0x80) == 0 )
+            {
+                while ( n-- )
+                {
+                    if ( !Emit( RXStreamByte() ) )
+                    {
+                        return PACK_VERIFY_FAIL;
+                    }
+                }
+            }
+            else if ( (token & 0x40) == 0 )
+            {
+                uint8_t fill = (token & 0x20) ? 0x00 : 0xff;
+                while ( n-- )
+                {
+                    if ( !Emit( fill ) )
+                    {
+                        return PACK_VERIFY_FAIL;
+                    }
+                }
+            }
+            else
+            {
+                    // Source may overlap the bytes being produced
+                uint8_t from = pos_ - offset - 1;
+                while ( n-- )
+                {
+                    if ( !Emit( window_[from++ & (PACK_WINDOW - 1)] ) )
+                    {
+                        return PACK_VERIFY_FAIL;
+                    }
+                }
+            }
+
+            if ( block == 0 )
+            {
+                    // The rows this block finished may be programmed now
+                if ( RXWordLE() != crc_ )
+                {
+                    return PACK_BAD_CRC;
+                }
+                if ( !writer_.Commit() )
+                {
+                    return PACK_VERIFY_FAIL;
+                }
+                crc_  = 0xffff;
+                block = len < PACK_BLOCK ? len : PACK_BLOCK;
+            }
+        }
+
+        if ( stepWords_ )
+        {
+            ProgressStep( addr_, 4 * stepWords_ );
+            stepWords_ = 0;
+        }
+        return PACK_OK;
+    }
+
+public:
+    PackedImage( FlashWriter & writer ):
+        writer_(writer),
+        pos_(0),
+        stepWords_(0),
+        bytes_(0)
+    {
+    }
+
+    uint8_t Load()
+    {
+        uint8_t status = PACK_OK;
+
+        if ( RXStreamByte() != 'Z' || RXStreamByte() != 'P'
+             || RXStreamByte() != PACK_VERSION )
+        {
+            return PACK_BAD_HEADER;
+        }
+
+        while ( status == PACK_OK )
+        {
+            switch ( RXStreamByte() )
+            {
+                case 'S':
+                    status = Segment();
+                    break;
+
+                case 'E':
+                    return writer_.Finish() ? PACK_OK : PACK_VERIFY_FAIL;
+
+                default:
+                    status = PACK_BAD_HEADER;
+                    break;
+            }
+        }
+        return status;
+    }
+
+        // Image bytes unpacked so far
+    uint32_t Bytes() const { return bytes_; }
+
+        // Where the last segment got to
+    uint32_t Address() const { return addr_; }
+};
+
+void PackedPgm( Pic32JTAGDevice & pic32, bool program, bool verify )
+{
+    FlashWriter writer( pic32, program, verify );
+    PackedImage image( writer );
+    uint8_t     status;
+
+    if ( !QuietMode )
+    {
+        Serial.println (F("Send your packed image now."));
+    }
+    ProgressBegin( program ? PHASE_PROGRAM : PHASE_VERIFY );
+    RXStreamBegin();
+    status = image.Load();
+    if ( status == PACK_OK )
+    {
+        FootprintSave();
+    }
+    ProgressEnd( status == PACK_OK ? STATUS_OK :
+                 status == PACK_VERIFY_FAIL ? writer.FailStatus() : STATUS_PACKED );
+
+    if ( QuietMode )
+    {
+        if ( status != PACK_OK )
+        {
+            ConsumeRestOfFile();
+        }
+    }
+    else if ( status == PACK_OK )
+    {
+        Serial.println();
+        Serial.print(F("Packed OK, "));
+        Serial.print( image.Bytes() );
+        Serial.print(F(" bytes, wrote "));
+        Serial.println( writer.BytesWritten() );
+    }
+    else
+    {
+        Serial.println();
+        Serial.print(F("Packed FAIL "));
+        Serial.print( status );
+        Serial.print(F(" near 0x"));
+        Serial.println( image.Address(), HEX );
+        ConsumeRestOfFile();
+    }
+}
+
+#endif
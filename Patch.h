@@ -0,0 +1,180 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef PATCH_H
+#define PATCH_H
+
+#include <Arduino.h>
+#include "EepromMap.h"
+
+/**
+ * Per-device data substituted into the image while it is programmed:
+ * serial numbers, MAC addresses, calibration words. Each patch replaces
+ * one 32 bit flash word, so a unit costs a few bytes on the link rather
+ * than a freshly generated image.
+ *
+ * The unit patches live in RAM and are used by the next successful
+ * programming session only. The serial counter lives in EEPROM, is
+ * written to its flash word every session and counts up once the
+ * session has passed.
+ *
+ * Patches are applied by FlashWriter as the chunks are assembled, so a
+ * patched word is programmed once with its final value. Patches outside
+ * of the image are written at the end of the session.
+ */
+
+#define PATCH_MAX     4
+#define PATCH_COUNTER PATCH_MAX     // Item[] index of the serial counter
+
+struct Patch_t {
+    uint32_t Addr;
+    uint32_t Value;
+};
+
+    // EE_SERIAL, Addr 0xffffffff = no counter
+struct PatchCounter_t {
+    uint32_t Addr;
+    uint32_t Next;
+};
+
+struct PatchList_t {
+    Patch_t  Item[PATCH_MAX + 1];
+    uint8_t  Count;         // unit patches in Item[0..]
+    uint8_t  Applied;       // bitmap of Item[] already in flash
+};
+
+PatchList_t Patches = { {}, 0, 0 };
+
+    // Item i is in use, the counter only if it is set up in EEPROM
+bool PatchUsed( uint8_t i )
+{
+    return i < Patches.Count || (i == PATCH_COUNTER && Patches.Item[i].Addr != 0xffffffff);
+}
+
+    // Latches the counter from EEPROM, at the start of every session
+void PatchesBegin()
+{
+    PatchCounter_t c;
+
+    eeprom_read_block( &c, EE_ADDR(EE_SERIAL), sizeof(c) );
+    Patches.Item[PATCH_COUNTER].Addr  = c.Addr & ~3UL;
+    Patches.Item[PATCH_COUNTER].Value = c.Next;
+    if ( c.Addr == 0xffffffff )
+    {
+        Patches.Item[PATCH_COUNTER].Addr = 0xffffffff;
+    }
+}
+
+bool PatchFind( uint32_t addr, uint32_t & value )
+{
+    uint8_t i;
+
+    for ( i = 0; i <= PATCH_COUNTER; ++i )
+    {
+        if ( PatchUsed( i ) && Patches.Item[i].Addr == addr )
+        {
+            value = Patches.Item[i].Value;
+            return true;
+        }
+    }
+    return false;
+}
+
+    // Marks the patches in [addr, addr + bytes) as programmed
+void PatchesApplied( uint32_t addr, uint16_t bytes )
+{
+    uint8_t i;
+
+    for ( i = 0; i <= PATCH_COUNTER; ++i )
+    {
+        if ( PatchUsed( i ) && Patches.Item[i].Addr - addr < bytes )
+        {
+            Patches.Applied |= 1 << i;
+        }
+    }
+}
+
+    // After an erase nothing is in flash anymore
+void PatchesReset()
+{
+    Patches.Applied = 0;
+}
+
+    // The unit is done: drop its patches, count the serial number up
+void PatchesCommit()
+{
+    PatchCounter_t c;
+
+    eeprom_read_block( &c, EE_ADDR(EE_SERIAL), sizeof(c) );
+    if ( c.Addr != 0xffffffff )
+    {
+        c.Next = Patches.Item[PATCH_COUNTER].Value + 1;
+        eeprom_update_block( &c, EE_ADDR(EE_SERIAL), sizeof(c) );
+    }
+    Patches.Count   = 0;
+    Patches.Applied = 0;
+}
+
+bool PatchAdd( uint32_t addr, uint32_t value )
+{
+    if ( Patches.Count == PATCH_MAX )
+    {
+        return false;
+    }
+    Patches.Item[Patches.Count].Addr  = addr & ~3UL;
+    Patches.Item[Patches.Count].Value = value;
+    ++Patches.Count;
+    return true;
+}
+
+void PatchSetCounter( uint32_t addr, uint32_t next )
+{
+    PatchCounter_t c = { addr, next };
+
+    eeprom_update_block( &c, EE_ADDR(EE_SERIAL), sizeof(c) );
+}
+
+void PrintPatches()
+{
+    uint8_t i;
+
+    PatchesBegin();
+    for ( i = 0; i <= PATCH_COUNTER; ++i )
+    {
+        if ( PatchUsed( i ) )
+        {
+            Serial.print( i == PATCH_COUNTER ? F(" #0x") : F("  0x") );
+            Serial.print( Patches.Item[i].Addr, HEX );
+            Serial.print( F(" = 0x") );
+            Serial.println( Patches.Item[i].Value, HEX );
+        }
+    }
+}
+
+#endif
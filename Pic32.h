@@ -32,100 +32,63 @@
 
 #include <avr/pgmspace.h>
 
+enum pic32_family_e {
+    FAMILY_MX12 = 0,    // PIC32MX1xx/2xx
+    FAMILY_MX37,        // PIC32MX3xx..7xx
+    FAMILY_MZ,          // PIC32MZ EC/EF
+};
+
+enum pic32_dev_flags_e {
+    DEV_DMA_CRC = 0x01  // has DMA, flash CRC can be done on chip
+};
+
+    //
+    // Per family programming parameters. The times are typical values,
+    // only used to decide when to start polling, never as a limit. The MZ
+    // ones are the data sheet FRC cycle counts at 8 MHz, rounded up; on MZ
+    // WordUs is one quad word.
+    //
+    // The NVM controller: NVMCON address (0xBF80xxxx), where NVMSRCADDR
+    // sits relative to it (MZ has four NVMDATA registers in between), the
+    // widest single write (NVMOP_WRITE_WORD or NVMOP_WRITE_QUAD) and the
+    // NVMOP that erases all of program flash.
+    //
+struct Pic32Family_t {
+    char     Prefix[3];     // Printed after "PIC32"
+    uint16_t RowSize;       // Row size in words
+    uint8_t  PageRows;      // Rows per erase page
+    uint8_t  WordWriteUs;
+    uint8_t  RowWriteMs;
+    uint8_t  PageEraseMs;
+    uint8_t  EraseAllMs;    // EraseAllOp or MCHP_ERASE
+    uint16_t NVMCon;
+    uint8_t  SrcAddrOffs;
+    uint8_t  WriteBytes;
+    uint8_t  EraseAllOp;
+};
+
+PROGMEM const Pic32Family_t Pic32FamilyList[] =
+{
+   //       RowSz PgRows WordUs RowMs PageMs AllMs NVMCON  SrcAd Write Erase
+    { "MX", 32,   8,     20,    2,    20,    80,   0xF400, 0x40, 4,    5 },   // FAMILY_MX12
+    { "MX", 128,  8,     20,    4,    20,    80,   0xF400, 0x40, 4,    5 },   // FAMILY_MX37
+    { "MZ", 512,  8,     52,    9,    22,    85,   0x0600, 0x70, 16,   7 },   // FAMILY_MZ
+};
+
 struct Pic32DevID_t {
-    uint32_t DevID;
-    char     DevName[9];
-    uint8_t  RowSize;  // Row size in words. Page size = x8
+    uint32_t DevID;    // IDCODE without the revision nibble (31:28)
+    char     DevName[11];
+    uint8_t  Family;   // pic32_family_e
+    uint16_t RAMSize;  // KB
     uint16_t BFMSize;  // Boot Flash Memory    (expected @ 0x1FC00000)
     uint16_t PFMSize;  // Program Flash Memory (expected @ 0x1D000000)
+    uint8_t  Flags;    // pic32_dev_flags_e
 };
 
-PROGMEM const Pic32DevID_t Pic32DevIDList[] =
-{
-// ----------------------------------------------------------------------
-// NOTE: used as source:
-//      "PIC32 Flash Programming Specification"
-// http://ww1.microchip.com/downloads/en/DeviceDoc/61145L.pdf
-// ----------------------------------------------------------------------
+#define PIC32_REVISION_MASK 0xF0000000
 
-   // DevID      DevName    RowSz BFMSz PFMSz
-    { 0x4A07053, "110F016B", 32,  3,  16  },
-    { 0x4A09053, "110F016C", 32,  3,  16  },
-    { 0x4A0B053, "110F016D", 32,  3,  16  },
-    { 0x4A06053, "120F032B", 32,  3,  32  },
-    { 0x4A08053, "120F032C", 32,  3,  32  },
-    { 0x4A0A053, "120F032D", 32,  3,  32  },
-    { 0x4D07053, "130F064B", 32,  3,  64  },
-    { 0x4D09053, "130F064C", 32,  3,  64  },
-    { 0x4D0B053, "130F064D", 32,  3,  64  },
-    { 0x4D06053, "150F128B", 32,  3,  128 },
-    { 0x4D08053, "150F128C", 32,  3,  128 },
-    { 0x4D0A053, "150F128D", 32,  3,  128 },
-    { 0x6610053, "170F256B", 32 , 3,  256 },
-    { 0x661A053, "170F256D", 32 , 3,  256 },
-    { 0x6600053, "270F256B", 32 , 3,  256 },
-    { 0x660A053, "270F256D", 32 , 3,  256 },
-    { 0x660C053, "270F25DB", 32 , 3,  256 },
-    { 0x4A01053, "210F016B", 32,  3,  16  },
-    { 0x4A03053, "210F016C", 32,  3,  16  },
-    { 0x4A05053, "210F016D", 32,  3,  16  },
-    { 0x4A00053, "220F032B", 32,  3,  32  },
-    { 0x4A02053, "220F032C", 32,  3,  32  },
-    { 0x4A04053, "220F032D", 32,  3,  32  },
-    { 0x4D01053, "230F064B", 32,  3,  64  },
-    { 0x4D03053, "230F064C", 32,  3,  64  },
-    { 0x4D05053, "230F064D", 32,  3,  64  },
-    { 0x4D00053, "250F128B", 32,  3,  128 },
-    { 0x4D02053, "250F128C", 32,  3,  128 },
-    { 0x4D04053, "250F128D", 32,  3,  128 },
-    { 0x938053,  "360F512L", 128, 12, 512 },
-    { 0x934053,  "360F256L", 128, 12, 256 },
-    { 0x92D053,  "340F128L", 128, 12, 128 },
-    { 0x92A053,  "320F128L", 128, 12, 128 },
-    { 0x916053,  "340F512H", 128, 12, 512 },
-    { 0x912053,  "340F256H", 128, 12, 256 },
-    { 0x90D053,  "340F128H", 128, 12, 128 },
-    { 0x90A053,  "320F128H", 128, 12, 128 },
-    { 0x906053,  "320F064H", 128, 12, 64  },
-    { 0x902053,  "320F032H", 128, 12, 32  },
-    { 0x978053,  "460F512L", 128, 12, 512 },
-    { 0x974053,  "460F256L", 128, 12, 256 },
-    { 0x96D053,  "440F128L", 128, 12, 128 },
-    { 0x952053,  "440F256H", 128, 12, 256 },
-    { 0x956053,  "440F512H", 128, 12, 512 },
-    { 0x94D053,  "440F128H", 128, 12, 128 },
-    { 0x942053,  "420F032H", 128, 12, 032 },
-    { 0x4307053, "795F512L", 128, 12, 512 },
-    { 0x430E053, "795F512H", 128, 12, 512 },
-    { 0x4306053, "775F512L", 128, 12, 512 },
-    { 0x430D053, "775F512H", 128, 12, 512 },
-    { 0x4312053, "775F256L", 128, 12, 256 },
-    { 0x4303053, "775F256H", 128, 12, 256 },
-    { 0x4417053, "764F128L", 128, 12, 128 },
-    { 0x440B053, "764F128H", 128, 12, 128 },
-    { 0x4341053, "695F512L", 128, 12, 512 },
-    { 0x4325053, "695F512H", 128, 12, 512 },
-    { 0x4311053, "675F512L", 128, 12, 512 },
-    { 0x430C053, "675F512H", 128, 12, 512 },
-    { 0x4305053, "675F256L", 128, 12, 256 },
-    { 0x430B053, "675F256H", 128, 12, 256 },
-    { 0x4413053, "664F128L", 128, 12, 128 },
-    { 0x4407053, "664F128H", 128, 12, 128 },
-    { 0x4411053, "664F064L", 128, 12, 64  },
-    { 0x4405053, "664F064H", 128, 12, 64  },
-    { 0x430F053, "575F512L", 128, 12, 512 },
-    { 0x4309053, "575F512H", 128, 12, 512 },
-    { 0x4333053, "575F256L", 128, 12, 256 },
-    { 0x4317053, "575F256H", 128, 12, 256 },
-    { 0x440F053, "564F128L", 128, 12, 128 },
-    { 0x4403053, "564F128H", 128, 12, 128 },
-    { 0x440D053, "564F064L", 128, 12, 64  },
-    { 0x4401053, "564F064H", 128, 12, 64  },
-    { 0x4400053, "534F064H", 128, 12, 64  },
-    { 0x440C053, "534F064L", 128, 12, 64  },
-    { 0,         "Unknown",  0,   0,  0   }
-};
+    // Generated from host/pic32devices.txt, see "make -C host devlist"
+#include "Pic32DevList.h"
 
 #endif
 
-
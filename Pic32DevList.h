@@ -0,0 +1,161 @@
+/* Generated by host/p32devgen from host/pic32devices.txt, do not edit. */
+
+#ifndef PIC32_DEV_LIST
+#define PIC32_DEV_LIST
+
+#define PIC32_DEVICE_COUNT 146
+
+    // Sorted by DevID, the "Unknown" entry after the last one
+PROGMEM const Pic32DevID_t Pic32DevIDList[] =
+{
+   // DevID      DevName       Family         RAM  BFM  PFM  Flags
+    { 0x902053,   "320F032H",   FAMILY_MX37,    8,  12,  32, 0 },
+    { 0x906053,   "320F064H",   FAMILY_MX37,   16,  12,  64, 0 },
+    { 0x90A053,   "320F128H",   FAMILY_MX37,   16,  12, 128, 0 },
+    { 0x90D053,   "340F128H",   FAMILY_MX37,   32,  12, 128, DEV_DMA_CRC },
+    { 0x912053,   "340F256H",   FAMILY_MX37,   32,  12, 256, DEV_DMA_CRC },
+    { 0x916053,   "340F512H",   FAMILY_MX37,   32,  12, 512, DEV_DMA_CRC },
+    { 0x92A053,   "320F128L",   FAMILY_MX37,   16,  12, 128, 0 },
+    { 0x92D053,   "340F128L",   FAMILY_MX37,   32,  12, 128, DEV_DMA_CRC },
+    { 0x934053,   "360F256L",   FAMILY_MX37,   32,  12, 256, DEV_DMA_CRC },
+    { 0x938053,   "360F512L",   FAMILY_MX37,   32,  12, 512, DEV_DMA_CRC },
+    { 0x942053,   "420F032H",   FAMILY_MX37,    8,  12,  32, 0 },
+    { 0x94D053,   "440F128H",   FAMILY_MX37,   32,  12, 128, DEV_DMA_CRC },
+    { 0x952053,   "440F256H",   FAMILY_MX37,   32,  12, 256, DEV_DMA_CRC },
+    { 0x956053,   "440F512H",   FAMILY_MX37,   32,  12, 512, DEV_DMA_CRC },
+    { 0x96D053,   "440F128L",   FAMILY_MX37,   32,  12, 128, DEV_DMA_CRC },
+    { 0x974053,   "460F256L",   FAMILY_MX37,   32,  12, 256, DEV_DMA_CRC },
+    { 0x978053,   "460F512L",   FAMILY_MX37,   32,  12, 512, DEV_DMA_CRC },
+    { 0x4303053,  "775F256H",   FAMILY_MX37,   64,  12, 256, DEV_DMA_CRC },
+    { 0x4305053,  "675F256L",   FAMILY_MX37,   64,  12, 256, DEV_DMA_CRC },
+    { 0x4306053,  "775F512L",   FAMILY_MX37,   64,  12, 512, DEV_DMA_CRC },
+    { 0x4307053,  "795F512L",   FAMILY_MX37,  128,  12, 512, DEV_DMA_CRC },
+    { 0x4309053,  "575F512H",   FAMILY_MX37,   64,  12, 512, DEV_DMA_CRC },
+    { 0x430B053,  "675F256H",   FAMILY_MX37,   64,  12, 256, DEV_DMA_CRC },
+    { 0x430C053,  "675F512H",   FAMILY_MX37,   64,  12, 512, DEV_DMA_CRC },
+    { 0x430D053,  "775F512H",   FAMILY_MX37,   64,  12, 512, DEV_DMA_CRC },
+    { 0x430E053,  "795F512H",   FAMILY_MX37,  128,  12, 512, DEV_DMA_CRC },
+    { 0x430F053,  "575F512L",   FAMILY_MX37,   64,  12, 512, DEV_DMA_CRC },
+    { 0x4311053,  "675F512L",   FAMILY_MX37,   64,  12, 512, DEV_DMA_CRC },
+    { 0x4312053,  "775F256L",   FAMILY_MX37,   64,  12, 256, DEV_DMA_CRC },
+    { 0x4317053,  "575F256H",   FAMILY_MX37,   64,  12, 256, DEV_DMA_CRC },
+    { 0x4325053,  "695F512H",   FAMILY_MX37,  128,  12, 512, DEV_DMA_CRC },
+    { 0x4333053,  "575F256L",   FAMILY_MX37,   64,  12, 256, DEV_DMA_CRC },
+    { 0x4341053,  "695F512L",   FAMILY_MX37,  128,  12, 512, DEV_DMA_CRC },
+    { 0x4400053,  "534F064H",   FAMILY_MX37,   16,  12,  64, DEV_DMA_CRC },
+    { 0x4401053,  "564F064H",   FAMILY_MX37,   32,  12,  64, DEV_DMA_CRC },
+    { 0x4403053,  "564F128H",   FAMILY_MX37,   32,  12, 128, DEV_DMA_CRC },
+    { 0x4405053,  "664F064H",   FAMILY_MX37,   32,  12,  64, DEV_DMA_CRC },
+    { 0x4407053,  "664F128H",   FAMILY_MX37,   32,  12, 128, DEV_DMA_CRC },
+    { 0x440B053,  "764F128H",   FAMILY_MX37,   32,  12, 128, DEV_DMA_CRC },
+    { 0x440C053,  "534F064L",   FAMILY_MX37,   16,  12,  64, DEV_DMA_CRC },
+    { 0x440D053,  "564F064L",   FAMILY_MX37,   32,  12,  64, DEV_DMA_CRC },
+    { 0x440F053,  "564F128L",   FAMILY_MX37,   32,  12, 128, DEV_DMA_CRC },
+    { 0x4411053,  "664F064L",   FAMILY_MX37,   32,  12,  64, DEV_DMA_CRC },
+    { 0x4413053,  "664F128L",   FAMILY_MX37,   32,  12, 128, DEV_DMA_CRC },
+    { 0x4417053,  "764F128L",   FAMILY_MX37,   32,  12, 128, DEV_DMA_CRC },
+    { 0x4A00053,  "220F032B",   FAMILY_MX12,    8,   3,  32, DEV_DMA_CRC },
+    { 0x4A01053,  "210F016B",   FAMILY_MX12,    4,   3,  16, DEV_DMA_CRC },
+    { 0x4A02053,  "220F032C",   FAMILY_MX12,    8,   3,  32, DEV_DMA_CRC },
+    { 0x4A03053,  "210F016C",   FAMILY_MX12,    4,   3,  16, DEV_DMA_CRC },
+    { 0x4A04053,  "220F032D",   FAMILY_MX12,    8,   3,  32, DEV_DMA_CRC },
+    { 0x4A05053,  "210F016D",   FAMILY_MX12,    4,   3,  16, DEV_DMA_CRC },
+    { 0x4A06053,  "120F032B",   FAMILY_MX12,    8,   3,  32, DEV_DMA_CRC },
+    { 0x4A07053,  "110F016B",   FAMILY_MX12,    4,   3,  16, DEV_DMA_CRC },
+    { 0x4A08053,  "120F032C",   FAMILY_MX12,    8,   3,  32, DEV_DMA_CRC },
+    { 0x4A09053,  "110F016C",   FAMILY_MX12,    4,   3,  16, DEV_DMA_CRC },
+    { 0x4A0A053,  "120F032D",   FAMILY_MX12,    8,   3,  32, DEV_DMA_CRC },
+    { 0x4A0B053,  "110F016D",   FAMILY_MX12,    4,   3,  16, DEV_DMA_CRC },
+    { 0x4D00053,  "250F128B",   FAMILY_MX12,   32,   3, 128, DEV_DMA_CRC },
+    { 0x4D01053,  "230F064B",   FAMILY_MX12,   16,   3,  64, DEV_DMA_CRC },
+    { 0x4D02053,  "250F128C",   FAMILY_MX12,   32,   3, 128, DEV_DMA_CRC },
+    { 0x4D03053,  "230F064C",   FAMILY_MX12,   16,   3,  64, DEV_DMA_CRC },
+    { 0x4D04053,  "250F128D",   FAMILY_MX12,   32,   3, 128, DEV_DMA_CRC },
+    { 0x4D05053,  "230F064D",   FAMILY_MX12,   16,   3,  64, DEV_DMA_CRC },
+    { 0x4D06053,  "150F128B",   FAMILY_MX12,   32,   3, 128, DEV_DMA_CRC },
+    { 0x4D07053,  "130F064B",   FAMILY_MX12,   16,   3,  64, DEV_DMA_CRC },
+    { 0x4D08053,  "150F128C",   FAMILY_MX12,   32,   3, 128, DEV_DMA_CRC },
+    { 0x4D09053,  "130F064C",   FAMILY_MX12,   16,   3,  64, DEV_DMA_CRC },
+    { 0x4D0A053,  "150F128D",   FAMILY_MX12,   32,   3, 128, DEV_DMA_CRC },
+    { 0x4D0B053,  "130F064D",   FAMILY_MX12,   16,   3,  64, DEV_DMA_CRC },
+    { 0x5103053,  "1024ECG064", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x5104053,  "2048ECG064", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x5108053,  "1024ECH064", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x5109053,  "2048ECH064", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x510D053,  "1024ECG100", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x510E053,  "2048ECG100", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x5112053,  "1024ECH100", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x5113053,  "2048ECH100", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x5117053,  "1024ECG124", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x5118053,  "2048ECG124", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x511C053,  "1024ECH124", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x511D053,  "2048ECH124", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x5121053,  "1024ECG144", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x5122053,  "2048ECG144", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x5126053,  "1024ECH144", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x5127053,  "2048ECH144", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x5130053,  "1024ECM064", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x5131053,  "2048ECM064", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x513A053,  "1024ECM100", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x513B053,  "2048ECM100", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x5144053,  "1024ECM124", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x5145053,  "2048ECM124", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x514E053,  "1024ECM144", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x514F053,  "2048ECM144", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x6600053,  "270F256B",   FAMILY_MX12,   64,   3, 256, DEV_DMA_CRC },
+    { 0x660A053,  "270F256D",   FAMILY_MX12,   64,   3, 256, DEV_DMA_CRC },
+    { 0x660C053,  "270F25DB",   FAMILY_MX12,   64,   3, 256, DEV_DMA_CRC },
+    { 0x6610053,  "170F256B",   FAMILY_MX12,   64,   3, 256, DEV_DMA_CRC },
+    { 0x661A053,  "170F256D",   FAMILY_MX12,   64,   3, 256, DEV_DMA_CRC },
+    { 0x7201053,  "0512EFE064", FAMILY_MZ,    128,  80, 512, DEV_DMA_CRC },
+    { 0x7202053,  "1024EFE064", FAMILY_MZ,    256,  80, 1024, DEV_DMA_CRC },
+    { 0x7206053,  "0512EFF064", FAMILY_MZ,    128,  80, 512, DEV_DMA_CRC },
+    { 0x7207053,  "1024EFF064", FAMILY_MZ,    256,  80, 1024, DEV_DMA_CRC },
+    { 0x720B053,  "0512EFE100", FAMILY_MZ,    128,  80, 512, DEV_DMA_CRC },
+    { 0x720C053,  "1024EFE100", FAMILY_MZ,    256,  80, 1024, DEV_DMA_CRC },
+    { 0x7210053,  "0512EFF100", FAMILY_MZ,    128,  80, 512, DEV_DMA_CRC },
+    { 0x7211053,  "1024EFF100", FAMILY_MZ,    256,  80, 1024, DEV_DMA_CRC },
+    { 0x7215053,  "0512EFE124", FAMILY_MZ,    128,  80, 512, DEV_DMA_CRC },
+    { 0x7216053,  "1024EFE124", FAMILY_MZ,    256,  80, 1024, DEV_DMA_CRC },
+    { 0x721A053,  "0512EFF124", FAMILY_MZ,    128,  80, 512, DEV_DMA_CRC },
+    { 0x721B053,  "1024EFF124", FAMILY_MZ,    256,  80, 1024, DEV_DMA_CRC },
+    { 0x721F053,  "0512EFE144", FAMILY_MZ,    128,  80, 512, DEV_DMA_CRC },
+    { 0x7220053,  "1024EFE144", FAMILY_MZ,    256,  80, 1024, DEV_DMA_CRC },
+    { 0x7224053,  "0512EFF144", FAMILY_MZ,    128,  80, 512, DEV_DMA_CRC },
+    { 0x7225053,  "1024EFF144", FAMILY_MZ,    256,  80, 1024, DEV_DMA_CRC },
+    { 0x722E053,  "0512EFK064", FAMILY_MZ,    128,  80, 512, DEV_DMA_CRC },
+    { 0x722F053,  "1024EFK064", FAMILY_MZ,    256,  80, 1024, DEV_DMA_CRC },
+    { 0x7238053,  "0512EFK100", FAMILY_MZ,    128,  80, 512, DEV_DMA_CRC },
+    { 0x7239053,  "1024EFK100", FAMILY_MZ,    256,  80, 1024, DEV_DMA_CRC },
+    { 0x7242053,  "0512EFK124", FAMILY_MZ,    128,  80, 512, DEV_DMA_CRC },
+    { 0x7243053,  "1024EFK124", FAMILY_MZ,    256,  80, 1024, DEV_DMA_CRC },
+    { 0x724C053,  "0512EFK144", FAMILY_MZ,    128,  80, 512, DEV_DMA_CRC },
+    { 0x724D053,  "1024EFK144", FAMILY_MZ,    256,  80, 1024, DEV_DMA_CRC },
+    { 0x7250053,  "1024EFG064", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x7251053,  "2048EFG064", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x7255053,  "1024EFH064", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x7256053,  "2048EFH064", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x725A053,  "1024EFG100", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x725B053,  "2048EFG100", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x725F053,  "1024EFH100", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x7260053,  "2048EFH100", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x7264053,  "1024EFG124", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x7265053,  "2048EFG124", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x7269053,  "1024EFH124", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x726A053,  "2048EFH124", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x726E053,  "1024EFG144", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x726F053,  "2048EFG144", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x7273053,  "1024EFH144", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x7274053,  "2048EFH144", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x7278053,  "1024EFM064", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x7279053,  "2048EFM064", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x7282053,  "1024EFM100", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x7283053,  "2048EFM100", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x728C053,  "1024EFM124", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x728D053,  "2048EFM124", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0x7296053,  "1024EFM144", FAMILY_MZ,    512,  80, 1024, DEV_DMA_CRC },
+    { 0x7297053,  "2048EFM144", FAMILY_MZ,    512,  80, 2048, DEV_DMA_CRC },
+    { 0,          "Unknown",    FAMILY_MX12,    0,   0,   0, 0 }
+};
+
+#endif
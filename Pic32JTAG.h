@@ -37,6 +37,7 @@
 #define MTAP_SW_ETAP "MTAP_SW_ETAP",5,0x05
 #define MTAP_IDCODE   "MTAP_IDCODE",5,0x01
 
+#define ETAP_IMPCODE     "ETAP_IMPCODE",5,0x03
 #define ETAP_ADDRESS     "ETAP_ADDRESS",5,0x08
 #define ETAP_DATA           "ETAP_DATA",5,0x09
 #define ETAP_CONTROL     "ETAP_CONTROL",5,0x0A
@@ -53,20 +54,61 @@
 
 #define DATA_IDCODE                    "IDCODE",32,0x0
 
+    // ETAP_CONTROL scans to wait for PrAcc before giving up on an instruction
+#define PRACC_POLL_TRIES 1000
+
+    // EJTAG DMA access: IMPCODE and ETAP_CONTROL bits. ECR_PROBE keeps
+    // PrAcc set so a pending processor access is left alone.
+#define IMPCODE_NODMA   0x00004000
+#define ECR_PROBE       0x0004C000
+#define ECR_DMAACC      0x00020000
+#define ECR_DSTRT       0x00000800
+#define ECR_DERR        0x00000400
+#define ECR_DRWN        0x00000200
+#define ECR_DSZ_WORD    0x00000100
+#define DMA_POLL_TRIES  100
+
 bool _debug = 0;
 
 class Pic32JTAG: public ArduinoJTAG {
 
 private:
     bool prAcc_;
+    bool controlIR_;        // ETAP_CONTROL still selected by the last release
+    bool fusePrAcc_;
+    uint16_t pollTimeouts_;
+    uint32_t instructions_;
 
 protected:
-    Pic32JTAG()
+    Pic32JTAG( uint8_t port = 0 )
+        : ArduinoJTAG( port )
     {
-        
+        controlIR_    = false;
+        fusePrAcc_    = true;
+        pollTimeouts_ = 0;
+        instructions_ = 0;
     }
 
 public:
+        // Instructions dropped because the CPU never asked for them
+    uint16_t GetPollTimeouts()
+    {
+        return pollTimeouts_;
+    }
+
+        // Instructions fed to the CPU so far
+    uint32_t GetInstructionCount()
+    {
+        return instructions_;
+    }
+
+        // Off: every instruction selects ETAP_CONTROL again for its poll
+    void SetPrAccFusion(bool on)
+    {
+        fusePrAcc_ = on;
+        controlIR_ = false;
+    }
+
     void SetReset(bool set)
     {
         if ( set )
@@ -81,122 +123,31 @@ protected:
       uint32_t data = 0;
       if (_debug) Serial.println(F("SetMode"));
 
-      ClearTDI();
+      controlIR_ = false;
 
-      unsigned char bitnum = 0;
-      while (bits--)
-      {
-        if ( mode & 0x01 )
-        {
-            SetTMS();
-        }
-        else
-        {
-            ClearTMS();
-        }
-        mode >>= 1;
-
-        bool tdo = ClockPulse();
-        data |= (uint32_t)tdo << bitnum;
-        ++bitnum;
-      }
+      data = ShiftTMS(bits, mode);
 
       if (_debug) Serial.println(data, HEX);
       return data;
     }
 
-    void SendCommand(char* cmdname, unsigned char bits, uint32_t cmd)
+    void SendCommand(const char* cmdname, unsigned char bits, uint32_t cmd)
     {
-      uint32_t data = 0;
-      if (_debug) Serial.println(cmdname);
-
-      ClearTDI();
-      SetTMS();
-      ClockPulse();
-      ClockPulse();
-      ClearTMS();
-      ClockPulse();
-      ClockPulse();
-
-      unsigned char bitnum = 0;
-      while ( bits-- )
+      controlIR_ = false;
+      if (_debug)
       {
-          if ( !bits )
-          {
-              SetTMS();
-          }
-
-          if ( cmd & 0x01 )
-          {
-              SetTDI();
-          }
-          else
-          {
-              ClearTDI();
-          }
-          cmd >>= 1;
-
-          bool tdo = ClockPulse();
-          data |= (uint32_t)tdo << bitnum;
-          bitnum++;
+          Serial.println(cmdname);
+          Serial.println(ScanIR(bits, cmd), HEX);
       }
-
-      ClearTDI();
-      ClockPulse();
-      ClearTMS();
-      ClockPulse();  
-
-      if (_debug) Serial.println(data, HEX);
-    }
-
-    uint32_t XferDataData(unsigned char bits, uint32_t cmd)
-    {
-      uint32_t data = 0;  
-      unsigned char bitnum = 0;
-      while ( bits-- )
+      else
       {
-        if ( !bits )
-        {
-            SetTMS();
-        }
-
-        if ( cmd & 0x01 )
-        {
-            SetTDI();
-        }
-        else
-        {
-            ClearTDI();
-        }
-        cmd >>= 1;
-
-        bool tdo = ClockPulse();
-        data |= (uint32_t)tdo << bitnum;
-        bitnum++;
+          WriteIR(bits, cmd);
       }
-      return data;
     }
 
-
     uint32_t XferData(unsigned char bits, uint32_t cmd)
     {
-      uint32_t data = 0;
-
-      ClearTDI();
-      SetTMS();
-      ClockPulse();
-      ClearTMS();
-      ClockPulse();
-      ClockPulse();
-
-      data = XferDataData(bits, cmd);
-
-      ClearTDI();
-      ClockPulse();
-      ClearTMS();
-      ClockPulse();  
-
-      return data;
+      return ScanDR(bits, cmd);
     }
 
     uint32_t XferFastData(uint32_t cmd)
@@ -206,24 +157,7 @@ protected:
       if (_debug) Serial.print("XferFastData ");
       if (_debug) Serial.println(cmd, HEX);
 
-      do
-      {
-          SetTMS();
-          ClockPulse();
-          ClearTMS();
-          ClockPulse();
-          ClockPulse();
-
-          ClearTDI();
-          prAcc_ = ClockPulse();  
-          data = XferDataData(32, cmd);
-
-          ClearTDI();
-          ClockPulse();
-          ClearTMS();
-          ClockPulse();
-
-      } while(0);
+      data = ScanDR(32, cmd, prAcc_);
 
       return data;
     }
@@ -233,7 +167,7 @@ protected:
         return prAcc_;
     }
 
-    uint32_t XferData(char* cmdname, unsigned char bits, uint32_t cmd)
+    uint32_t XferData(const char* cmdname, unsigned char bits, uint32_t cmd)
     {
       uint32_t data = 0;
       if (_debug) Serial.println(cmdname);
@@ -243,28 +177,114 @@ protected:
     }
 
 
-    void XferInstruction(uint32_t instr)
+        // Chip erase, done once MCHP_STATUS shows CFGRDY and not FCBUSY.
+        // MTAP_COMMAND is left selected for reading it.
+    void EraseStart()
+    {
+        SendCommand(MTAP_SW_MTAP);
+        SendCommand(MTAP_COMMAND);
+        XferData(MCHP_ERASE);
+    }
+
+        // False if the EJTAG implementation has no DMA access
+    bool HasDMA()
+    {
+        SendCommand(ETAP_IMPCODE);
+        return !(XferData(32, 0) & IMPCODE_NODMA);
+    }
+
+        // One word over EJTAG DMA, no instruction is executed. The
+        // address is physical. False on a bus error or timeout.
+    bool XferDMA(uint32_t addr, uint32_t & data, bool read)
+    {
+      uint32_t ecr = ECR_PROBE | ECR_DMAACC | ECR_DSZ_WORD | (read ? ECR_DRWN : 0);
+      uint8_t  tries = DMA_POLL_TRIES;
+      uint32_t status;
+
+      if (_debug) Serial.print(read ? "DMA read 0x" : "DMA write 0x");
+      if (_debug) Serial.println(addr, HEX);
+
+      SendCommand(ETAP_ADDRESS);
+      WriteDR(32, addr & 0x1fffffff);
+      if ( !read )
+      {
+          SendCommand(ETAP_DATA);
+          WriteDR(32, data);
+      }
+
+      SendCommand(ETAP_CONTROL);
+      WriteDR(32, ecr | ECR_DSTRT);
+      while ( ((status = ScanDR(32, ecr)) & ECR_DSTRT) && --tries )
+      {
+      }
+
+      if ( read )
+      {
+          SendCommand(ETAP_DATA);
+          data = ScanDR(32, 0);
+          SendCommand(ETAP_CONTROL);
+      }
+      WriteDR(32, ECR_PROBE);
+
+      if ( !tries || (status & ECR_DERR) )
+      {
+          ++pollTimeouts_;
+          return false;
+      }
+      return true;
+    }
+
+        // The release leaves ETAP_CONTROL in IR, so back to back
+        // instructions poll PrAcc for the next one without another IR
+        // scan. The poll itself stays: the release scan captures the
+        // access being finished, not the next one. False if the CPU never
+        // asked for the instruction: it is lost and every later one is
+        // out of step, so the caller has to give up (see
+        // FlashWriter::LinkOk()).
+    bool XferInstruction(uint32_t instr)
     {
-      uint32_t controlVal = 0;
+      bool fetched;
+
       if (_debug) Serial.print("XferInstruction 0x");
       if (_debug) Serial.println(instr, HEX);
 
-      SendCommand(ETAP_CONTROL);
-      do
+      if ( !controlIR_ )
       {
-        controlVal = XferData(32, 0x0004C000);
-        if ((controlVal & 0x00040000) == 0)
-        {
-            delay(1000);
-        }
-      } while ( (controlVal & 0x00040000) == 0 );
+          SendCommand(ETAP_CONTROL);
+      }
+      fetched = PollDR(32, 0x0004C000, 0x00040000, PRACC_POLL_TRIES);
+      if ( !fetched )
+      {
+          ++pollTimeouts_;
+      }
 
       SendCommand(ETAP_DATA);
-      XferData(32, instr);
+      WriteDR(32, instr);
       SendCommand(ETAP_CONTROL);
-      XferData(32, 0x0000C000);
+      WriteDR(32, 0x0000C000);
+
+      controlIR_ = fusePrAcc_;
+      ++instructions_;
+      return fetched;
+    }
+
+    void XferInstructions(const uint32_t *code, uint8_t n)
+    {
+      while ( n-- )
+      {
+          XferInstruction( *code++ );
+      }
+    }
+
+        // Same, code in PROGMEM
+    void XferInstructions_P(const uint32_t *code, uint8_t n)
+    {
+      while ( n-- )
+      {
+          XferInstruction( pgm_read_dword( code++ ) );
+      }
     }
 
 };
 
-#endif //INCLUDE_PIC32_JTAG_H
+#endif //INCLUDE_PIC32_JTAG_H
@@ -43,12 +43,105 @@ enum mchp_status_e {
     DEVRST   = 0x01    // Device Reset State    ( 1 = Device Reset is Active )
 };
 
+#define STATUS_POLL_MS 1     // MCHP_STATUS poll interval while not ready
+
+    // Memory accesses SelectMemoryPaths() may move to EJTAG DMA
+enum dma_path_e {
+    DMA_READ  = 0x01,   // ReadFlashData()
+    DMA_BLOCK = 0x02,   // ReadFlashBlock()
+    DMA_WRITE = 0x04    // RAM fills and NVMDATA pokes
+};
+
+#define NVM_SFR_BASE 0xBF800000
+
+    // FlashOperation() steps 5 to 8, a0..a3/s1/s2 set up by step 1
+PROGMEM const uint32_t NvmStartWrite[] =
+{
+    0xac910010,     // sw s1, 16(a0)    unlock NVMCON and start write
+    0xac920010,     // sw s2, 16(a0)
+    0xac860008,     // sw a2, 8(a0)     NOTE: offset 8 is the "set" register
+    0x8c880000,     // <here2> lw t0, 0(a0)   poll NVMCON(WR) clear
+    0x01064024,     // and t0, t0, a2
+    0x1500fffd,     // bne t0, $0, <here2>
+    0x00000000,     // nop
+    0x00000000,     // nop              wait at least 500ns, 8MHz clock assumed
+    0x00000000,     // nop
+    0x00000000,     // nop
+    0x00000000,     // nop
+    0xac870004      // sw a3, 4(a0)     NOTE: offset 4 is the "clear" register
+};
+#define NVM_START_WRITE_LEN (sizeof(NvmStartWrite) / sizeof(NvmStartWrite[0]))
+#define NVM_WRITE_STARTED   3      // the NVM is busy after these
+
+    //
+    // PIC32MZ only, after FlashOperation() step 1: NVMPWP and NVMBWP come
+    // out of reset with the lower boot flash pages write protected, and
+    // each write needs the NVMKEY sequence. Leaves PWPULOCK, LBWPULOCK and
+    // UBWPULOCK set and no page protected, until the next reset.
+    //
+PROGMEM const uint32_t NvmWriteProtectOff[] =
+{
+    0x3c088000,     // lui t0, 0x8000   PWPULOCK, PWP = 0
+    0xac800010,     // sw $0, 16(a0)    NVMKEY sequence
+    0xac910010,     // sw s1, 16(a0)
+    0xac920010,     // sw s2, 16(a0)
+    0xac880080,     // sw t0, 0x80(a0)  NVMPWP
+    0x34088080,     // ori t0, $0, 0x8080   LBWPULOCK | UBWPULOCK, LBWP = UBWP = 0
+    0xac800010,     // sw $0, 16(a0)
+    0xac910010,     // sw s1, 16(a0)
+    0xac920010,     // sw s2, 16(a0)
+    0xac880090      // sw t0, 0x90(a0)  NVMBWP
+};
+#define NVM_WP_OFF_LEN (sizeof(NvmWriteProtectOff) / sizeof(NvmWriteProtectOff[0]))
+
+    //
+    // CompareRow() loop, run from target RAM. In: t0 flash, s0 row
+    // buffer, a1 words (a multiple of 32), t3 map. Out: a bit per word
+    // that differs at t3, then (count << 16) | first index, n if none.
+    // Returns through ra to the debug vector, where PrAcc takes over.
+    //
+PROGMEM const uint32_t RowCompareCode[] =
+{
+    0x00007021,     // addu t6, $0, $0          i = 0
+    0x00001021,     // addu v0, $0, $0          count = 0
+    0x00a01821,     // addu v1, a1, $0          first = n
+    0x00006821,     // <word> addu t5, $0, $0   map word
+    0x340c0001,     // ori t4, $0, 1            bit
+    0x8d090000,     // <bit> lw t1, 0(t0)
+    0x8e0a0000,     // lw t2, 0(s0)
+    0x25080004,     // addiu t0, t0, 4
+    0x112a0005,     // beq t1, t2, <next>
+    0x26100004,     // addiu s0, s0, 4
+    0x01ac6825,     // or t5, t5, t4
+    0x14400002,     // bne v0, $0, <next>
+    0x24420001,     // addiu v0, v0, 1
+    0x01c01821,     // addu v1, t6, $0
+    0x25ce0001,     // <next> addiu t6, t6, 1
+    0x000c6040,     // sll t4, t4, 1
+    0x1580fff4,     // bne t4, $0, <bit>
+    0x00000000,     // nop
+    0xad6d0000,     // sw t5, 0(t3)
+    0x15c5ffef,     // bne t6, a1, <word>
+    0x256b0004,     // addiu t3, t3, 4
+    0x00021400,     // sll v0, v0, 16
+    0x00431025,     // or v0, v0, v1
+    0xad620000,     // sw v0, 0(t3)
+    0x03e00008,     // jr ra
+    0x00000000      // nop
+};
+#define ROW_COMPARE_LEN    (sizeof(RowCompareCode) / sizeof(RowCompareCode[0]))
+#define ROW_COMPARE_MAP    0x80     // map offset from the code
+#define ROW_COMPARE_BYTES  (ROW_COMPARE_MAP + 512 / 8 + 4)
+#define ROW_COMPARE_ALIGN  0x800    // BMXDKPBA steps on MX, see LoadRowCompare()
+#define ROW_COMPARE_FAILED 0xffff   // CompareRow(): the loop did not report
+
 enum nvmop_e {
     NVMOP_NOP        = 0,
     NVMOP_WRITE_WORD = 1,
+    NVMOP_WRITE_QUAD = 2,   // PIC32MZ: NVMDATA0..3 in one go
     NVMOP_WRITE_ROW  = 3,
     NVMOP_ERASE_PAGE = 4,
-    NVMOP_ERASE_PFM  = 5,   // Erase whole Program Flash Memory (PFM)
+    NVMOP_ERASE_PFM  = 5,   // Erase whole Program Flash Memory (PFM), MX
 };
 
 class Pic32JTAGDevice: public Pic32JTAG {
@@ -56,7 +149,12 @@ private:
     uint32_t DeviceID_;
     uint32_t MyStatus_;
     bool     InPgmMode_;
+    uint16_t RowBase_;      // RAM offset s0 holds for RowBufferWord()
+    uint8_t  DMAPaths_;     // dma_path_e
+    uint16_t CompareCode_;  // RAM offset of RowCompareCode, 0xffff if not loaded
+    bool     WPOff_;        // MZ: NvmWriteProtectOff run since EnterPgmMode()
     struct Pic32DevID_t DevID_;
+    struct Pic32Family_t Family_;
 
 public:
 
@@ -70,16 +168,49 @@ public:
         return DevID_.DevName;
     }
 
+    bool IsKnown()
+    {
+        return DevID_.DevID != 0;
+    }
+
+    char* GetFamilyName()
+    {
+        return Family_.Prefix;
+    }
+
+    uint8_t GetRevision()
+    {
+        return DeviceID_ >> 28;
+    }
+
     uint32_t GetRowSize()
     {
-        return (uint32_t)DevID_.RowSize * 4;
+        return (uint32_t)Family_.RowSize * 4;
     }
 
     uint32_t GetPageSize()
     {
-        return (uint32_t)DevID_.RowSize * 4 * 8;
+        return GetRowSize() * Family_.PageRows;
+    }
+
+    uint32_t GetRAMSize()
+    {
+        return (uint32_t)DevID_.RAMSize * 1024;
+    }
+
+    bool HasDMACRC()
+    {
+        return DevID_.Flags & DEV_DMA_CRC;
     }
 
+        // Bytes programmed by WriteWide(), 4 or 16
+    uint8_t GetWriteBytes()   { return Family_.WriteBytes; }
+
+    uint8_t GetWordWriteUs()  { return Family_.WordWriteUs; }
+    uint8_t GetRowWriteMs()   { return Family_.RowWriteMs; }
+    uint8_t GetPageEraseMs()  { return Family_.PageEraseMs; }
+    uint8_t GetEraseAllMs()   { return Family_.EraseAllMs; }
+
     uint32_t GetBootFlashMemorySize()
     {
         return (uint32_t)DevID_.BFMSize * 1024;
@@ -100,6 +231,18 @@ public:
         return 0x1FC00000 + GetBootFlashMemorySize() - 1;
     }
 
+        // MZ: the upper boot alias, the boot flash panel that is not
+        // mapped at 0x1FC00000, the same size. 0 on MX, which has one.
+    uint32_t GetBootFlash2Start()
+    {
+        return DevID_.Family == FAMILY_MZ ? 0x1FC20000 : 0;
+    }
+
+    uint32_t GetBootFlash2End()
+    {
+        return GetBootFlash2Start() + GetBootFlashMemorySize() - 1;
+    }
+
     uint32_t GetProgramFlashStart()
     {
         return 0x1D000000;
@@ -112,23 +255,33 @@ public:
 
     uint32_t GetConfigurationMemStart()
     {
+            // MZ keeps DEVCFG3..0 below the lower boot flash sequence words
+        if ( DevID_.Family == FAMILY_MZ )
+            return 0x1FC0FFC0;
+
         return GetBootFlashEnd() + 1 - 4*4;
     }
 
-    uint32_t CheckStatus( )
+        // One MCHP_STATUS read, true once configured and not busy
+    bool StatusReady()
     {
-        SetReset(true);
-        SetMode(6, 0x1f);
         SendCommand(MTAP_SW_MTAP);
         SendCommand(MTAP_COMMAND);
         MyStatus_ = XferData(MCHP_STATUS);
 
-        while ( ((MyStatus_ & CFGRDY) == 0) || 
-                 (MyStatus_ & FCBUSY) )
+        return (MyStatus_ & CFGRDY) && !(MyStatus_ & FCBUSY);
+    }
+
+    uint32_t CheckStatus( )
+    {
+        SetReset(true);
+        SetMode(6, 0x1f);
+
+        while ( !StatusReady() )
         {
-            delay(1000); 
-            MyStatus_ = XferData(MCHP_STATUS);
+            delay(STATUS_POLL_MS); 
         }
+        return MyStatus_;
     }
 
     bool NeedsErase()
@@ -142,9 +295,7 @@ public:
         
         if ( !InPgmMode_ )
         {
-            SendCommand(MTAP_SW_MTAP);
-            SendCommand(MTAP_COMMAND);
-            XferData(MCHP_ERASE);
+            EraseStart();
             delay(1);
             MyStatus_ = XferData(MCHP_STATUS);
 
@@ -161,6 +312,10 @@ public:
 
     void EnterPgmMode()
     {
+        RowBase_ = 0xffff;
+        DMAPaths_ = 0;
+        CompareCode_ = 0xffff;
+        WPOff_ = false;
         SetReset(true);
         SendCommand(MTAP_SW_ETAP);
         SendCommand(ETAP_EJTAGBOOT);
@@ -179,6 +334,14 @@ public:
     }
 
 
+        // IDCODE from a fresh TAP reset, whatever TAP was selected
+    uint32_t ProbeIDCode()
+    {
+        SetMode(6, 0x1f);
+        SendCommand(MTAP_SW_MTAP);
+        return ReadIDCodeRegister();
+    }
+
     uint32_t ReadIDCodeRegister(  )
     {
         SendCommand(MTAP_IDCODE);
@@ -189,6 +352,14 @@ public:
 
     void DownloadData( uint16_t ram_addr, uint32_t data )
     {      
+        if ( DMAPaths_ & DMA_WRITE )
+        {
+            XferDMA( ram_addr, data, false );
+            XferDMA( NVM_SFR_BASE + Family_.NVMCon + 0x30, data, false );
+            return;
+        }
+        RowBase_ = 0xffff;
+
             // lui s0, 0xa000
         XferInstruction( 0x3c10a000 );
             // ori s0, 0
@@ -206,15 +377,225 @@ public:
 
             // lui a0, 0xbf80
         XferInstruction( 0x3c04bf80 );
-            // ori a0, 0xf400
-        XferInstruction( 0x3484f400 );
+            // ori a0, <NVMCON(15:0)>
+        XferInstruction( 0x34840000 + Family_.NVMCon );
             // sw t0, 48(a0)
         XferInstruction( 0xac880030 );
     }
 
 
+        //
+        // PIC32MZ: load NVMDATA0..3 for NVMOP_WRITE_QUAD
+        //
+    void DownloadQuad( const uint32_t *data )
+    {
+        uint8_t i;
+
+        if ( DMAPaths_ & DMA_WRITE )
+        {
+            for ( i = 0; i < 4; ++i )
+            {
+                uint32_t d = data[i];
+                XferDMA( NVM_SFR_BASE + Family_.NVMCon + 0x30 + 0x10 * i, d, false );
+            }
+            return;
+        }
+
+            // lui a0, 0xbf80
+        XferInstruction( 0x3c04bf80 );
+            // ori a0, <NVMCON(15:0)>
+        XferInstruction( 0x34840000 + Family_.NVMCon );
+
+        for ( i = 0; i < 4; ++i )
+        {
+                // lui t0, <DATA(31:16)>
+            XferInstruction( 0x3c080000 + (data[i]>>16) );
+                // ori t0, <DATA(15:0)>
+            XferInstruction( 0x35080000 + (data[i]&0xffff) );
+                // sw t0, <NVMDATAi>(a0)
+            XferInstruction( 0xac880030 + 0x10 * i );
+        }
+    }
+
+
+        //
+        // Row buffer in target RAM for NVMOP_WRITE_ROW: one word at
+        // 0xA0000000 + base + 4 * i. s0 keeps pointing at the buffer
+        // between calls, so a word costs three instructions or fewer
+        // (DownloadData() needs ten). Everything else that uses s0
+        // resets RowBase_.
+        //
+    void RowBufferWord( uint16_t base, uint16_t i, uint32_t data )
+    {
+        if ( DMAPaths_ & DMA_WRITE )
+        {
+            XferDMA( base + 4 * i, data, false );
+            return;
+        }
+        if ( RowBase_ != base )
+        {
+                // lui s0, 0xa000
+            XferInstruction( 0x3c10a000 );
+                // ori s0, <base>
+            XferInstruction( 0x36100000 + base );
+            RowBase_ = base;
+        }
+
+        if ( data >> 16 )
+        {
+                // lui t0, <DATA(31:16)>
+            XferInstruction( 0x3c080000 + (data>>16) );
+            if ( data & 0xffff )
+            {
+                    // ori t0, <DATA(15:0)>
+                XferInstruction( 0x35080000 + (data&0xffff) );
+            }
+        }
+        else
+        {
+                // ori t0, $0, <DATA(15:0)>
+            XferInstruction( 0x34080000 + data );
+        }
+            // sw t0, <4*i>(s0)
+        XferInstruction( 0xae080000 + 4 * i );
+    }
+
+
+        //
+        // Puts RowCompareCode at RAM offset code. On MX, RAM is only
+        // executable above BMXDKPBA, so the bus matrix is set up the way
+        // the programming executive is loaded: kernel program RAM from
+        // code to the end.
+        //
+    void LoadRowCompare( uint16_t code )
+    {
+        uint8_t i;
+
+        if ( DevID_.Family != FAMILY_MZ )
+        {
+                // lui a0, 0xbf88
+            XferInstruction( 0x3c04bf88 );
+                // ori a0, a0, 0x2000
+            XferInstruction( 0x34842000 );
+                // lui a1, 0x001f
+            XferInstruction( 0x3c05001f );
+                // ori a1, a1, 0x0040
+            XferInstruction( 0x34a50040 );
+                // sw a1, 0(a0)     BMXCON
+            XferInstruction( 0xac850000 );
+                // ori a1, $0, <code>
+            XferInstruction( 0x34050000 + code );
+                // sw a1, 16(a0)    BMXDKPBA
+            XferInstruction( 0xac850010 );
+                // lw a1, 64(a0)    BMXDRMSZ
+            XferInstruction( 0x8c850040 );
+                // sw a1, 32(a0)    BMXDUDBA
+            XferInstruction( 0xac850020 );
+                // sw a1, 48(a0)    BMXDUPBA
+            XferInstruction( 0xac850030 );
+        }
+
+        for ( i = 0; i < ROW_COMPARE_LEN; ++i )
+        {
+            RowBufferWord( code, i, pgm_read_dword( &RowCompareCode[i] ) );
+        }
+        CompareCode_ = code;
+    }
+
+        //
+        // Compares n flash words at flash_addr with the row buffer at
+        // base. The loop runs on the target from RAM offset code (loaded
+        // on first use, ROW_COMPARE_BYTES), so only its result comes
+        // back: the index of the first mismatch, n if none, and in bad
+        // the number of words that differ. Which ones is left in the
+        // map, see CompareMap(). ROW_COMPARE_FAILED if the loop did not
+        // run to the end.
+        //
+    uint16_t CompareRow( uint32_t flash_addr, uint16_t base, uint16_t n,
+                         uint16_t code, uint16_t & bad )
+    {
+        uint16_t result = code + ROW_COMPARE_MAP + n / 8;
+        uint32_t data;
+
+        if ( CompareCode_ != code )
+        {
+            LoadRowCompare( code );
+        }
+        RowBufferWord( result, 0, 0xffffffff );
+        RowBase_ = 0xffff;
+
+            // lui t0, <FLASH_WORD_ADDR(31:16)>
+        XferInstruction( 0x3c080000 + (flash_addr>>16) );
+            // ori t0, <FLASH_WORD_ADDR(15:0)>
+        XferInstruction( 0x35080000 + (flash_addr&0xffff) );
+            // lui s0, 0xa000
+        XferInstruction( 0x3c10a000 );
+            // ori s0, <base>
+        XferInstruction( 0x36100000 + base );
+            // ori a1, $0, <n>
+        XferInstruction( 0x34050000 + n );
+            // lui t3, 0xa000
+        XferInstruction( 0x3c0ba000 );
+            // ori t3, <code + ROW_COMPARE_MAP>
+        XferInstruction( 0x356b0000 + code + ROW_COMPARE_MAP );
+            // lui ra, 0xff20
+        XferInstruction( 0x3c1fff20 );
+            // ori ra, 0x0200   debug exception vector
+        XferInstruction( 0x37ff0200 );
+            // lui t9, 0xa000
+        XferInstruction( 0x3c19a000 );
+            // ori t9, <code>
+        XferInstruction( 0x37390000 + code );
+            // jr t9
+        XferInstruction( 0x03200008 );
+            // nop
+        XferInstruction( 0x00000000 );
+            // nop, fetched once the loop is back
+        XferInstruction( 0x00000000 );
+
+        data = ReadFlashData( 0xA0000000 + result );
+        if ( data == 0xffffffff )
+        {
+            bad = 0;
+            return ROW_COMPARE_FAILED;
+        }
+        bad = data >> 16;
+        return data & 0xffff;
+    }
+
+        // Word i of the last CompareRow() map, bit j for word 32 * i + j
+    uint32_t CompareMap( uint8_t i )
+    {
+        return ReadFlashData( 0xA0000000 + CompareCode_ + ROW_COMPARE_MAP + 4 * i );
+    }
+
+
+        //
+        // One write with the family's widest primitive: a word on MX,
+        // four words (16 byte aligned) on MZ. Returns NVMCON.
+        //
+    uint32_t WriteWide( uint32_t flash_addr, const uint32_t *data )
+    {
+        if ( Family_.WriteBytes == 16 )
+        {
+            DownloadQuad( data );
+            return FlashOperation( NVMOP_WRITE_QUAD, flash_addr, 0 );
+        }
+        DownloadData( 0, data[0] );
+        return FlashOperation( NVMOP_WRITE_WORD, flash_addr, 0 );
+    }
+
+
+    uint32_t EraseProgramFlash()
+    {
+        return FlashOperation( Family_.EraseAllOp, GetProgramFlashStart(), 0 );
+    }
+
+
     uint32_t FlashOperation( unsigned char nvmop, uint32_t flash_addr, unsigned int ram_addr )
     {
+        RowBase_ = 0xffff;
+
             // nop
         XferInstruction( 0x00000000 );
 
@@ -222,8 +603,8 @@ public:
             // Step 1: Initialize constants
             // lui a0, 0xbf80
         XferInstruction( 0x3c04bf80 );
-            // ori a0, 0xf400
-        XferInstruction( 0x3484f400 );
+            // ori a0, <NVMCON(15:0)>
+        XferInstruction( 0x34840000 + Family_.NVMCon );
             // ori a1, $0, 0x4000 + NVMOP<3:0>
         XferInstruction( 0x34054000 + nvmop );
             // ori a2, $0, 0x8000
@@ -241,6 +622,13 @@ public:
             // lui s3, 0xff20
         //XferInstruction( 0x3c13ff20 );
 
+            // MZ boot flash is write protected out of reset
+        if ( DevID_.Family == FAMILY_MZ && !WPOff_ )
+        {
+            XferInstructions_P( NvmWriteProtectOff, NVM_WP_OFF_LEN );
+            WPOff_ = true;
+        }
+
             // Step 2, set NVMADDR (row to be programmed)
             // lui t0, <FLASH_ROW_ADDR(31:16)>
         XferInstruction( 0x3c080000 + (flash_addr>>16) );
@@ -254,8 +642,8 @@ public:
         XferInstruction( 0x3c100000 );
             // ori s0, <RAM_ADDR(15:0)>
         XferInstruction( 0x36100000 + ram_addr );
-            // sw s0, 64($a0)    
-        XferInstruction( 0xac900040 );
+            // sw s0, <NVMSRCADDR>($a0)    
+        XferInstruction( 0xac900000 + Family_.SrcAddrOffs );
 
             // Step 4, Set up NVMCON write and poll STAT
             // sw a1, 0(a0)
@@ -270,38 +658,12 @@ public:
             // nop
         XferInstruction( 0x00000000 );
 
-            // Step 5, unlock NVMCON and start write
-            // sw s1, 16(a0)
-        XferInstruction( 0xac910010 );
-            // sw s2, 16(a0)
-        XferInstruction( 0xac920010 );
-            // sw a2, 8(a0)  NOTE: offset 8 here is the "set register"
-        XferInstruction( 0xac860008 );
-
-            // Step 6, Poll for NVMCON(WR) bit to get cleared
-            // <here2>
-            // lw t0, 0(a0)
-        XferInstruction( 0x8c880000 );
-            // and t0, t0, a2
-        XferInstruction( 0x01064024 );
-            // bne t0, $0, <here2>
-        XferInstruction( 0x1500fffd );
-            // nop
-        XferInstruction( 0x00000000 );
-
-            // Step 7, Wait at least 500ns, 8MHz clock assumed
-            // nop
-        XferInstruction( 0x00000000 );
-            // nop
-        XferInstruction( 0x00000000 );
-            // nop
-        XferInstruction( 0x00000000 );
-            // nop
-        XferInstruction( 0x00000000 );
-
-            // Step 8, Clear NVMCON(WREN) bit
-            // sw a3, 4(a0)  NOTE: Offset 4 here is the "clear" register
-        XferInstruction( 0xac870004 );
+            // Steps 5 to 8, unlock, write, wait and clear WREN. The CPU
+            // holds on its next fetch while the other ports get a turn.
+        XferInstructions_P( NvmStartWrite, NVM_WRITE_STARTED );
+        JTAG_PORTS_YIELD();
+        XferInstructions_P( NvmStartWrite + NVM_WRITE_STARTED,
+                            NVM_START_WRITE_LEN - NVM_WRITE_STARTED );
 
             // Step 9, Check NVMCON(WRERR) bit to ensure correct operation
             // lw t0, 0(a0)
@@ -329,6 +691,13 @@ public:
 
     uint32_t ReadFlashData( uint32_t flash_addr )
     {                
+        if ( DMAPaths_ & DMA_READ )
+        {
+            uint32_t data = 0;
+            XferDMA( flash_addr, data, true );
+            return data;
+        }
+
             // lui s3, 0xFF20
         XferInstruction( 0x3c13ff20 );
             // ori s3, 0
@@ -355,6 +724,121 @@ public:
     }
 
 
+        //
+        // n consecutive words from flash_addr. The address is set up
+        // once and every word then costs two instructions and a FASTDATA
+        // scan, where ReadFlashData() needs six instructions per word.
+        //
+    void ReadFlashBlock( uint32_t flash_addr, uint32_t *data, uint8_t n )
+    {
+        uint8_t i;
+
+        if ( DMAPaths_ & DMA_BLOCK )
+        {
+            for ( i = 0; i < n; ++i )
+            {
+                XferDMA( flash_addr + 4 * i, data[i], true );
+            }
+            return;
+        }
+
+            // lui s3, 0xFF20
+        XferInstruction( 0x3c13ff20 );
+            // ori s3, 0
+        XferInstruction( 0x36730000 );
+            // lui t0, <FLASH_WORD_ADDR(31:16)>
+        XferInstruction( 0x3c080000 + (flash_addr>>16) );
+            // ori t0, <FLASH_WORD_ADDR(15:0)>
+        XferInstruction( 0x35080000 + (flash_addr&0xffff) );
+
+        for ( i = 0; i < n; ++i )
+        {
+                // lw t1, <4*i>(t0)
+            XferInstruction( 0x8d090000 + 4 * i );
+                // sw t1, 0(s3)
+            XferInstruction( 0xae690000 );
+            SendCommand( ETAP_FASTDATA );
+            data[i] = XferFastData( 0 );
+        }
+    }
+
+
+        //
+        // Moves each kind of memory access to EJTAG DMA if the target
+        // has it and it measures faster than PrAcc at the current TCK
+        // rate. Called by the sketch after entering programming mode
+        // (which goes back to PrAcc only); the host tools never do, so
+        // the scans they generate stay the same. Returns DMAPaths_.
+        //
+    uint8_t SelectMemoryPaths()
+    {
+        uint32_t addr = GetProgramFlashStart();
+        uint32_t block[4];
+        uint32_t ref, data, t, pracc;
+        uint8_t  i;
+        uint8_t  paths = 0;
+        bool     ok = true;
+
+        DMAPaths_ = 0;
+        if ( !HasDMA() )
+        {
+            return 0;
+        }
+
+        t     = micros();
+        ref   = ReadFlashData( addr );
+        pracc = micros() - t;
+        t     = micros();
+        ok   &= XferDMA( addr, data, true ) && data == ref;
+        if ( ok && micros() - t < pracc )
+        {
+            paths |= DMA_READ;
+        }
+
+        t     = micros();
+        ReadFlashBlock( addr, block, 4 );
+        pracc = micros() - t;
+        t     = micros();
+        for ( i = 0; ok && i < 4; ++i )
+        {
+            ok &= XferDMA( addr + 4 * i, data, true ) && data == block[i];
+        }
+        if ( ok && micros() - t < pracc )
+        {
+            paths |= DMA_BLOCK;
+        }
+
+            // The row buffer is scratch between rows. All the reads
+            // above and below are PrAcc, DMAPaths_ is still 0
+        RowBufferWord( 0, 0, 0 );
+        t     = micros();
+        for ( i = 0; i < 4; ++i )
+        {
+            RowBufferWord( 0, i, 0x5a5a5a5a ^ i );
+        }
+        pracc = micros() - t;
+        t     = micros();
+        for ( i = 0; ok && i < 4; ++i )
+        {
+            data = 0xa5a5a5a5 ^ i;
+            ok &= XferDMA( 4 * i, data, false );
+        }
+        t = micros() - t;
+        for ( i = 0; ok && i < 4; ++i )
+        {
+            data = 0xa5a5a5a5 ^ i;
+            ok &= ReadFlashData( 0xA0000000 + 4 * i ) == data;
+        }
+        if ( ok && t < pracc )
+        {
+            paths |= DMA_WRITE;
+        }
+
+        DMAPaths_ = ok ? paths : 0;
+        return DMAPaths_;
+    }
+
+
     void DumpMemory( uint32_t addr, uint8_t num )
     {
         while ( num-- )
@@ -371,43 +855,104 @@ public:
     {
         return InPgmMode_;
     }
+
+
+        //
+        // One link test round for TCK calibration: IDCODE from a fresh
+        // TAP reset and, in programming mode, a pattern through target
+        // RAM and back over FASTDATA.
+        //
+    bool TestLink( uint32_t pattern )
+    {
+        uint16_t timeouts = GetPollTimeouts();
+
+        SetMode(6, 0x1f);
+        SendCommand(MTAP_SW_MTAP);
+        SendCommand(MTAP_IDCODE);
+        if ( XferData(DATA_IDCODE) != DeviceID_ )
+        {
+            return false;
+        }
+
+        if ( InPgmMode_ )
+        {
+            SendCommand(MTAP_SW_ETAP);
+            DownloadData( 0, pattern );
+            if ( ReadFlashData( 0xA0000000 ) != pattern )
+            {
+                return false;
+            }
+        }
+
+        return GetPollTimeouts() == timeouts;
+    }
     
 
     uint32_t AutoDetect(void)
     {
-        int n = 0;
+        int16_t  lo = 0;
+        int16_t  hi = PIC32_DEVICE_COUNT - 1;
+        int16_t  n  = PIC32_DEVICE_COUNT;   // "Unknown"
+        uint32_t id;
    
         ReadIDCodeRegister();
         //DeviceID_ = ReadFlashData(0xbf80f220);
 
-
             //
-            // Find the device from Pic32DevIDList
+            // Binary search Pic32DevIDList (sorted), ignoring the
+            // silicon revision so new steppings are still recognized
             //
-        DevID_.DevID = 0xFFFFFFFF;
-        while ( DeviceID_ != DevID_.DevID &&
-                0         != DevID_.DevID )
+        id = DeviceID_ & ~PIC32_REVISION_MASK;
+        while ( lo <= hi )
         {
-            memcpy_P( &DevID_, &Pic32DevIDList[n], sizeof(DevID_) );
-            ++n;
+            int16_t  mid   = (lo + hi) / 2;
+            uint32_t midID = pgm_read_dword( &Pic32DevIDList[mid].DevID );
+
+            if ( midID == id )
+            {
+                n = mid;
+                break;
+            }
+            if ( midID < id )
+            {
+                lo = mid + 1;
+            }
+            else
+            {
+                hi = mid - 1;
+            }
         }
 
+        memcpy_P( &DevID_, &Pic32DevIDList[n], sizeof(DevID_) );
+        memcpy_P( &Family_, &Pic32FamilyList[DevID_.Family], sizeof(Family_) );
+
         return DeviceID_;
     }
 
 
         // 
-        // Constructor
+        // Constructor. Without 'probe' nothing is scanned, the target
+        // may not even be there yet (see TargetMonitor.h).
         // 
-    Pic32JTAGDevice()
+    Pic32JTAGDevice( bool probe = true, uint8_t port = 0 )
+        : Pic32JTAG( port )
     {
         DeviceID_ = 0;
         MyStatus_ = 0;
         InPgmMode_ = false;
-
-        CheckStatus();
-        AutoDetect();
+        RowBase_ = 0xffff;
+        DMAPaths_ = 0;
+        CompareCode_ = 0xffff;
+        WPOff_ = false;
+        memcpy_P( &DevID_, &Pic32DevIDList[PIC32_DEVICE_COUNT], sizeof(DevID_) );
+        memcpy_P( &Family_, &Pic32FamilyList[0], sizeof(Family_) );
+
+        if ( probe )
+        {
+            CheckStatus();
+            AutoDetect();
+        }
     }
 };
 
-#endif //INCLUDE_PIC32_JTAG_DEVICE_H
+#endif //INCLUDE_PIC32_JTAG_DEVICE_H
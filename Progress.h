@@ -0,0 +1,221 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef PROGRESS_H
+#define PROGRESS_H
+
+#include <Arduino.h>
+
+/**
+ * Progress reporting that never blocks the programming path. At 1200bps
+ * the 64 byte TX buffer fills quickly and Serial.print() would then wait
+ * while HEX data piles up in RX. Progress is only written when
+ * Serial.availableForWrite() says it fits, otherwise the update is
+ * dropped and the next one carries the newer state.
+ *
+ * In quiet mode ('m') nothing but fixed size status frames is sent, for
+ * host tools. Frames are upper case hex so they cannot be mistaken for
+ * the XON credits of binary streams:
+ *
+ *   '!' phase:1 error:2 addr:8 done:8 xor:2 '\n'
+ *
+ * xor is over the phase, error, addr and done bytes. Phase changes and
+ * the final frame are always sent, intermediate frames only when they
+ * fit.
+ */
+
+#define STATUS_SYNC        '!'
+#define STATUS_FRAME_SIZE  23
+#define PROGRESS_DOT_BYTES 64     // text mode: one '.' per this many bytes
+
+enum status_phase_e {
+    PHASE_IDLE = 0,
+    PHASE_PROGRAM,
+    PHASE_VERIFY,
+    PHASE_DRY_RUN,
+    PHASE_DONE,
+    PHASE_FAIL
+};
+
+enum status_error_e {
+    STATUS_OK = 0,
+    STATUS_START_CODE,
+    STATUS_CHECKSUM,
+    STATUS_RECORD_TYPE,
+    STATUS_VERIFY,
+    STATUS_CHECKPOINT,
+    STATUS_PACKED,
+    STATUS_IMAGE,
+    STATUS_PRACC        // a PrAcc poll timed out, the target lost step
+};
+
+bool QuietMode = false;
+
+struct Progress_t {
+    uint8_t  Phase;
+    uint8_t  Error;
+    uint32_t Addr;
+    uint32_t Done;
+    uint32_t NextDot;
+};
+
+Progress_t ProgressState;
+
+    // What this attach has done so far, kept in RAM only. Metrics.h
+    // folds it into the EEPROM record once the session is over.
+struct Session_t {
+    bool     Started;       // a ProgressBegin() since attach
+    bool     Programmed;
+    uint8_t  VerifyFails;
+    uint8_t  ChecksumErrors;
+    uint32_t Bytes;
+    uint32_t StartMs;
+    uint32_t EndMs;
+};
+
+Session_t SessionState;
+
+bool TXRoom( uint8_t bytes )
+{
+    return Serial.availableForWrite() >= bytes;
+}
+
+void StatusHex( char * out, uint32_t value, uint8_t digits )
+{
+    while ( digits-- )
+    {
+        uint8_t n = value & 0xf;
+        out[digits] = n < 10 ? '0' + n : 'A' + n - 10;
+        value >>= 4;
+    }
+}
+
+uint8_t StatusXor( uint32_t value )
+{
+    return value ^ (value >> 8) ^ (value >> 16) ^ (value >> 24);
+}
+
+void SendStatusFrame()
+{
+    char frame[STATUS_FRAME_SIZE];
+
+    frame[0] = STATUS_SYNC;
+    StatusHex( frame + 1,  ProgressState.Phase, 1 );
+    StatusHex( frame + 2,  ProgressState.Error, 2 );
+    StatusHex( frame + 4,  ProgressState.Addr,  8 );
+    StatusHex( frame + 12, ProgressState.Done,  8 );
+    StatusHex( frame + 20, ProgressState.Phase ^ ProgressState.Error
+                           ^ StatusXor( ProgressState.Addr )
+                           ^ StatusXor( ProgressState.Done ), 2 );
+    frame[22] = '\n';
+
+    Serial.write( (const uint8_t *)frame, STATUS_FRAME_SIZE );
+}
+
+void ProgressBegin( uint8_t phase )
+{
+    ProgressState.Phase   = phase;
+    ProgressState.Error   = STATUS_OK;
+    ProgressState.Addr    = 0;
+    ProgressState.Done    = 0;
+    ProgressState.NextDot = PROGRESS_DOT_BYTES;
+
+    if ( !SessionState.Started )
+    {
+        SessionState.Started = true;
+        SessionState.StartMs = millis();
+    }
+
+    if ( QuietMode )
+    {
+        SendStatusFrame();
+    }
+}
+
+void ProgressStep( uint32_t addr, uint32_t bytes )
+{
+    ProgressState.Addr  = addr;
+    ProgressState.Done += bytes;
+
+    if ( QuietMode )
+    {
+        if ( TXRoom( STATUS_FRAME_SIZE ) )
+        {
+            SendStatusFrame();
+        }
+    }
+    else if ( ProgressState.Done >= ProgressState.NextDot )
+    {
+        ProgressState.NextDot = ProgressState.Done + PROGRESS_DOT_BYTES;
+        if ( TXRoom( 1 ) )
+        {
+            Serial.write( '.' );
+        }
+    }
+}
+
+    // Text mode "0x<addr>: 0x<word>" marker, skipped if it does not fit
+void ProgressAddress( uint32_t addr, uint32_t word )
+{
+    if ( !QuietMode && TXRoom( 24 ) )
+    {
+        Serial.print(F("\r\n0x"));
+        Serial.print( addr, HEX );
+        Serial.print(F(": 0x"));
+        Serial.print( word, HEX );
+    }
+}
+
+void ProgressEnd( uint8_t error )
+{
+    SessionState.EndMs = millis();
+    if ( ProgressState.Phase == PHASE_PROGRAM )
+    {
+        SessionState.Bytes += ProgressState.Done;
+        SessionState.Programmed |= !error;
+    }
+    if ( error == STATUS_VERIFY && SessionState.VerifyFails < 0xff )
+    {
+        ++SessionState.VerifyFails;
+    }
+    if ( error == STATUS_CHECKSUM && SessionState.ChecksumErrors < 0xff )
+    {
+        ++SessionState.ChecksumErrors;
+    }
+
+    ProgressState.Phase = error ? PHASE_FAIL : PHASE_DONE;
+    ProgressState.Error = error;
+
+    if ( QuietMode )
+    {
+        SendStatusFrame();
+    }
+}
+
+#endif
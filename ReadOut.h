@@ -0,0 +1,198 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef READ_OUT_H
+#define READ_OUT_H
+
+#include <Arduino.h>
+#include <util/crc16.h>
+#include "Pic32JTAGDevice.h"
+
+/**
+ * Read-out of boot flash (with the configuration words at its end), the
+ * second boot flash of MZ parts, and program flash, for backups and
+ * audits. Flash is read READOUT_WORDS at
+ * a time with Pic32JTAGDevice::ReadFlashBlock().
+ *
+ * Intel HEX ('b'): 16 byte type 00 records at physical addresses with
+ * type 04 records for the upper half, records of only 0xFF are left
+ * out. Ends with the type 01 record.
+ *
+ * Binary ('B', for host/p32read), after the "Binary read-out" line:
+ *
+ *   'B' addr:u32 words:u8 data:u32*words crc:u16    (little endian)
+ *   'E'
+ *
+ * The CRC is _crc_ccitt_update() from 0xffff over addr, words and data.
+ * Blocks of only 0xFF are left out in this format too.
+ */
+
+#define READOUT_WORDS 16
+
+uint8_t ReadOutBuf[READOUT_WORDS * 4];
+
+    // Block at addr into ReadOutBuf, true if any byte is not 0xFF
+bool ReadOutBlock( Pic32JTAGDevice & pic32, uint32_t addr )
+{
+    uint32_t *words = (uint32_t *)ReadOutBuf;
+    uint8_t   i;
+    bool      used = false;
+
+    pic32.ReadFlashBlock( addr, words, READOUT_WORDS );
+    for ( i = 0; i < READOUT_WORDS; ++i )
+    {
+        used |= words[i] != 0xffffffff;
+    }
+    return used;
+}
+
+void ReadOutHexByte( uint8_t b, uint8_t & sum )
+{
+    if ( b < 0x10 )
+    {
+        Serial.print( '0' );
+    }
+    Serial.print( b, HEX );
+    sum += b;
+}
+
+void ReadOutHexRecord( uint16_t addr, uint8_t type, const uint8_t *data, uint8_t len )
+{
+    uint8_t sum = 0;
+    uint8_t i;
+
+    Serial.print( ':' );
+    ReadOutHexByte( len, sum );
+    ReadOutHexByte( addr >> 8, sum );
+    ReadOutHexByte( addr & 0xff, sum );
+    ReadOutHexByte( type, sum );
+    for ( i = 0; i < len; ++i )
+    {
+        ReadOutHexByte( data[i], sum );
+    }
+    ReadOutHexByte( -sum, sum );
+    Serial.println();
+}
+
+void ReadOutHexRegion( Pic32JTAGDevice & pic32, uint32_t start, uint32_t end, uint16_t & upper )
+{
+    uint32_t addr;
+    uint8_t  i, j;
+
+    for ( addr = start; addr < end; addr += READOUT_WORDS * 4 )
+    {
+        if ( !ReadOutBlock( pic32, addr ) )
+        {
+            continue;
+        }
+        for ( i = 0; i < READOUT_WORDS * 4; i += 16 )
+        {
+            bool used = false;
+
+            for ( j = 0; j < 16; ++j )
+            {
+                used |= ReadOutBuf[i + j] != 0xff;
+            }
+            if ( !used )
+            {
+                continue;
+            }
+            if ( (addr >> 16) != upper )
+            {
+                uint8_t ext[2] = { (uint8_t)(addr >> 24), (uint8_t)(addr >> 16) };
+
+                upper = addr >> 16;
+                ReadOutHexRecord( 0, 4, ext, 2 );
+            }
+            ReadOutHexRecord( (addr + i) & 0xffff, 0, ReadOutBuf + i, 16 );
+        }
+    }
+}
+
+void ReadOutBinaryRegion( Pic32JTAGDevice & pic32, uint32_t start, uint32_t end )
+{
+    uint32_t addr;
+    uint16_t crc;
+    uint8_t  i;
+
+    for ( addr = start; addr < end; addr += READOUT_WORDS * 4 )
+    {
+        if ( !ReadOutBlock( pic32, addr ) )
+        {
+            continue;
+        }
+
+        crc = 0xffff;
+        Serial.write( 'B' );
+        for ( i = 0; i < 4; ++i )
+        {
+            uint8_t b = addr >> (8 * i);
+            crc = _crc_ccitt_update( crc, b );
+            Serial.write( b );
+        }
+        crc = _crc_ccitt_update( crc, READOUT_WORDS );
+        Serial.write( READOUT_WORDS );
+        for ( i = 0; i < READOUT_WORDS * 4; ++i )
+        {
+            crc = _crc_ccitt_update( crc, ReadOutBuf[i] );
+        }
+        Serial.write( ReadOutBuf, READOUT_WORDS * 4 );
+        Serial.write( (uint8_t)crc );
+        Serial.write( (uint8_t)(crc >> 8) );
+    }
+}
+
+void ReadOut( Pic32JTAGDevice & pic32, bool binary )
+{
+    uint16_t upper = 0xffff;
+
+    if ( binary )
+    {
+        Serial.println(F("Binary read-out"));
+        ReadOutBinaryRegion( pic32, pic32.GetBootFlashStart(), pic32.GetBootFlashEnd() + 1 );
+        if ( pic32.GetBootFlash2Start() )
+        {
+            ReadOutBinaryRegion( pic32, pic32.GetBootFlash2Start(), pic32.GetBootFlash2End() + 1 );
+        }
+        ReadOutBinaryRegion( pic32, pic32.GetProgramFlashStart(), pic32.GetProgramFlashEnd() + 1 );
+        Serial.write( 'E' );
+    }
+    else
+    {
+        ReadOutHexRegion( pic32, pic32.GetBootFlashStart(), pic32.GetBootFlashEnd() + 1, upper );
+        if ( pic32.GetBootFlash2Start() )
+        {
+            ReadOutHexRegion( pic32, pic32.GetBootFlash2Start(), pic32.GetBootFlash2End() + 1, upper );
+        }
+        ReadOutHexRegion( pic32, pic32.GetProgramFlashStart(), pic32.GetProgramFlashEnd() + 1, upper );
+        ReadOutHexRecord( 0, 1, 0, 0 );
+    }
+}
+
+#endif
@@ -0,0 +1,287 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef ROW_IMAGE_H
+#define ROW_IMAGE_H
+
+#include <Arduino.h>
+#include "Pic32JTAGDevice.h"
+#include "FlashWriter.h"
+#include "MySerial.h"
+#include "Progress.h"
+
+/**
+ * Row image loader ('w'). The host (host/p32rows) has already laid the
+ * image out in the attached device's rows, so the words go to
+ * FlashWriter in row order and each row fills exactly one row buffer.
+ * Rows that are all 0xFF are not sent. Apart from the CRC there is
+ * nothing to work out here. Multibyte values little endian:
+ *
+ *   'R' 'I' ROWS_VERSION devID:u32 rowBytes:u16 pfmKB:u16 bfmKB:u16
+ *   { 'G' base:u32 rows:u16 { map:u8 row* }* }     one map per 8 rows
+ *   'E'
+ *
+ *   row = data:u8[rowBytes] crc:u32
+ *
+ * devID is without the revision, the header must match the attached
+ * device's IDCODE and row size. A region ('G') starts at a row aligned
+ * physical address in boot or program flash and covers 'rows' rows.
+ * Bit n of a map (LSB first) says the region's row 8*k+n follows.
+ * crc is CRC-32 (the zlib one) over the row's address:u32 and its
+ * data, so a row can't be programmed at the wrong place either. A row
+ * is only programmed after its CRC has been checked, except on parts
+ * without the RAM for two row buffers, where FlashWriter writes chunks
+ * as they fill, as it does for HEX files.
+ */
+
+#define ROWS_VERSION 1
+
+enum rows_status_e {
+    ROWS_OK = 0,
+    ROWS_BAD_HEADER,
+    ROWS_WRONG_DEVICE,
+    ROWS_BAD_REGION,
+    ROWS_BAD_CRC,
+    ROWS_VERIFY_FAIL
+};
+
+uint32_t Crc32Update( uint32_t crc, uint8_t b )
+{
+    uint8_t n;
+
+    crc ^= b;
+    for ( n = 0; n < 8; ++n )
+    {
+        crc = (crc >> 1) ^ ((crc & 1) ? 0xEDB88320UL : 0);
+    }
+    return crc;
+}
+
+class RowImage {
+
+private:
+    Pic32JTAGDevice & pic32_;
+    FlashWriter &     writer_;
+    uint16_t          rowBytes_;
+    uint32_t          addr_;
+    uint32_t          bytes_;
+
+    uint16_t RXWordLE()
+    {
+        uint8_t lo = RXStreamByte();
+        uint8_t hi = RXStreamByte();
+        return ((uint16_t)hi << 8) | lo;
+    }
+
+    uint32_t RXLongLE()
+    {
+        uint16_t lo = RXWordLE();
+        uint16_t hi = RXWordLE();
+        return ((uint32_t)hi << 16) | lo;
+    }
+
+    bool InFlash( uint32_t start, uint32_t end )
+    {
+        return ( start >= pic32_.GetProgramFlashStart() && end <= pic32_.GetProgramFlashEnd() )
+            || ( start >= pic32_.GetBootFlashStart()    && end <= pic32_.GetBootFlashEnd() );
+    }
+
+    uint8_t Row()
+    {
+        uint32_t crc = 0xffffffff;
+        uint32_t word;
+        uint16_t i;
+        uint8_t  n;
+
+        for ( n = 0; n < 32; n += 8 )
+        {
+            crc = Crc32Update( crc, addr_ >> n );
+        }
+
+        for ( i = 0; i < rowBytes_; i += 4 )
+        {
+            word = 0;
+            for ( n = 0; n < 32; n += 8 )
+            {
+                uint8_t b = RXStreamByte();
+                crc   = Crc32Update( crc, b );
+                word |= (uint32_t)b << n;
+            }
+            if ( !writer_.Put( addr_ + i, word ) )
+            {
+                return ROWS_VERIFY_FAIL;
+            }
+        }
+
+        if ( RXLongLE() != ~crc )
+        {
+            return ROWS_BAD_CRC;
+        }
+        if ( !writer_.Commit() )
+        {
+            return ROWS_VERIFY_FAIL;
+        }
+        bytes_ += rowBytes_;
+        ProgressStep( addr_, rowBytes_ );
+        return ROWS_OK;
+    }
+
+    uint8_t Region()
+    {
+        uint32_t base = RXLongLE();
+        uint16_t rows = RXWordLE();
+        uint16_t r;
+        uint8_t  map    = 0;
+        uint8_t  status = ROWS_OK;
+
+        if ( (base & (rowBytes_ - 1)) || !rows
+             || !InFlash( base, base + (uint32_t)rows * rowBytes_ - 1 ) )
+        {
+            return ROWS_BAD_REGION;
+        }
+
+        for ( r = 0; r < rows && status == ROWS_OK; ++r )
+        {
+            if ( (r & 7) == 0 )
+            {
+                map = RXStreamByte();
+            }
+            if ( map & (1 << (r & 7)) )
+            {
+                addr_  = base + (uint32_t)r * rowBytes_;
+                status = Row();
+            }
+        }
+        return status;
+    }
+
+public:
+    RowImage( Pic32JTAGDevice & pic32, FlashWriter & writer ):
+        pic32_(pic32),
+        writer_(writer),
+        rowBytes_(0),
+        addr_(0),
+        bytes_(0)
+    {
+    }
+
+    uint8_t Load()
+    {
+        uint8_t  status = ROWS_OK;
+        uint32_t devID;
+
+        if ( RXStreamByte() != 'R' || RXStreamByte() != 'I'
+             || RXStreamByte() != ROWS_VERSION )
+        {
+            return ROWS_BAD_HEADER;
+        }
+        devID     = RXLongLE();
+        rowBytes_ = RXWordLE();
+        RXLongLE();     // flash sizes, for the host side
+
+        if ( devID != (pic32_.GetDeviceID() & ~PIC32_REVISION_MASK)
+             || rowBytes_ != pic32_.GetRowSize() )
+        {
+            return ROWS_WRONG_DEVICE;
+        }
+
+        while ( status == ROWS_OK )
+        {
+            switch ( RXStreamByte() )
+            {
+                case 'G':
+                    status = Region();
+                    break;
+
+                case 'E':
+                    return writer_.Finish() ? ROWS_OK : ROWS_VERIFY_FAIL;
+
+                default:
+                    status = ROWS_BAD_HEADER;
+                    break;
+            }
+        }
+        return status;
+    }
+
+        // Image bytes taken so far
+    uint32_t Bytes() const { return bytes_; }
+
+        // The last row started
+    uint32_t Address() const { return addr_; }
+};
+
+void RowPgm( Pic32JTAGDevice & pic32, bool program, bool verify )
+{
+    FlashWriter writer( pic32, program, verify );
+    RowImage    image( pic32, writer );
+    uint8_t     status;
+
+    if ( !QuietMode )
+    {
+        Serial.println (F("Send your row image now."));
+    }
+    ProgressBegin( program ? PHASE_PROGRAM : PHASE_VERIFY );
+    RXStreamBegin();
+    status = image.Load();
+    if ( status == ROWS_OK )
+    {
+        FootprintSave();
+    }
+    ProgressEnd( status == ROWS_OK ? STATUS_OK :
+                 status == ROWS_VERIFY_FAIL ? writer.FailStatus() :
+                 status == ROWS_BAD_CRC ? STATUS_CHECKSUM : STATUS_IMAGE );
+
+    if ( QuietMode )
+    {
+        if ( status != ROWS_OK )
+        {
+            ConsumeRestOfFile();
+        }
+    }
+    else if ( status == ROWS_OK )
+    {
+        Serial.println();
+        Serial.print(F("Rows OK, "));
+        Serial.print( image.Bytes() );
+        Serial.print(F(" bytes, wrote "));
+        Serial.println( writer.BytesWritten() );
+    }
+    else
+    {
+        Serial.println();
+        Serial.print(F("Rows FAIL "));
+        Serial.print( status );
+        Serial.print(F(" near 0x"));
+        Serial.println( image.Address(), HEX );
+        ConsumeRestOfFile();
+    }
+}
+
+#endif
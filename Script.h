@@ -0,0 +1,321 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef SCRIPT_H
+#define SCRIPT_H
+
+#include <Arduino.h>
+#include "EepromMap.h"
+#include "Pic32JTAGDevice.h"
+#include "MySerial.h"
+#include "PackedImage.h"
+#include "Progress.h"
+#include "ErasePlan.h"
+
+/**
+ * Production script: a short list of steps kept in EEPROM and run every
+ * time a target is attached, with no key presses. Steps are separated
+ * by ';' (or spaces), for example
+ *
+ *   detect; erase; program; verify; release-reset
+ *
+ *   detect              the IDCODE must be in the device table
+ *   unit                read this unit's patch line (see SetPatches())
+ *   erase               MCHP_ERASE
+ *   erase-if-protected  MCHP_ERASE only if code protected. An unprotected
+ *                       part keeps its old contents, so follow it with
+ *                       erase-planned or program only blank parts.
+ *   erase-planned       erase the pages of the last good image (ErasePlan.h)
+ *   program             .hex programming ("program; verify" is one pass)
+ *   verify              .hex verify
+ *   packed              packed image program+verify (host/p32pack)
+ *   release-reset       leave programming mode, let the target run
+ *
+ * Programming steps enter programming mode by themselves. The host
+ * sends one file per .hex/packed step. The outcome is one line,
+ * "PASS <ms> ms" or "FAIL <step> <code> <ms> ms", the code being a
+ * status_error_e from Progress.h or SCRIPT_* below.
+ */
+
+enum script_step_e {
+    STEP_DETECT = 0,
+    STEP_UNIT,
+    STEP_ERASE,
+    STEP_ERASE_IF_PROTECTED,
+    STEP_ERASE_PLANNED,
+    STEP_PROGRAM,
+    STEP_VERIFY,
+    STEP_PACKED,
+    STEP_RELEASE_RESET,
+    STEP_COUNT
+};
+
+enum script_error_e {
+    SCRIPT_UNKNOWN_DEVICE = 0x40,
+    SCRIPT_PROTECTED,
+    SCRIPT_BAD_STEP,
+    SCRIPT_BAD_PATCH,
+    SCRIPT_NO_FOOTPRINT
+};
+
+const char StepDetect[]        PROGMEM = "detect";
+const char StepUnit[]          PROGMEM = "unit";
+const char StepErase[]         PROGMEM = "erase";
+const char StepEraseIfProt[]   PROGMEM = "erase-if-protected";
+const char StepErasePlanned[]  PROGMEM = "erase-planned";
+const char StepProgram[]       PROGMEM = "program";
+const char StepVerify[]        PROGMEM = "verify";
+const char StepPacked[]        PROGMEM = "packed";
+const char StepReleaseReset[]  PROGMEM = "release-reset";
+
+const char * const ScriptSteps[STEP_COUNT] PROGMEM =
+{
+    StepDetect, StepUnit, StepErase, StepEraseIfProt, StepErasePlanned,
+    StepProgram, StepVerify, StepPacked, StepReleaseReset
+};
+
+#define SCRIPT_TOKEN_LEN 18    // "erase-if-protected"
+
+bool ScriptSeparator( char c )
+{
+    return c == ';' || c == ' ' || c == ',' || c == '\t';
+}
+
+    // Next step name from EEPROM at *pos, STEP_COUNT at the end
+uint8_t ScriptNextStep( uint8_t & pos, bool & bad )
+{
+    char    token[SCRIPT_TOKEN_LEN + 1];
+    uint8_t len = 0;
+    uint8_t step;
+    char    c = 0;
+
+    bad = false;
+    while ( pos < EE_SCRIPT_SIZE )
+    {
+        c = eeprom_read_byte( EE_ADDR(EE_SCRIPT + pos) );
+        if ( c == 0 || (uint8_t)c == 0xff || !ScriptSeparator( c ) )
+        {
+            break;
+        }
+        ++pos;
+    }
+
+    while ( pos < EE_SCRIPT_SIZE && c != 0 && (uint8_t)c != 0xff && !ScriptSeparator( c ) )
+    {
+        if ( len < SCRIPT_TOKEN_LEN )
+        {
+            token[len++] = c;
+        }
+        c = eeprom_read_byte( EE_ADDR(EE_SCRIPT + ++pos) );
+    }
+    token[len] = 0;
+
+    if ( len == 0 )
+    {
+        return STEP_COUNT;
+    }
+    for ( step = 0; step < STEP_COUNT; ++step )
+    {
+        if ( strcmp_P( token, (const char *)pgm_read_ptr( &ScriptSteps[step] ) ) == 0 )
+        {
+            return step;
+        }
+    }
+    bad = true;
+    return STEP_COUNT;
+}
+
+bool HasScript()
+{
+    uint8_t c = eeprom_read_byte( EE_ADDR(EE_SCRIPT) );
+    return c != 0 && c != 0xff;
+}
+
+    // Reads one line over serial into EEPROM, an empty line clears it
+void SetScript()
+{
+    uint8_t pos = 0;
+    char    c;
+
+    Serial.println(F("Script (empty line clears):"));
+    while ( (c = RXChar()) != '\r' && c != '\n' )
+    {
+        if ( pos < EE_SCRIPT_SIZE - 1 )
+        {
+            eeprom_update_byte( EE_ADDR(EE_SCRIPT + pos++), c );
+            Serial.print( c );
+        }
+    }
+    eeprom_update_byte( EE_ADDR(EE_SCRIPT + pos), 0 );
+    Serial.println();
+
+        // Typos are caught now rather than halfway through a board
+    bool bad = false;
+    uint8_t n = 0;
+    pos = 0;
+    while ( ScriptNextStep( pos, bad ) != STEP_COUNT )
+    {
+        ++n;
+    }
+    if ( bad )
+    {
+        Serial.print(F("Unknown step "));
+        Serial.println( n + 1 );
+    }
+}
+
+bool ScriptConnect( Pic32JTAGDevice & pic32 )
+{
+    if ( !pic32.IsConnected() )
+    {
+        if ( pic32.NeedsErase() )
+        {
+            return false;
+        }
+        pic32.EnterPgmMode();
+        pic32.FlashOperation( NVMOP_NOP, 0, 0 );
+        pic32.SelectMemoryPaths();
+    }
+    return true;
+}
+
+    // HexPgm()/PackedPgm() leave their outcome in ProgressState
+uint8_t ScriptLoaderResult()
+{
+    return ProgressState.Phase == PHASE_DONE ? STATUS_OK : ProgressState.Error;
+}
+
+uint8_t ScriptErase( Pic32JTAGDevice & pic32 )
+{
+    if ( pic32.IsConnected() )
+    {
+        pic32.ExitPgmMode();
+    }
+    SaveCheckpoint( 0xffffffff, 0, 0 );
+    PatchesReset();
+    pic32.JTAGErase();
+    return STATUS_OK;
+}
+
+uint8_t RunStep( Pic32JTAGDevice & pic32, uint8_t step, bool andVerify )
+{
+    switch ( step )
+    {
+        case STEP_DETECT:
+            return pic32.IsKnown() ? (uint8_t)STATUS_OK : (uint8_t)SCRIPT_UNKNOWN_DEVICE;
+
+        case STEP_UNIT:
+            return SetPatches() ? (uint8_t)STATUS_OK : (uint8_t)SCRIPT_BAD_PATCH;
+
+        case STEP_ERASE:
+            return ScriptErase( pic32 );
+
+        case STEP_ERASE_IF_PROTECTED:
+            return pic32.NeedsErase() ? ScriptErase( pic32 ) : STATUS_OK;
+
+        case STEP_ERASE_PLANNED:
+            return ErasePlanned( pic32 ) ? (uint8_t)STATUS_OK : (uint8_t)SCRIPT_NO_FOOTPRINT;
+
+        case STEP_PROGRAM:
+        case STEP_VERIFY:
+            if ( !ScriptConnect( pic32 ) )
+            {
+                return SCRIPT_PROTECTED;
+            }
+            HexPgm( pic32, step == STEP_PROGRAM, step == STEP_VERIFY || andVerify );
+            return ScriptLoaderResult();
+
+        case STEP_PACKED:
+            if ( !ScriptConnect( pic32 ) )
+            {
+                return SCRIPT_PROTECTED;
+            }
+            PackedPgm( pic32, true, true );
+            return ScriptLoaderResult();
+
+        case STEP_RELEASE_RESET:
+            if ( pic32.IsConnected() )
+            {
+                pic32.ExitPgmMode();
+            }
+            pic32.SetReset(false);
+            return STATUS_OK;
+    }
+    return SCRIPT_BAD_STEP;
+}
+
+    // Runs the stored script, returns 0 or the failing step number (1..)
+uint8_t RunScript( Pic32JTAGDevice & pic32 )
+{
+    uint32_t start = millis();
+    uint8_t  pos   = 0;
+    uint8_t  n     = 0;
+    uint8_t  err   = STATUS_OK;
+    bool     bad;
+    uint8_t  step  = ScriptNextStep( pos, bad );
+
+    while ( step != STEP_COUNT && err == STATUS_OK )
+    {
+        uint8_t next = ScriptNextStep( pos, bad );
+        bool    fold = step == STEP_PROGRAM && next == STEP_VERIFY;
+
+        ++n;
+        err = RunStep( pic32, step, fold );
+        if ( fold )
+        {
+            ++n;
+            next = ScriptNextStep( pos, bad );
+        }
+        step = next;
+    }
+    if ( err == STATUS_OK && bad )
+    {
+        ++n;
+        err = SCRIPT_BAD_STEP;
+    }
+
+    if ( err == STATUS_OK )
+    {
+        Serial.print(F("PASS "));
+    }
+    else
+    {
+        Serial.print(F("FAIL "));
+        Serial.print( n );
+        Serial.print(F(" "));
+        Serial.print( err );
+        Serial.print(F(" "));
+    }
+    Serial.print( millis() - start );
+    Serial.println(F(" ms"));
+
+    return err == STATUS_OK ? 0 : n;
+}
+
+#endif
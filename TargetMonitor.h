@@ -0,0 +1,152 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef TARGET_MONITOR_H
+#define TARGET_MONITOR_H
+
+#include <Arduino.h>
+#include "Pic32JTAGDevice.h"
+
+/**
+ * Target insertion / removal detection. Poll() is called every
+ * ATTACH_POLL_MS and does one IDCODE scan, plus one MCHP_STATUS scan
+ * while waiting for the configuration to load, so a fixture gets from
+ * "board inserted" to "ready to program" in a few milliseconds instead
+ * of the old fixed one second steps.
+ *
+ * A floating or shorted TDO reads all ones or all zeros; a real IDCODE
+ * always has bit 0 set. ATTACH_DEBOUNCE equal reads are needed either
+ * way, so contact bounce on insertion does not count as a target.
+ */
+
+#define ATTACH_POLL_MS   1
+#define ATTACH_DEBOUNCE  2
+
+enum target_state_e {
+    TARGET_ABSENT = 0,
+    TARGET_BUSY,        // IDCODE seen, configuration not loaded yet
+    TARGET_READY
+};
+
+class TargetMonitor {
+
+private:
+    uint8_t  state_;
+    uint8_t  count_;
+    uint32_t id_;
+    uint32_t seenAt_;
+    uint32_t latency_;
+
+    static bool ValidID( uint32_t id )
+    {
+        return (id & 1) && id != 0xffffffff;
+    }
+
+public:
+    TargetMonitor():
+        state_(TARGET_ABSENT),
+        count_(0),
+        id_(0),
+        seenAt_(0),
+        latency_(0)
+    {
+    }
+
+    uint8_t Poll( Pic32JTAGDevice & pic32 )
+    {
+        uint32_t id = pic32.ProbeIDCode();
+
+        if ( state_ == TARGET_ABSENT )
+        {
+            if ( !ValidID( id ) )
+            {
+                count_ = 0;
+                return state_;
+            }
+            if ( count_ == 0 || id != id_ )
+            {
+                id_     = id;
+                count_  = 1;
+                seenAt_ = millis();
+                return state_;
+            }
+            if ( ++count_ < ATTACH_DEBOUNCE )
+            {
+                return state_;
+            }
+            count_ = 0;
+            state_ = TARGET_BUSY;
+            pic32.SetReset(true);
+        }
+        else if ( id != id_ )
+        {
+            if ( ++count_ >= ATTACH_DEBOUNCE )
+            {
+                count_ = 0;
+                state_ = TARGET_ABSENT;
+            }
+            return state_;
+        }
+        count_ = 0;
+
+        if ( state_ == TARGET_BUSY && pic32.StatusReady() )
+        {
+            latency_ = millis() - seenAt_;
+            state_   = TARGET_READY;
+        }
+        return state_;
+    }
+
+        // Blocks until the target is ready, returns the attach latency
+    uint32_t WaitReady( Pic32JTAGDevice & pic32 )
+    {
+        while ( Poll( pic32 ) != TARGET_READY )
+        {
+            JTAG_PORTS_YIELD();
+            delay( ATTACH_POLL_MS );
+        }
+        return latency_;
+    }
+
+    void WaitRemoved( Pic32JTAGDevice & pic32 )
+    {
+        while ( Poll( pic32 ) != TARGET_ABSENT )
+        {
+            JTAG_PORTS_YIELD();
+            delay( ATTACH_POLL_MS );
+        }
+    }
+
+    uint8_t GetState() const { return state_; }
+
+        // ms from the first IDCODE read to MCHP_STATUS ready
+    uint32_t GetLatency() const { return latency_; }
+};
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef TCK_CALIBRATION_H
+#define TCK_CALIBRATION_H
+
+#include <Arduino.h>
+#include "EepromMap.h"
+#include "Pic32JTAGDevice.h"
+
+/**
+ * Finds the fastest TCK delay setting the wiring of this station takes.
+ * Settings are tried from slow to fast, each with TCK_CAL_ROUNDS link
+ * tests. The last setting before the first error wins and is saved in
+ * EEPROM. Best run in programming mode, to exercise FASTDATA as well.
+ */
+
+#define TCK_CAL_ROUNDS 32
+
+PROGMEM const uint8_t TckCalSettings[] =
+{
+    TCK_DELAY_US + 20, TCK_DELAY_US + 10, TCK_DELAY_US + 5,
+    TCK_DELAY_US + 2,  TCK_DELAY_US + 1,
+    32, 16, 8, 4, 2, 1,
+    TCK_DELAY_NONE
+};
+
+void LoadTckDelay()
+{
+    uint8_t d = eeprom_read_byte( EE_ADDR(EE_TCK_DELAY) );
+
+    JTAGTckDelay = ( d == 0xff ) ? TCK_DELAY_DEFAULT : d;
+}
+
+void CalibrateTCK( Pic32JTAGDevice &pic32 )
+{
+    uint8_t best = 0xff;
+    uint8_t i, r;
+
+        // No target reads all ones, which TestLink() would pass at
+        // any speed
+    if ( !pic32.GetDeviceID() || pic32.GetDeviceID() == 0xffffffff )
+    {
+        Serial.println(F("No target"));
+        return;
+    }
+
+    for ( i = 0; i < sizeof(TckCalSettings); ++i )
+    {
+        uint8_t  setting = pgm_read_byte( &TckCalSettings[i] );
+        uint16_t errors  = 0;
+
+        JTAGTckDelay = setting;
+        for ( r = 0; r < TCK_CAL_ROUNDS; ++r )
+        {
+                // walking one over an alternating pattern
+            uint32_t pattern = 0x55aa33ccUL ^ ( 1UL << r );
+            if ( !pic32.TestLink( pattern ) )
+            {
+                ++errors;
+            }
+        }
+
+        Serial.print(F("TCK delay "));
+        Serial.print( setting );
+        Serial.print(F(": "));
+        Serial.print( errors );
+        Serial.println(F(" errors"));
+
+        if ( errors )
+        {
+            break;
+        }
+        best = setting;
+    }
+
+    if ( best == 0xff )
+    {
+        Serial.println(F("Link fails even at the slowest setting!"));
+        best = TCK_DELAY_DEFAULT;
+    }
+    else
+    {
+        eeprom_update_byte( EE_ADDR(EE_TCK_DELAY), best );
+        Serial.print(F("Saved TCK delay "));
+        Serial.println( best );
+    }
+
+        // leave the TAP in a known state at the chosen speed
+    JTAGTckDelay = best;
+    pic32.TestLink( 0 );
+}
+
+#endif
@@ -0,0 +1,324 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#ifndef XSVF_PLAYER_H
+#define XSVF_PLAYER_H
+
+#include <Arduino.h>
+#include "ArduinoJTAG.h"
+
+/**
+ * Compact XSVF player. Plays back a precompiled programming session
+ * (see host/xsvfgen.cpp), all per-word decisions were made on the host,
+ * here only the vectors are shifted and TDO is compared with the mask.
+ *
+ * Supported: XCOMPLETE, XTDOMASK, XSIR, XSDR, XRUNTEST, XREPEAT,
+ * XSDRSIZE, XSDRTDO, XSTATE (Test-Logic-Reset / Run-Test/Idle),
+ * XENDIR/XENDDR (Run-Test/Idle only) and XWAIT. Vectors are at most
+ * XSVF_MAX_BITS long and sent MSB byte first as in standard XSVF.
+ *
+ * XPIC_MCLR <level:u8> is a private extension driving the MCLR pin.
+ *
+ * A failing compare is retried XREPEAT times from Run-Test/Idle, after
+ * waiting the XRUNTEST time.
+ */
+
+#define XSVF_MAX_BITS   64
+#define XSVF_MAX_BYTES  (XSVF_MAX_BITS / 8)
+
+enum xsvf_cmd_e {
+    XCOMPLETE = 0x00,
+    XTDOMASK  = 0x01,
+    XSIR      = 0x02,
+    XSDR      = 0x03,
+    XRUNTEST  = 0x04,
+    XREPEAT   = 0x07,
+    XSDRSIZE  = 0x08,
+    XSDRTDO   = 0x09,
+    XSTATE    = 0x12,
+    XENDIR    = 0x13,
+    XENDDR    = 0x14,
+    XWAIT     = 0x17,
+    XPIC_MCLR = 0x80
+};
+
+enum xsvf_state_e {
+    XSVF_TLR = 0x00,
+    XSVF_RTI = 0x01
+};
+
+enum xsvf_error_e {
+    XSVF_OK            = 0,
+    XSVF_TDO_MISMATCH  = 3,
+    XSVF_ILLEGAL_CMD   = 4,
+    XSVF_ILLEGAL_STATE = 5,
+    XSVF_DATA_OVERFLOW = 6
+};
+
+class XsvfPlayer: public ArduinoJTAG {
+
+private:
+    uint8_t  (*read_)(void);
+
+    uint8_t  tdi_ [XSVF_MAX_BYTES];
+    uint8_t  tdo_ [XSVF_MAX_BYTES];
+    uint8_t  mask_[XSVF_MAX_BYTES];
+
+    uint8_t  sdrBits_;
+    uint8_t  repeat_;
+    uint32_t runTest_;
+    bool     inReset_;
+    uint32_t commands_;
+
+    uint32_t ReadLong()
+    {
+        uint32_t v = 0;
+        uint8_t  i;
+
+        for ( i = 0; i < 4; ++i )
+        {
+            v = ( v << 8 ) | read_();
+        }
+        return v;
+    }
+
+    void ReadVector( uint8_t * v, uint8_t bits )
+    {
+        uint8_t i;
+
+        for ( i = 0; i < (bits + 7) / 8; ++i )
+        {
+            v[i] = read_();
+        }
+    }
+
+    void Wait( uint32_t us )
+    {
+        if ( us >= 16384 )
+        {
+            delay( us / 1000 );
+        }
+        else if ( us )
+        {
+            delayMicroseconds( us );
+        }
+    }
+
+    void GotoIdle()
+    {
+        if ( inReset_ )
+        {
+            ClearTMS();
+            ClockPulse();
+            inReset_ = false;
+        }
+    }
+
+        // Shifts a MSB byte first vector, returns true if TDO matched
+    bool Scan( bool ir, uint8_t bits, bool compare )
+    {
+        uint8_t nbytes = (bits + 7) / 8;
+        bool    ok = true;
+        uint8_t i;
+
+        GotoIdle();
+        EnterShift( ir );
+
+        for ( i = 0; i < bits; ++i )
+        {
+            uint8_t idx = nbytes - 1 - i / 8;
+            uint8_t m   = 1 << ( i & 7 );
+
+            if ( i == bits - 1 )
+            {
+                SetTMS();
+            }
+            if ( tdi_[idx] & m )
+            {
+                SetTDI();
+            }
+            else
+            {
+                ClearTDI();
+            }
+
+            bool tdo = ClockPulse();
+            if ( compare && ( mask_[idx] & m ) && ( tdo != ( ( tdo_[idx] & m ) != 0 ) ) )
+            {
+                ok = false;
+            }
+        }
+
+        LeaveShift();
+        return ok;
+    }
+
+    bool ScanDRCompare()
+    {
+        uint8_t tries = repeat_;
+
+        while ( !Scan( false, sdrBits_, true ) )
+        {
+            if ( !tries-- )
+            {
+                return false;
+            }
+            Wait( runTest_ );
+        }
+        Wait( runTest_ );
+        return true;
+    }
+
+public:
+    XsvfPlayer( uint8_t (*read)(void) )
+        : read_( read )
+    {
+        sdrBits_  = 0;
+        repeat_   = 32;
+        runTest_  = 0;
+        inReset_  = false;
+        commands_ = 0;
+        memset( mask_, 0, sizeof(mask_) );
+        memset( tdo_,  0, sizeof(tdo_) );
+    }
+
+    uint32_t CommandCount()
+    {
+        return commands_;
+    }
+
+    uint8_t Play()
+    {
+        uint8_t  bits;
+        uint32_t v;
+
+        for ( ;; )
+        {
+            uint8_t cmd = read_();
+            ++commands_;
+
+            switch ( cmd )
+            {
+                case XCOMPLETE:
+                    return XSVF_OK;
+
+                case XTDOMASK:
+                    ReadVector( mask_, sdrBits_ );
+                    break;
+
+                case XSIR:
+                    bits = read_();
+                    if ( bits > XSVF_MAX_BITS )
+                    {
+                        return XSVF_DATA_OVERFLOW;
+                    }
+                    ReadVector( tdi_, bits );
+                    Scan( true, bits, false );
+                    break;
+
+                case XSDRTDO:
+                    ReadVector( tdi_, sdrBits_ );
+                    ReadVector( tdo_, sdrBits_ );
+                    if ( !ScanDRCompare() )
+                    {
+                        return XSVF_TDO_MISMATCH;
+                    }
+                    break;
+
+                case XSDR:
+                    ReadVector( tdi_, sdrBits_ );
+                    if ( !ScanDRCompare() )
+                    {
+                        return XSVF_TDO_MISMATCH;
+                    }
+                    break;
+
+                case XRUNTEST:
+                    runTest_ = ReadLong();
+                    break;
+
+                case XREPEAT:
+                    repeat_ = read_();
+                    break;
+
+                case XSDRSIZE:
+                    v = ReadLong();
+                    if ( v > XSVF_MAX_BITS )
+                    {
+                        return XSVF_DATA_OVERFLOW;
+                    }
+                    sdrBits_ = v;
+                    break;
+
+                case XSTATE:
+                    if ( read_() == XSVF_TLR )
+                    {
+                        ShiftTMS( 5, 0x1f );
+                        inReset_ = true;
+                    }
+                    else
+                    {
+                        GotoIdle();
+                    }
+                    break;
+
+                case XENDIR:
+                case XENDDR:
+                    if ( read_() != 0 )
+                    {
+                        return XSVF_ILLEGAL_STATE;
+                    }
+                    break;
+
+                case XWAIT:
+                    read_();    // wait state, always Run-Test/Idle
+                    read_();    // end state, likewise
+                    GotoIdle();
+                    Wait( ReadLong() );
+                    break;
+
+                case XPIC_MCLR:
+                    if ( read_() )
+                    {
+                        SetMCLR();
+                    }
+                    else
+                    {
+                        ClearMCLR();
+                    }
+                    break;
+
+                default:
+                    return XSVF_ILLEGAL_CMD;
+            }
+        }
+    }
+};
+
+#endif
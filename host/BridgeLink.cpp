@@ -0,0 +1,430 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "BridgeLink.h"
+
+#include <poll.h>
+#include <stdexcept>
+#include <unistd.h>
+
+enum {
+    BRIDGE_VERSION       = 1,
+    BRIDGE_MAX_POLL_BITS = 64,
+    BRIDGE_OK            = 0x00,
+    BRIDGE_POLL_TIMEOUT  = 0x01
+};
+
+BridgeLink::BridgeLink(SerialPort & port, size_t window, size_t batch)
+    : port_( port ),
+      window_( window ),
+      batch_( batch ),
+      minPollTries_( 1000 ),
+      captured_( 0 ),
+      queuedBytes_( 0 ),
+      pollTimeouts_( 0 ),
+      frames_( 0 ),
+      flushes_( 0 )
+{
+}
+
+BridgeLink::~BridgeLink()
+{
+    if ( HostDelayHookCtx == this )
+    {
+        HostDelayHook    = 0;
+        HostDelayHookCtx = 0;
+    }
+}
+
+bool BridgeLink::Enter()
+{
+    uint8_t reply[6];
+
+    port_.Write( "B", 1 );
+    port_.Write( "S", 1 );
+    if ( port_.Read( reply, sizeof(reply), 2000 ) != sizeof(reply) ||
+         memcmp( reply, "AP32", 4 ) != 0 ||
+         reply[4] != BRIDGE_VERSION ||
+         reply[5] != BRIDGE_OK )
+    {
+        return false;
+    }
+
+    HostDelayHook    = DelayHook;
+    HostDelayHookCtx = this;
+    return true;
+}
+
+void BridgeLink::Leave()
+{
+    Frame f;
+
+    f.bytes.push_back( 'X' );
+    f.replyLen = 1;
+    Queue( f );
+    Flush();
+
+    if ( HostDelayHookCtx == this )
+    {
+        HostDelayHook    = 0;
+        HostDelayHookCtx = 0;
+    }
+}
+
+void BridgeLink::DelayHook(void * ctx, unsigned long ms)
+{
+    static_cast<BridgeLink *>(ctx)->Wait( ms );
+}
+
+void BridgeLink::AddBit(bool tms, bool tdi, bool cap)
+{
+    tms_.push_back( tms );
+    tdi_.push_back( tdi );
+    cap_.push_back( cap );
+    captured_ += cap;
+}
+
+    // Same TMS pattern as ArduinoJTAG::EnterShift/ShiftBits/LeaveShift
+void BridgeLink::AddScan(bool ir, unsigned char bits, uint32_t tdi, bool capture, bool lead)
+{
+    AddBit( 1, 0, 0 );
+    if ( ir )
+    {
+        AddBit( 1, 0, 0 );
+    }
+    AddBit( 0, 0, 0 );
+    AddBit( 0, 0, 0 );
+
+    if ( lead )
+    {
+        AddBit( 0, 0, capture );
+    }
+    while ( bits-- )
+    {
+        AddBit( bits == 0, tdi & 1, capture );
+        tdi >>= 1;
+    }
+
+    AddBit( 1, 0, 0 );
+    AddBit( 0, 0, 0 );
+}
+
+void BridgeLink::CloseVector()
+{
+    Frame  f;
+    size_t n = tms_.size();
+    size_t i;
+
+    if ( !n )
+    {
+        return;
+    }
+
+    f.bytes.push_back( 'V' );
+    f.bytes.push_back( n & 0xff );
+    f.bytes.push_back( n >> 8 );
+
+    for ( i = 0; i < n; i += 8 )
+    {
+        uint8_t t = 0, d = 0, c = 0;
+        for ( size_t b = 0; b < 8 && i + b < n; ++b )
+        {
+            t |= tms_[i + b] << b;
+            d |= tdi_[i + b] << b;
+            c |= cap_[i + b] << b;
+        }
+        f.bytes.push_back( t );
+        f.bytes.push_back( d );
+        f.bytes.push_back( c );
+    }
+    f.replyLen = (captured_ + 7) / 8 + 1;
+
+    tms_.clear();
+    tdi_.clear();
+    cap_.clear();
+    captured_ = 0;
+
+    Queue( f );
+}
+
+void BridgeLink::Queue(Frame & f)
+{
+    queuedBytes_ += f.bytes.size();
+    queue_.push_back( Frame() );
+    queue_.back().bytes.swap( f.bytes );
+    queue_.back().replyLen = f.replyLen;
+    ++frames_;
+
+    if ( queuedBytes_ >= batch_ )
+    {
+        Flush();
+    }
+}
+
+void BridgeLink::Flush()
+{
+    std::deque<size_t> inFlight;     // request sizes of unanswered frames
+    size_t inFlightBytes = 0;
+    size_t next = 0;
+    std::vector<uint8_t> rx;
+
+    CloseVector();
+    if ( queue_.empty() )
+    {
+        return;
+    }
+    ++flushes_;
+
+        //
+        // Send as much as the window allows, read whatever comes back.
+        // Replies are matched to frames in order by their length.
+        //
+    size_t frameDone = 0;
+    size_t frameGot  = 0;
+    while ( frameDone < queue_.size() )
+    {
+        std::vector<uint8_t> out;
+        while ( next < queue_.size() &&
+                ( inFlightBytes == 0 ||
+                  inFlightBytes + queue_[next].bytes.size() <= window_ ) )
+        {
+            out.insert( out.end(), queue_[next].bytes.begin(), queue_[next].bytes.end() );
+            inFlight.push_back( queue_[next].bytes.size() );
+            inFlightBytes += queue_[next].bytes.size();
+            ++next;
+        }
+        if ( !out.empty() && !port_.Write( out.data(), out.size() ) )
+        {
+            throw std::runtime_error( "bridge: write failed" );
+        }
+
+        uint8_t buf[256];
+        long got = port_.Read( buf, 1, 5000 );
+        if ( got != 1 )
+        {
+            throw std::runtime_error( "bridge: no reply from programmer" );
+        }
+        struct pollfd pfd = { port_.Fd(), POLLIN, 0 };
+        if ( ::poll( &pfd, 1, 0 ) > 0 )
+        {
+            long more = ::read( port_.Fd(), buf + 1, sizeof(buf) - 1 );
+            if ( more > 0 )
+            {
+                got += more;
+            }
+        }
+
+        for ( long k = 0; k < got; ++k )
+        {
+            const Frame & f = queue_[frameDone];
+            ++frameGot;
+            if ( frameGot < f.replyLen )
+            {
+                rx.push_back( buf[k] );
+                continue;
+            }
+
+                // Status byte finishes the frame
+            if ( buf[k] == BRIDGE_POLL_TIMEOUT )
+            {
+                ++pollTimeouts_;
+            }
+            else if ( buf[k] != BRIDGE_OK )
+            {
+                throw std::runtime_error( "bridge: programmer rejected a frame" );
+            }
+
+            if ( frameDone + 1 == queue_.size() )
+            {
+                reply_.swap( rx );
+            }
+            rx.clear();
+            inFlightBytes -= inFlight.front();
+            inFlight.pop_front();
+            frameGot = 0;
+            ++frameDone;
+        }
+    }
+
+    queue_.clear();
+    queuedBytes_ = 0;
+}
+
+    // Returns 'bits' captured bits of the last flushed frame from 'first'
+uint32_t BridgeLink::Collect(unsigned char first, unsigned char bits)
+{
+    uint32_t data = 0;
+
+    for ( unsigned char b = 0; b < bits; ++b )
+    {
+        size_t i = first + b;
+        if ( i / 8 < reply_.size() && ( reply_[i / 8] >> (i % 8) ) & 1 )
+        {
+            data |= (uint32_t)1 << b;
+        }
+    }
+    return data;
+}
+
+void BridgeLink::Wait(unsigned long ms)
+{
+    Frame f;
+
+    CloseVector();
+    while ( ms )
+    {
+        unsigned long chunk = ms > 0xffff ? 0xffff : ms;
+        f.bytes.clear();
+        f.bytes.push_back( 'W' );
+        f.bytes.push_back( chunk & 0xff );
+        f.bytes.push_back( chunk >> 8 );
+        f.replyLen = 1;
+        Queue( f );
+        ms -= chunk;
+    }
+}
+
+void BridgeLink::SetMCLR(bool level)
+{
+    Frame f;
+
+    CloseVector();
+    f.bytes.push_back( 'R' );
+    f.bytes.push_back( level );
+    f.replyLen = 1;
+    Queue( f );
+}
+
+uint32_t BridgeLink::ShiftTMS(unsigned char bits, uint32_t tms)
+{
+    CloseVector();
+    for ( unsigned char b = 0; b < bits; ++b )
+    {
+        AddBit( ( tms >> b ) & 1, 0, 1 );
+    }
+    Flush();
+    return Collect( 0, bits );
+}
+
+uint32_t BridgeLink::ScanIR(unsigned char bits, uint32_t tdi)
+{
+    CloseVector();
+    AddScan( true, bits, tdi, true, false );
+    Flush();
+    return Collect( 0, bits );
+}
+
+uint32_t BridgeLink::ScanDR(unsigned char bits, uint32_t tdi)
+{
+    CloseVector();
+    AddScan( false, bits, tdi, true, false );
+    Flush();
+    return Collect( 0, bits );
+}
+
+uint32_t BridgeLink::ScanDR(unsigned char bits, uint32_t tdi, bool & lead)
+{
+    CloseVector();
+    AddScan( false, bits, tdi, true, true );
+    Flush();
+    lead = Collect( 0, 1 );
+    return Collect( 1, bits );
+}
+
+void BridgeLink::WriteIR(unsigned char bits, uint32_t tdi)
+{
+    AddScan( true, bits, tdi, false, false );
+}
+
+void BridgeLink::WriteDR(unsigned char bits, uint32_t tdi)
+{
+    AddScan( false, bits, tdi, false, false );
+}
+
+    //
+    // Polls run on the Arduino. The result is not waited for: a poll that
+    // times out is reported when the batch is flushed, and counted in
+    // PollTimeouts(). As the host cannot retry, at least minPollTries_
+    // scans are allowed.
+    //
+bool BridgeLink::PollDR(unsigned char bits, uint32_t tdi, uint32_t mask, uint16_t tries)
+{
+    Frame f;
+
+    CloseVector();
+    AddBit( 1, 0, 0 );
+    AddBit( 0, 0, 0 );
+    AddBit( 0, 0, 0 );
+    while ( bits-- )
+    {
+        AddBit( bits == 0, tdi & 1, mask & 1 );
+        tdi  >>= 1;
+        mask >>= 1;
+    }
+    AddBit( 1, 0, 0 );
+    AddBit( 0, 0, 0 );
+
+    size_t n = tms_.size();
+    if ( n > BRIDGE_MAX_POLL_BITS )
+    {
+        throw std::runtime_error( "bridge: poll vector too long" );
+    }
+
+    if ( tries < minPollTries_ )
+    {
+        tries = minPollTries_;
+    }
+
+    f.bytes.push_back( 'P' );
+    f.bytes.push_back( n );
+    f.bytes.push_back( tries & 0xff );
+    f.bytes.push_back( tries >> 8 );
+    for ( size_t i = 0; i < n; i += 8 )
+    {
+        uint8_t t = 0, d = 0, c = 0;
+        for ( size_t b = 0; b < 8 && i + b < n; ++b )
+        {
+            t |= tms_[i + b] << b;
+            d |= tdi_[i + b] << b;
+            c |= cap_[i + b] << b;
+        }
+        f.bytes.push_back( t );
+        f.bytes.push_back( d );
+        f.bytes.push_back( c );
+    }
+    f.replyLen = 1;
+
+    tms_.clear();
+    tdi_.clear();
+    cap_.clear();
+    captured_ = 0;
+
+    Queue( f );
+    return true;
+}
@@ -0,0 +1,112 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+/*
+ * Host end of the JTAGBridge.h bit vector protocol.
+ *
+ * Scans are turned into TMS/TDI/capture vectors and queued. Scans
+ * whose result is not needed (WriteIR/WriteDR, PollDR) never wait for
+ * the Arduino, so long instruction sequences go out as a few large
+ * batches. A scan returning data flushes the queue and waits for the
+ * reply.
+ */
+#ifndef ARDUPIC32_BRIDGE_LINK_H
+#define ARDUPIC32_BRIDGE_LINK_H
+
+#include "HostJTAG.h"
+#include "SerialPort.h"
+
+#include <deque>
+#include <vector>
+
+class BridgeLink: public JTAGBackend
+{
+private:
+    struct Frame
+    {
+        std::vector<uint8_t> bytes;
+        size_t               replyLen;   // including the status byte
+    };
+
+    SerialPort &         port_;
+    size_t               window_;
+    size_t               batch_;
+    uint16_t             minPollTries_;
+
+        // Vector being collected, one entry per bit
+    std::vector<uint8_t> tms_, tdi_, cap_;
+    size_t               captured_;
+
+    std::deque<Frame>    queue_;
+    size_t               queuedBytes_;
+    std::vector<uint8_t> reply_;          // TDO bytes of the last frame
+
+    unsigned long        pollTimeouts_;
+    unsigned long        frames_;
+    unsigned long        flushes_;
+
+    void AddBit(bool tms, bool tdi, bool cap);
+    void AddScan(bool ir, unsigned char bits, uint32_t tdi, bool capture, bool lead);
+    void CloseVector();
+    void Queue(Frame & f);
+    uint32_t Collect(unsigned char first, unsigned char bits);
+
+    static void DelayHook(void * ctx, unsigned long ms);
+
+public:
+        // 'window' is the number of request bytes allowed in flight,
+        // keep it below the sketch's serial RX buffer size.
+    explicit BridgeLink(SerialPort & port, size_t window = 60, size_t batch = 4096);
+    ~BridgeLink();
+
+        // Switches a sketch waiting for "H" into bridge mode
+    bool Enter();
+    void Leave();
+
+        // Sends everything queued and waits for all replies
+    void Flush();
+
+        // Queues an Arduino side delay, keeps ordering with the scans
+    void Wait(unsigned long ms);
+
+    unsigned long PollTimeouts() const { return pollTimeouts_; }
+    unsigned long Frames() const       { return frames_; }
+    unsigned long Flushes() const      { return flushes_; }
+
+    void     SetMCLR(bool level) override;
+    uint32_t ShiftTMS(unsigned char bits, uint32_t tms) override;
+    uint32_t ScanIR(unsigned char bits, uint32_t tdi) override;
+    uint32_t ScanDR(unsigned char bits, uint32_t tdi) override;
+    uint32_t ScanDR(unsigned char bits, uint32_t tdi, bool & lead) override;
+    void     WriteIR(unsigned char bits, uint32_t tdi) override;
+    void     WriteDR(unsigned char bits, uint32_t tdi) override;
+    bool     PollDR(unsigned char bits, uint32_t tdi, uint32_t mask, uint16_t tries) override;
+};
+
+#endif
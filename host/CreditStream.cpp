@@ -0,0 +1,133 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "CreditStream.h"
+
+#include <stdio.h>
+
+CreditStream::CreditStream(SerialPort & port, bool echo)
+    : port_( port ),
+      credits_( 0 ),
+      echo_( echo )
+{
+}
+
+bool CreditStream::Pump(int timeoutMs)
+{
+    uint8_t buf[256];
+    long n = port_.Read( buf, 1, timeoutMs );
+
+    if ( n <= 0 )
+    {
+        return false;
+    }
+    long more = port_.Read( buf + 1, sizeof(buf) - 1, 0 );
+    if ( more > 0 )
+    {
+        n += more;
+    }
+
+    for ( long i = 0; i < n; ++i )
+    {
+        if ( buf[i] == CREDIT_XON )
+        {
+            ++credits_;
+        }
+        else
+        {
+            text_ += (char)buf[i];
+            if ( echo_ )
+            {
+                fputc( buf[i], stdout );
+            }
+        }
+    }
+    if ( echo_ )
+    {
+        fflush( stdout );
+    }
+    return true;
+}
+
+bool CreditStream::Send(const uint8_t * data, size_t len, int timeoutMs,
+                        void (*progress)(void *, size_t, size_t), void * ctx)
+{
+    size_t sent = 0;
+
+    while ( sent < len )
+    {
+        if ( !credits_ )
+        {
+            if ( !Pump( timeoutMs ) )
+            {
+                return false;
+            }
+            continue;
+        }
+
+        size_t n = len - sent < CREDIT_BYTES ? len - sent : CREDIT_BYTES;
+        if ( !port_.Write( data + sent, n ) )
+        {
+            return false;
+        }
+        sent += n;
+        --credits_;
+
+        if ( progress )
+        {
+            progress( ctx, sent, len );
+        }
+        Pump( 0 );
+    }
+    return true;
+}
+
+bool CreditStream::WaitFor(const char * pattern, int timeoutMs)
+{
+    while ( text_.find( pattern ) == std::string::npos )
+    {
+        if ( !Pump( timeoutMs ) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool CreditStream::WaitUntil(bool (*done)(const std::string &), int timeoutMs)
+{
+    while ( !done( text_ ) )
+    {
+        if ( !Pump( timeoutMs ) )
+        {
+            return false;
+        }
+    }
+    return true;
+}
@@ -0,0 +1,76 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+/*
+ * Sender side of the sketch's RXStreamByte() flow control: the sketch
+ * sends one XON per 32 bytes it has consumed, and starts with two.
+ */
+#ifndef ARDUPIC32_CREDIT_STREAM_H
+#define ARDUPIC32_CREDIT_STREAM_H
+
+#include "SerialPort.h"
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+enum {
+    CREDIT_BYTES = 32,
+    CREDIT_XON   = 0x11
+};
+
+class CreditStream
+{
+private:
+    SerialPort & port_;
+    unsigned     credits_;
+    std::string  text_;
+    bool         echo_;
+
+        // Reads what is pending, false on timeout
+    bool Pump(int timeoutMs);
+
+public:
+    CreditStream(SerialPort & port, bool echo = true);
+
+        // Blocks until everything has been handed to the sketch. Text
+        // the sketch prints meanwhile is collected (and echoed).
+    bool Send(const uint8_t * data, size_t len, int timeoutMs = 10000,
+              void (*progress)(void *, size_t, size_t) = 0, void * ctx = 0);
+
+        // Collects output until 'pattern' or timeout
+    bool WaitFor(const char * pattern, int timeoutMs);
+
+        // Collects output until done(Text()) or timeout
+    bool WaitUntil(bool (*done)(const std::string &), int timeoutMs);
+
+    const std::string & Text() const { return text_; }
+};
+
+#endif
@@ -0,0 +1,120 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+/*
+ * Host replacement for ArduinoJTAG.h.
+ *
+ * Include this before any of the sketch headers: it claims the
+ * ARDUINO_JTAG include guard, so Pic32JTAG and Pic32JTAGDevice are
+ * compiled unchanged on top of a JTAGBackend instead of port pins.
+ */
+#ifndef ARDUINO_JTAG
+#define ARDUINO_JTAG
+
+#include <Arduino.h>
+
+#define JTAG_PORTS 1
+#define JTAG_PORTS_YIELD()
+
+    //
+    // The TAP level scan set of ArduinoJTAG. Semantics are the same as
+    // in the sketch: every scan starts and ends in Run-Test/Idle.
+    //
+class JTAGBackend
+{
+public:
+    virtual ~JTAGBackend() {}
+
+    virtual void     SetMCLR(bool level) = 0;
+    virtual uint32_t ShiftTMS(unsigned char bits, uint32_t tms) = 0;
+    virtual uint32_t ScanIR(unsigned char bits, uint32_t tdi) = 0;
+    virtual uint32_t ScanDR(unsigned char bits, uint32_t tdi) = 0;
+    virtual uint32_t ScanDR(unsigned char bits, uint32_t tdi, bool & lead) = 0;
+    virtual bool     PollDR(unsigned char bits, uint32_t tdi, uint32_t mask, uint16_t tries) = 0;
+
+    virtual void WriteIR(unsigned char bits, uint32_t tdi)
+    {
+        ScanIR( bits, tdi );
+    }
+
+    virtual void WriteDR(unsigned char bits, uint32_t tdi)
+    {
+        ScanDR( bits, tdi );
+    }
+};
+
+
+class ArduinoJTAG
+{
+private:
+    JTAGBackend * jtag_;
+
+    static JTAGBackend * & DefaultBackend()
+    {
+        static thread_local JTAGBackend * backend = 0;
+        return backend;
+    }
+
+public:
+        // Backend used by objects constructed after this call
+    static void SetBackend(JTAGBackend * backend)
+    {
+        DefaultBackend() = backend;
+    }
+
+protected:
+        // One backend per object, the port number is for the sketch
+    ArduinoJTAG( uint8_t port = 0 )
+        : jtag_( DefaultBackend() )
+    {
+        SetMCLR();
+    }
+
+    JTAGBackend & Backend()
+    {
+        return *jtag_;
+    }
+
+    void SetMCLR()   { jtag_->SetMCLR( true );  }
+    void ClearMCLR() { jtag_->SetMCLR( false ); }
+
+    uint32_t ShiftTMS(unsigned char bits, uint32_t tms)           { return jtag_->ShiftTMS( bits, tms ); }
+    uint32_t ScanIR(unsigned char bits, uint32_t tdi)             { return jtag_->ScanIR( bits, tdi ); }
+    uint32_t ScanDR(unsigned char bits, uint32_t tdi)             { return jtag_->ScanDR( bits, tdi ); }
+    uint32_t ScanDR(unsigned char bits, uint32_t tdi, bool &lead) { return jtag_->ScanDR( bits, tdi, lead ); }
+    void     WriteIR(unsigned char bits, uint32_t tdi)            { jtag_->WriteIR( bits, tdi ); }
+    void     WriteDR(unsigned char bits, uint32_t tdi)            { jtag_->WriteDR( bits, tdi ); }
+
+    bool PollDR(unsigned char bits, uint32_t tdi, uint32_t mask, uint16_t tries)
+    {
+        return jtag_->PollDR( bits, tdi, mask, tries );
+    }
+};
+
+#endif
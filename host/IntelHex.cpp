@@ -0,0 +1,263 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "IntelHex.h"
+
+#include <stdio.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+
+static int Nibble(char c)
+{
+    if ( c >= '0' && c <= '9' ) return c - '0';
+    if ( c >= 'A' && c <= 'F' ) return c - 'A' + 10;
+    if ( c >= 'a' && c <= 'f' ) return c - 'a' + 10;
+    return -1;
+}
+
+bool IntelHex::Load(const std::string & path, std::string & error)
+{
+    std::ifstream in( path.c_str(), std::ios::binary );
+    if ( !in )
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+    std::stringstream ss;
+    ss << in.rdbuf();
+    return Parse( ss.str(), error );
+}
+
+bool IntelHex::Parse(const std::string & text, std::string & error)
+{
+    std::istringstream in( text );
+    std::string line;
+    uint32_t base = 0;
+    unsigned lineNo = 0;
+
+    extents_.clear();
+
+    while ( std::getline( in, line ) )
+    {
+        ++lineNo;
+        while ( !line.empty() && (unsigned char)line[line.size() - 1] <= ' ' )
+        {
+            line.erase( line.size() - 1 );
+        }
+        if ( line.empty() )
+        {
+            continue;
+        }
+        if ( line[0] != ':' || line.size() < 11 || (line.size() - 1) % 2 )
+        {
+            error = "bad record on line " + std::to_string( lineNo );
+            return false;
+        }
+
+        std::vector<uint8_t> rec;
+        uint8_t sum = 0;
+        for ( size_t i = 1; i < line.size(); i += 2 )
+        {
+            int hi = Nibble( line[i] ), lo = Nibble( line[i + 1] );
+            if ( hi < 0 || lo < 0 )
+            {
+                error = "bad hex digit on line " + std::to_string( lineNo );
+                return false;
+            }
+            rec.push_back( hi << 4 | lo );
+            sum += rec.back();
+        }
+        if ( sum != 0 || rec.size() != (size_t)rec[0] + 5 )
+        {
+            error = "checksum or length error on line " + std::to_string( lineNo );
+            return false;
+        }
+
+        uint32_t addr = rec[1] << 8 | rec[2];
+        const uint8_t * data = &rec[4];
+
+        switch ( rec[3] )
+        {
+            case 0:
+                Add( base + addr, data, rec[0] );
+                break;
+            case 1:
+                return true;
+            case 2:
+                base = (uint32_t)( data[0] << 8 | data[1] ) << 4;
+                break;
+            case 4:
+                base = (uint32_t)( data[0] << 8 | data[1] ) << 16;
+                break;
+            case 3:
+            case 5:
+                break;
+            default:
+                error = "unknown record type on line " + std::to_string( lineNo );
+                return false;
+        }
+    }
+    return true;
+}
+
+void IntelHex::Add(uint32_t addr, const uint8_t * data, size_t len)
+{
+        // Merge with an extent ending at or overlapping 'addr'
+    Extents::iterator it = extents_.upper_bound( addr );
+    if ( it != extents_.begin() )
+    {
+        Extents::iterator prev = it;
+        --prev;
+        if ( prev->first + prev->second.size() >= addr )
+        {
+            std::vector<uint8_t> & v = prev->second;
+            size_t off = addr - prev->first;
+            if ( v.size() < off + len )
+            {
+                v.resize( off + len, 0xff );
+            }
+            std::copy( data, data + len, v.begin() + off );
+            it = prev;
+        }
+        else
+        {
+            it = extents_.insert( std::make_pair( addr, std::vector<uint8_t>( data, data + len ) ) ).first;
+        }
+    }
+    else
+    {
+        it = extents_.insert( std::make_pair( addr, std::vector<uint8_t>( data, data + len ) ) ).first;
+    }
+
+        // Swallow following extents now touching this one
+    Extents::iterator next = it;
+    ++next;
+    while ( next != extents_.end() && next->first <= it->first + it->second.size() )
+    {
+        std::vector<uint8_t> & v = it->second;
+        size_t off = next->first - it->first;
+        if ( v.size() < off + next->second.size() )
+        {
+            v.resize( off + next->second.size(), 0xff );
+        }
+        for ( size_t i = 0; i < next->second.size(); ++i )
+        {
+                // The record just added takes precedence
+            uint32_t a = next->first + i;
+            if ( a < addr || a >= addr + len )
+            {
+                v[off + i] = next->second[i];
+            }
+        }
+        next = extents_.erase( next );
+    }
+}
+
+static void Record(FILE * f, uint32_t addr, uint8_t type, const uint8_t * data, size_t len)
+{
+    uint8_t sum = len + (addr >> 8) + addr + type;
+
+    fprintf( f, ":%02X%04X%02X", (unsigned)len, (unsigned)( addr & 0xffff ), type );
+    for ( size_t i = 0; i < len; ++i )
+    {
+        fprintf( f, "%02X", data[i] );
+        sum += data[i];
+    }
+    fprintf( f, "%02X\n", (uint8_t)-sum );
+}
+
+bool IntelHex::Save(const std::string & path) const
+{
+    FILE * f = fopen( path.c_str(), "w" );
+    uint32_t upper = 0xffffffff;
+
+    if ( !f )
+    {
+        return false;
+    }
+    for ( Extents::const_iterator it = extents_.begin(); it != extents_.end(); ++it )
+    {
+        const std::vector<uint8_t> & v = it->second;
+
+        for ( size_t off = 0; off < v.size(); )
+        {
+            uint32_t addr = it->first + off;
+                // Up to the next 16 byte boundary, never across 64K
+            size_t len = std::min<size_t>( 16 - addr % 16, v.size() - off );
+
+            if ( std::count( v.begin() + off, v.begin() + off + len, 0xff ) != (long)len )
+            {
+                if ( addr >> 16 != upper )
+                {
+                    uint8_t ext[2] = { (uint8_t)( addr >> 24 ), (uint8_t)( addr >> 16 ) };
+                    upper = addr >> 16;
+                    Record( f, 0, 4, ext, 2 );
+                }
+                Record( f, addr, 0, &v[off], len );
+            }
+            off += len;
+        }
+    }
+    Record( f, 0, 1, 0, 0 );
+    return fclose( f ) == 0;
+}
+
+size_t IntelHex::ByteCount() const
+{
+    size_t n = 0;
+    for ( Extents::const_iterator it = extents_.begin(); it != extents_.end(); ++it )
+    {
+        n += it->second.size();
+    }
+    return n;
+}
+
+bool IntelHex::Word(uint32_t addr, uint32_t & word) const
+{
+    bool any = false;
+
+    word = 0;
+    for ( int b = 3; b >= 0; --b )
+    {
+        uint8_t byte = 0xff;
+        Extents::const_iterator it = extents_.upper_bound( addr + b );
+        if ( it != extents_.begin() )
+        {
+            --it;
+            if ( addr + b < it->first + it->second.size() )
+            {
+                byte = it->second[addr + b - it->first];
+                any  = true;
+            }
+        }
+        word = word << 8 | byte;
+    }
+    return any;
+}
@@ -0,0 +1,67 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+/*
+ * Intel HEX reader and writer for the host tools. Record types 00, 01,
+ * 02 and 04 are used, 03 and 05 (start addresses) are ignored. Data is
+ * kept as address ordered, merged extents.
+ */
+#ifndef ARDUPIC32_INTEL_HEX_H
+#define ARDUPIC32_INTEL_HEX_H
+
+#include <stdint.h>
+#include <map>
+#include <string>
+#include <vector>
+
+class IntelHex
+{
+public:
+    typedef std::map<uint32_t, std::vector<uint8_t> > Extents;
+
+private:
+    Extents extents_;
+
+public:
+    bool Load(const std::string & path, std::string & error);
+    bool Parse(const std::string & text, std::string & error);
+
+        // 16 byte records with type 04 records, all 0xFF records left out
+    bool Save(const std::string & path) const;
+
+    void Add(uint32_t addr, const uint8_t * data, size_t len);
+
+    const Extents & Data() const { return extents_; }
+    size_t ByteCount() const;
+
+        // Word at 'addr' with 0xFF filled holes, true if any byte is set
+    bool Word(uint32_t addr, uint32_t & word) const;
+};
+
+#endif
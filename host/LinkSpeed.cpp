@@ -0,0 +1,205 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "LinkSpeed.h"
+
+#include <sys/time.h>
+#include <unistd.h>
+#include <util/crc16.h>
+#include <algorithm>
+
+enum {
+    LISTEN_MS = 200,        // per rate while looking for the station
+    BASE_MS   = 400,
+    PROMPT_MS = 15000
+};
+
+    // The sketch's LinkRates[], fastest first
+static const unsigned long Ladder[] = { 115200, 57600, 38400, 19200, 9600, LINK_BASE_BAUD };
+static const unsigned      LadderLen = sizeof(Ladder) / sizeof(Ladder[0]);
+
+static long NowMs()
+{
+    struct timeval tv;
+    gettimeofday( &tv, 0 );
+    return tv.tv_sec * 1000L + tv.tv_usec / 1000;
+}
+
+static unsigned RateIndex(unsigned long baud)
+{
+    return LadderLen - 1 - ( std::find( Ladder, Ladder + LadderLen, baud ) - Ladder );
+}
+
+static bool IsText(uint8_t c)
+{
+    return ( c >= 0x20 && c <= 0x7e ) || c == '\r' || c == '\n';
+}
+
+    // Reads up to LINK_ACK, skipping announcements and banner text
+static bool WaitAck(SerialPort & port, int timeoutMs)
+{
+    uint8_t c;
+
+    while ( port.Read( &c, 1, timeoutMs ) == 1 && c != LINK_NAK )
+    {
+        if ( c == LINK_ACK )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+static bool IsSync(uint8_t c)
+{
+    return c == LINK_SYNC;
+}
+
+    // Listens at 'baud' for 'run' bytes in a row that fit
+static bool Hears(SerialPort & port, unsigned long baud, long ms, bool (*fits)(uint8_t), unsigned run)
+{
+    long     end = NowMs() + ms;
+    unsigned n   = 0;
+    uint8_t  c;
+
+    port.SetBaud( baud );
+    port.Discard();
+    while ( NowMs() < end && port.Read( &c, 1, end - NowMs() ) == 1 )
+    {
+        n = fits( c ) ? n + 1 : 0;
+        if ( n == run )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+unsigned long LinkAttach(SerialPort & port, int timeoutMs)
+{
+    long deadline = NowMs() + timeoutMs;
+
+    do
+    {
+        for ( unsigned i = 0; i < LadderLen - 1; ++i )
+        {
+            if ( Hears( port, Ladder[i], LISTEN_MS, IsSync, 2 ) )
+            {
+                port.Write( "U", 1 );
+                if ( WaitAck( port, LISTEN_MS ) )
+                {
+                    return Ladder[i];
+                }
+            }
+        }
+
+            // A few bytes of text: the sketch is at LINK_BASE_BAUD
+    } while ( !Hears( port, LINK_BASE_BAUD, BASE_MS, IsText, 4 ) && NowMs() < deadline );
+
+        // Whatever was missed, this has the prompt printed again
+    port.SetBaud( LINK_BASE_BAUD );
+    port.Write( "U", 1 );
+    return LINK_BASE_BAUD;
+}
+
+    // One 'L' exchange, true if both ends run at 'rate' now
+static bool TryRate(SerialPort & port, unsigned long rate)
+{
+    uint8_t  msg[2] = { 'L', (uint8_t)RateIndex( rate ) };
+    uint8_t  out[LINK_PATTERN_LEN + 2], in[LINK_PATTERN_LEN + 2];
+    uint16_t crc = 0xffff, echo = 0xffff;
+    uint8_t  ack = LINK_ACK;
+
+    port.Write( msg, sizeof(msg) );
+    if ( !WaitAck( port, LINK_TEST_MS ) )
+    {
+        return false;
+    }
+    port.SetBaud( rate );
+
+    for ( unsigned i = 0; i < LINK_PATTERN_LEN; ++i )
+    {
+            // every byte value class: edges, runs, alternating bits
+        out[i] = (uint8_t)( i * 0x35 + 0x55 ) ^ ( i & 1 ? 0xff : 0x00 );
+        crc    = _crc_ccitt_update( crc, out[i] );
+        echo   = _crc_ccitt_update( echo, (uint8_t)~out[i] );
+    }
+    out[LINK_PATTERN_LEN]     = crc & 0xff;
+    out[LINK_PATTERN_LEN + 1] = crc >> 8;
+
+    port.Write( out, sizeof(out) );
+    if ( port.Read( in, sizeof(in), 2 * LINK_TEST_MS ) != (long)sizeof(in) )
+    {
+        return false;
+    }
+    for ( unsigned i = 0; i < LINK_PATTERN_LEN; ++i )
+    {
+        if ( in[i] != (uint8_t)~out[i] )
+        {
+            return false;
+        }
+    }
+    if ( in[LINK_PATTERN_LEN] != ( echo & 0xff ) || in[LINK_PATTERN_LEN + 1] != ( echo >> 8 ) )
+    {
+        return false;
+    }
+
+    port.Write( &ack, 1 );
+    return WaitAck( port, LINK_TEST_MS );
+}
+
+unsigned long LinkNegotiate(SerialPort & port, unsigned long baud, unsigned long maxBaud)
+{
+    bool tried = false;
+
+    for ( unsigned i = 0; i < LadderLen && Ladder[i] > baud; ++i )
+    {
+        if ( Ladder[i] > maxBaud )
+        {
+            continue;
+        }
+        if ( tried && !port.WaitFor( "to start!", PROMPT_MS ) )
+        {
+            break;
+        }
+        if ( TryRate( port, Ladder[i] ) )
+        {
+            return Ladder[i];
+        }
+
+            // The sketch falls back LINK_TEST_MS after the last byte at
+            // the latest, its prompt may have gone by meanwhile
+        tried = true;
+        usleep( ( LINK_TEST_MS + 200 ) * 1000 );
+        port.SetBaud( baud );
+        port.Discard();
+        port.Write( "U", 1 );
+    }
+    return baud;
+}
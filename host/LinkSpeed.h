@@ -0,0 +1,59 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+/*
+ * Host side of the sketch's serial link speed negotiation (LinkSpeed.h).
+ */
+#ifndef ARDUPIC32_LINK_SPEED_H
+#define ARDUPIC32_LINK_SPEED_H
+
+#include "SerialPort.h"
+
+enum {
+    LINK_BASE_BAUD   = 1200,
+    LINK_ATTACH_MS   = 5000,    // bootloader plus the sketch's LINK_SYNC_MS
+    LINK_TEST_MS     = 1000,
+    LINK_PATTERN_LEN = 32,
+    LINK_SYNC        = 'U',
+    LINK_ACK         = 0x06,
+    LINK_NAK         = 0x15
+};
+
+    // Right after Open() at LINK_BASE_BAUD, which resets the station.
+    // Answers a station that comes up at a remembered rate, or stops
+    // once it hears the banner at LINK_BASE_BAUD. Leaves the port at
+    // the station's rate and returns it, the prompt still to come.
+unsigned long LinkAttach(SerialPort & port, int timeoutMs = LINK_ATTACH_MS);
+
+    // At the start prompt: 'L' for each rate from maxBaud down to just
+    // above 'baud', until one passes. Returns the rate in use after. The
+    // station prints its prompt again at that rate.
+unsigned long LinkNegotiate(SerialPort & port, unsigned long baud, unsigned long maxBaud);
+
+#endif
@@ -0,0 +1,299 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+
+#include "Packer.h"
+
+#include <util/crc16.h>
+
+    // As in PackedImage.h, which is not host buildable on its own
+enum {
+    PACK_VERSION = 2,
+    PACK_WINDOW  = 128,
+    PACK_BLOCK   = 128
+};
+
+    // Offset of the end of the block that 'i' (segment offset) is in
+static size_t BlockEnd(uint32_t addr, size_t i, size_t n)
+{
+    size_t end = ( ( addr + i ) / PACK_BLOCK + 1 ) * PACK_BLOCK - addr;
+    return end < n ? end : n;
+}
+
+static void PutLE(std::vector<uint8_t> & out, uint32_t v, int bytes)
+{
+    while ( bytes-- )
+    {
+        out.push_back( v & 0xff );
+        v >>= 8;
+    }
+}
+
+void Packer::Literals(const uint8_t * data, size_t len)
+{
+    while ( len )
+    {
+        size_t n = len < 128 ? len : 128;
+        out_.push_back( n - 1 );
+        out_.insert( out_.end(), data, data + n );
+        data += n;
+        len  -= n;
+    }
+}
+
+    // Tokens for d[i, end), matches may reach back before i
+void Packer::Block(const std::vector<uint8_t> & d, size_t i, size_t end)
+{
+    size_t lit = i;
+
+    while ( i < end )
+    {
+        size_t run = 0, match = 0, offset = 0;
+
+        if ( d[i] == 0xff || d[i] == 0x00 )
+        {
+            while ( i + run < end && d[i + run] == d[i] )
+            {
+                ++run;
+            }
+        }
+
+            // Greedy longest match, the window is small enough to search
+        for ( size_t o = 1; o <= PACK_WINDOW && o <= i; ++o )
+        {
+            size_t l = 0;
+            while ( l < 66 && i + l < end && d[i + l] == d[i + l - o] )
+            {
+                ++l;
+            }
+            if ( l > match )
+            {
+                match  = l;
+                offset = o;
+            }
+        }
+
+        size_t runGain   = run >= 2 ? run - ( run < 32 ? 1 : 3 ) : 0;
+        size_t matchGain = match >= 3 ? match - 2 : 0;
+
+        if ( !runGain && !matchGain )
+        {
+            ++i;
+            continue;
+        }
+
+        Literals( &d[lit], i - lit );
+
+        if ( runGain >= matchGain )
+        {
+            uint8_t fill = d[i] ? 0x00 : 0x20;
+            if ( run < 32 )
+            {
+                out_.push_back( 0x80 | fill | ( run - 1 ) );
+            }
+            else
+            {
+                out_.push_back( 0x80 | fill | 0x1f );
+                PutLE( out_, run - 32, 2 );
+            }
+            i += run;
+        }
+        else
+        {
+            out_.push_back( 0xc0 | ( match - 3 ) );
+            out_.push_back( offset - 1 );
+            i += match;
+        }
+        lit = i;
+    }
+    Literals( &d[lit], i - lit );
+}
+
+    // Each block is followed by its CRC, which the sketch checks before
+    // it programs the rows the block finished
+void Packer::Segment(uint32_t addr, const std::vector<uint8_t> & d)
+{
+    const size_t n = d.size();
+
+    out_.push_back( 'S' );
+    PutLE( out_, addr, 4 );
+    PutLE( out_, n, 4 );
+
+    for ( size_t i = 0, end; i < n; i = end )
+    {
+        uint16_t crc = 0xffff;
+
+        end = BlockEnd( addr, i, n );
+        Block( d, i, end );
+        for ( size_t k = i; k < end; ++k )
+        {
+            crc = _crc_ccitt_update( crc, d[k] );
+        }
+        PutLE( out_, crc, 2 );
+    }
+    ++segments_;
+}
+
+Packer::Packer(const IntelHex & hex, uint32_t mergeGap):
+    segments_(0)
+{
+    const IntelHex::Extents & ext = hex.Data();
+    IntelHex::Extents::const_iterator it = ext.begin();
+
+    out_.push_back( 'Z' );
+    out_.push_back( 'P' );
+    out_.push_back( PACK_VERSION );
+
+    while ( it != ext.end() )
+    {
+        uint32_t start = it->first & ~3u;
+        uint32_t end   = it->first + it->second.size();
+        IntelHex::Extents::const_iterator last = it;
+
+        while ( ++last != ext.end() && ( last->first & ~3u ) <= end + mergeGap )
+        {
+            end = last->first + last->second.size();
+        }
+        end = ( end + 3 ) & ~3u;
+
+        std::vector<uint8_t> seg( end - start, 0xff );
+        for ( ; it != last; ++it )
+        {
+            std::copy( it->second.begin(), it->second.end(), seg.begin() + ( it->first - start ) );
+        }
+        Segment( start, seg );
+    }
+
+    out_.push_back( 'E' );
+}
+
+bool Packer::Unpack(const std::vector<uint8_t> & in, IntelHex::Extents & image, std::string & error)
+{
+    size_t p = 0;
+
+    auto get = [&](int bytes) -> uint32_t
+    {
+        uint32_t v = 0;
+        for ( int b = 0; b < bytes; ++b )
+        {
+            if ( p >= in.size() )
+            {
+                throw std::string( "truncated" );
+            }
+            v |= (uint32_t)in[p++] << ( 8 * b );
+        }
+        return v;
+    };
+
+    image.clear();
+    try
+    {
+        if ( get( 1 ) != 'Z' || get( 1 ) != 'P' || get( 1 ) != PACK_VERSION )
+        {
+            throw std::string( "bad header" );
+        }
+
+        for ( ;; )
+        {
+            uint32_t tag = get( 1 );
+            if ( tag == 'E' )
+            {
+                return true;
+            }
+            if ( tag != 'S' )
+            {
+                throw std::string( "bad segment tag" );
+            }
+
+            uint32_t addr = get( 4 ), len = get( 4 );
+            std::vector<uint8_t> & d = image[addr];
+
+            for ( size_t start = 0, end; start < len; start = end )
+            {
+                uint16_t crc = 0xffff;
+
+                end = BlockEnd( addr, start, len );
+                while ( d.size() < end )
+                {
+                    uint32_t token = get( 1 ), n;
+
+                    if ( !( token & 0x80 ) )
+                    {
+                        for ( n = token + 1; n--; )
+                        {
+                            d.push_back( get( 1 ) );
+                        }
+                    }
+                    else if ( !( token & 0x40 ) )
+                    {
+                        n = ( token & 0x1f ) + 1;
+                        if ( n == 32 )
+                        {
+                            n += get( 2 );
+                        }
+                        d.insert( d.end(), n, ( token & 0x20 ) ? 0x00 : 0xff );
+                    }
+                    else
+                    {
+                        uint32_t o = get( 1 ) + 1;
+                        if ( o > PACK_WINDOW )
+                        {
+                            throw std::string( "match offset outside the window" );
+                        }
+                        if ( o > d.size() )
+                        {
+                            throw std::string( "match before segment start" );
+                        }
+                        for ( n = ( token & 0x3f ) + 3; n--; )
+                        {
+                            d.push_back( d[d.size() - o] );
+                        }
+                    }
+                }
+                if ( d.size() != end )
+                {
+                    throw std::string( "token overruns block" );
+                }
+                for ( size_t k = start; k < end; ++k )
+                {
+                    crc = _crc_ccitt_update( crc, d[k] );
+                }
+                if ( get( 2 ) != crc )
+                {
+                    throw std::string( "block CRC mismatch" );
+                }
+            }
+        }
+    }
+    catch ( const std::string & e )
+    {
+        error = e;
+        return false;
+    }
+}
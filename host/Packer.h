@@ -0,0 +1,67 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+
+/*
+ * Encoder for the sketch's packed image format (PackedImage.h), and a
+ * decoder used to check the encoder's output before it is sent.
+ */
+#ifndef ARDUPIC32_PACKER_H
+#define ARDUPIC32_PACKER_H
+
+#include "IntelHex.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+class Packer
+{
+private:
+    std::vector<uint8_t> out_;
+    unsigned             segments_;
+
+    void Literals(const uint8_t * data, size_t len);
+    void Block(const std::vector<uint8_t> & data, size_t i, size_t end);
+    void Segment(uint32_t addr, const std::vector<uint8_t> & data);
+
+public:
+        // Extents closer than 'mergeGap' bytes are sent as one segment
+        // with the hole 0xFF filled
+    explicit Packer(const IntelHex & hex, uint32_t mergeGap = 64);
+
+    const std::vector<uint8_t> & Data() const { return out_; }
+    unsigned Segments() const { return segments_; }
+
+        // Unpacks a stream into extents, false with 'error' if malformed
+    static bool Unpack(const std::vector<uint8_t> & packed,
+                       IntelHex::Extents & image, std::string & error);
+};
+
+#endif
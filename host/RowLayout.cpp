@@ -0,0 +1,173 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "RowLayout.h"
+
+#include <stdio.h>
+
+    // As in RowImage.h, which is not host buildable on its own
+enum {
+    ROWS_VERSION = 1
+};
+
+static const uint32_t PFM_BASE = 0x1D000000;
+static const uint32_t BFM_BASE = 0x1FC00000;
+
+static void PutLE(std::vector<uint8_t> & out, uint32_t v, int bytes)
+{
+    while ( bytes-- )
+    {
+        out.push_back( v & 0xff );
+        v >>= 8;
+    }
+}
+
+uint32_t RowLayout::Crc32(uint32_t crc, const uint8_t * data, size_t len)
+{
+    crc = ~crc;
+    while ( len-- )
+    {
+        crc ^= *data++;
+        for ( int n = 0; n < 8; ++n )
+        {
+            crc = ( crc >> 1 ) ^ ( ( crc & 1 ) ? 0xEDB88320u : 0 );
+        }
+    }
+    return ~crc;
+}
+
+RowLayout::RowLayout()
+    : rows_( 0 ),
+      blank_( 0 ),
+      rowBytes_( 0 )
+{
+}
+
+void RowLayout::Region(uint32_t base, const std::vector<uint8_t> & flat)
+{
+    unsigned count = flat.size() / rowBytes_;
+    std::vector<bool> used( count );
+    unsigned last = 0;
+
+    for ( unsigned r = 0; r < count; ++r )
+    {
+        for ( unsigned i = 0; i < rowBytes_ && !used[r]; ++i )
+        {
+            used[r] = flat[r * rowBytes_ + i] != 0xff;
+        }
+        if ( used[r] )
+        {
+            last = r + 1;
+        }
+    }
+    if ( !last )
+    {
+        return;
+    }
+
+    out_.push_back( 'G' );
+    PutLE( out_, base, 4 );
+    PutLE( out_, last, 2 );
+
+    for ( unsigned r = 0; r < last; ++r )
+    {
+        if ( ( r & 7 ) == 0 )
+        {
+            uint8_t map = 0;
+            for ( unsigned n = 0; n < 8 && r + n < last; ++n )
+            {
+                map |= used[r + n] << n;
+            }
+            out_.push_back( map );
+        }
+        if ( !used[r] )
+        {
+            ++blank_;
+            continue;
+        }
+
+        uint32_t addr = base + r * rowBytes_;
+        uint8_t  le[4] = { uint8_t( addr ), uint8_t( addr >> 8 ), uint8_t( addr >> 16 ), uint8_t( addr >> 24 ) };
+        const uint8_t * row = &flat[r * rowBytes_];
+
+        out_.insert( out_.end(), row, row + rowBytes_ );
+        PutLE( out_, Crc32( Crc32( 0, le, 4 ), row, rowBytes_ ), 4 );
+        ++rows_;
+    }
+}
+
+bool RowLayout::Build(const IntelHex & hex, const RowGeometry & geo, std::string & error)
+{
+    std::vector<uint8_t> pfm( geo.PfmKB * 1024, 0xff ), bfm( geo.BfmKB * 1024, 0xff );
+
+    out_.clear();
+    rows_     = 0;
+    blank_    = 0;
+    rowBytes_ = geo.RowBytes;
+
+    for ( IntelHex::Extents::const_iterator it = hex.Data().begin(); it != hex.Data().end(); ++it )
+    {
+        for ( size_t k = 0; k < it->second.size(); ++k )
+        {
+                // KSEG0/KSEG1 addresses are taken as physical
+            uint32_t a = ( it->first + k ) & 0x1fffffff;
+
+            if ( a - PFM_BASE < pfm.size() )
+            {
+                pfm[a - PFM_BASE] = it->second[k];
+            }
+            else if ( a - BFM_BASE < bfm.size() )
+            {
+                bfm[a - BFM_BASE] = it->second[k];
+            }
+            else
+            {
+                char text[64];
+                snprintf( text, sizeof(text), "data at 0x%08x is outside flash", it->first + (uint32_t)k );
+                error = text;
+                return false;
+            }
+        }
+    }
+
+    out_.push_back( 'R' );
+    out_.push_back( 'I' );
+    out_.push_back( ROWS_VERSION );
+    PutLE( out_, geo.DevID, 4 );
+    PutLE( out_, geo.RowBytes, 2 );
+    PutLE( out_, geo.PfmKB, 2 );
+    PutLE( out_, geo.BfmKB, 2 );
+
+        // Boot flash last, it holds the configuration words
+    Region( PFM_BASE, pfm );
+    Region( BFM_BASE, bfm );
+
+    out_.push_back( 'E' );
+    return true;
+}
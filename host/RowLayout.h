@@ -0,0 +1,76 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+/*
+ * Encoder for the sketch's row image format (RowImage.h): the image is
+ * cut into the target device's rows and the blank ones are left out.
+ */
+#ifndef ARDUPIC32_ROW_LAYOUT_H
+#define ARDUPIC32_ROW_LAYOUT_H
+
+#include "IntelHex.h"
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+struct RowGeometry
+{
+    uint32_t DevID;     // without the revision nibble
+    unsigned RowBytes;
+    unsigned PfmKB;
+    unsigned BfmKB;
+};
+
+class RowLayout
+{
+private:
+    std::vector<uint8_t> out_;
+    unsigned             rows_;
+    unsigned             blank_;
+    unsigned             rowBytes_;
+
+    void Region(uint32_t base, const std::vector<uint8_t> & flat);
+
+public:
+    RowLayout();
+
+        // False with 'error' if image data falls outside the device's
+        // boot or program flash
+    bool Build(const IntelHex & hex, const RowGeometry & geo, std::string & error);
+
+    const std::vector<uint8_t> & Data() const { return out_; }
+    unsigned Rows() const      { return rows_; }
+    unsigned BlankRows() const { return blank_; }
+
+        // zlib CRC-32, start with 0 and feed the previous result back
+    static uint32_t Crc32(uint32_t crc, const uint8_t * data, size_t len);
+};
+
+#endif
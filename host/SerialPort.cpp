@@ -0,0 +1,203 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "SerialPort.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <termios.h>
+#include <unistd.h>
+
+static speed_t BaudToSpeed(unsigned long baud)
+{
+    switch ( baud )
+    {
+        case 1200:    return B1200;
+        case 2400:    return B2400;
+        case 4800:    return B4800;
+        case 9600:    return B9600;
+        case 19200:   return B19200;
+        case 38400:   return B38400;
+        case 57600:   return B57600;
+        case 115200:  return B115200;
+        case 230400:  return B230400;
+        case 460800:  return B460800;
+        case 500000:  return B500000;
+        case 921600:  return B921600;
+        case 1000000: return B1000000;
+        default:      return 0;
+    }
+}
+
+SerialPort::SerialPort()
+    : fd_( -1 )
+{
+}
+
+SerialPort::~SerialPort()
+{
+    Close();
+}
+
+bool SerialPort::Open(const std::string & path, unsigned long baud)
+{
+    Close();
+
+    fd_ = ::open( path.c_str(), O_RDWR | O_NOCTTY | O_CLOEXEC );
+    if ( fd_ < 0 )
+    {
+        return false;
+    }
+    path_ = path;
+
+    if ( !SetBaud( baud ) )
+    {
+        Close();
+        return false;
+    }
+    return true;
+}
+
+void SerialPort::Close()
+{
+    if ( fd_ >= 0 )
+    {
+        ::close( fd_ );
+        fd_ = -1;
+    }
+}
+
+bool SerialPort::SetBaud(unsigned long baud)
+{
+    struct termios tio;
+    speed_t speed = BaudToSpeed( baud );
+
+    if ( !speed || tcgetattr( fd_, &tio ) != 0 )
+    {
+        return false;
+    }
+
+    cfmakeraw( &tio );
+    tio.c_cflag |= CLOCAL | CREAD;
+    tio.c_cflag &= ~CRTSCTS;
+    tio.c_cc[VMIN]  = 0;
+    tio.c_cc[VTIME] = 0;
+    cfsetispeed( &tio, speed );
+    cfsetospeed( &tio, speed );
+
+    return tcsetattr( fd_, TCSANOW, &tio ) == 0;
+}
+
+bool SerialPort::Write(const void * buf, size_t len)
+{
+    const uint8_t * p = static_cast<const uint8_t *>(buf);
+
+    while ( len )
+    {
+        ssize_t n = ::write( fd_, p, len );
+        if ( n < 0 )
+        {
+            if ( errno == EINTR || errno == EAGAIN )
+            {
+                continue;
+            }
+            return false;
+        }
+        p   += n;
+        len -= n;
+    }
+    return true;
+}
+
+long SerialPort::Read(void * buf, size_t len, int timeoutMs)
+{
+    uint8_t * p = static_cast<uint8_t *>(buf);
+    size_t got = 0;
+
+    while ( got < len )
+    {
+        struct pollfd pfd = { fd_, POLLIN, 0 };
+        int r = ::poll( &pfd, 1, timeoutMs );
+        if ( r < 0 )
+        {
+            if ( errno == EINTR )
+            {
+                continue;
+            }
+            return -1;
+        }
+        if ( r == 0 )
+        {
+            break;
+        }
+
+        ssize_t n = ::read( fd_, p + got, len - got );
+        if ( n < 0 )
+        {
+            if ( errno == EINTR || errno == EAGAIN )
+            {
+                continue;
+            }
+            return -1;
+        }
+        got += n;
+    }
+    return (long)got;
+}
+
+bool SerialPort::WaitFor(const char * pattern, int timeoutMs, std::string * seen)
+{
+    std::string buf;
+    char c;
+
+    while ( Read( &c, 1, timeoutMs ) == 1 )
+    {
+        buf += c;
+        if ( seen )
+        {
+            *seen += c;
+        }
+        if ( buf.find( pattern ) != std::string::npos )
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+void SerialPort::Discard()
+{
+    tcflush( fd_, TCIFLUSH );
+}
+
+void SerialPort::Drain()
+{
+    tcdrain( fd_ );
+}
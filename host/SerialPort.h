@@ -0,0 +1,74 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+/*
+ * Raw termios serial port, 8N1, no flow control.
+ */
+#ifndef ARDUPIC32_SERIAL_PORT_H
+#define ARDUPIC32_SERIAL_PORT_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+class SerialPort
+{
+private:
+    int         fd_;
+    std::string path_;
+
+public:
+    SerialPort();
+    ~SerialPort();
+
+    bool Open(const std::string & path, unsigned long baud);
+    void Close();
+    bool SetBaud(unsigned long baud);
+    bool IsOpen() const { return fd_ >= 0; }
+    int  Fd() const     { return fd_; }
+    const std::string & Path() const { return path_; }
+
+        // Returns false on error, blocks until everything is written
+    bool Write(const void * buf, size_t len);
+
+        // Returns the number of bytes read before timeout, -1 on error
+    long Read(void * buf, size_t len, int timeoutMs);
+
+        // Reads until 'pattern' has been seen or timeout. The text read
+        // is appended to 'seen' if given.
+    bool WaitFor(const char * pattern, int timeoutMs, std::string * seen = 0);
+
+        // Throws away anything pending in the receive direction
+    void Discard();
+
+        // Waits for the transmit queue to drain
+    void Drain();
+};
+
+#endif
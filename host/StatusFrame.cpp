@@ -0,0 +1,84 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+
+#include "StatusFrame.h"
+
+static bool Hex(const char * p, int digits, uint32_t & value)
+{
+    value = 0;
+    while ( digits-- )
+    {
+        char c = *p++;
+        if ( c >= '0' && c <= '9' )      value = value << 4 | ( c - '0' );
+        else if ( c >= 'A' && c <= 'F' ) value = value << 4 | ( c - 'A' + 10 );
+        else return false;
+    }
+    return true;
+}
+
+static uint8_t Xor(uint32_t v)
+{
+    return v ^ ( v >> 8 ) ^ ( v >> 16 ) ^ ( v >> 24 );
+}
+
+const char * StatusFrame::PhaseName() const
+{
+    static const char * const names[] = { "idle", "program", "verify", "dry run", "done", "FAIL" };
+    return Phase < sizeof(names) / sizeof(names[0]) ? names[Phase] : "?";
+}
+
+std::vector<StatusFrame> ParseStatusFrames(const std::string & text)
+{
+    std::vector<StatusFrame> frames;
+
+    for ( size_t i = 0; i + STATUS_FRAME_LEN <= text.size(); ++i )
+    {
+        const char * p = text.data() + i;
+        uint32_t phase, error, x;
+        StatusFrame f;
+
+        if ( p[0] != '!' || p[STATUS_FRAME_LEN - 1] != '\n'
+             || !Hex( p + 1, 1, phase ) || !Hex( p + 2, 2, error )
+             || !Hex( p + 4, 8, f.Addr ) || !Hex( p + 12, 8, f.Done )
+             || !Hex( p + 20, 2, x ) )
+        {
+            continue;
+        }
+        if ( ( ( phase ^ error ^ Xor( f.Addr ) ^ Xor( f.Done ) ) & 0xff ) != x )
+        {
+            continue;
+        }
+        f.Phase = phase;
+        f.Error = error;
+        frames.push_back( f );
+        i += STATUS_FRAME_LEN - 1;
+    }
+    return frames;
+}
@@ -0,0 +1,260 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+#include "XsvfWriter.h"
+
+#include <stdexcept>
+
+enum {
+    XCOMPLETE = 0x00,
+    XTDOMASK  = 0x01,
+    XSIR      = 0x02,
+    XSDR      = 0x03,
+    XRUNTEST  = 0x04,
+    XREPEAT   = 0x07,
+    XSDRSIZE  = 0x08,
+    XSDRTDO   = 0x09,
+    XSTATE    = 0x12,
+    XWAIT     = 0x17,
+    XPIC_MCLR = 0x80,
+
+    XSVF_TLR  = 0x00,
+    XSVF_RTI  = 0x01,
+
+    XSVF_MAX_BITS = 64
+};
+
+XsvfWriter::XsvfWriter()
+    : sdrBits_( ~0u ),
+      mask_( 0 ),
+      maskValid_( false ),
+      repeat_( 32 ),
+      runTest_( 0 ),
+      pollRepeat_( 32 )
+{
+    HostDelayHook    = DelayHook;
+    HostDelayHookCtx = this;
+}
+
+XsvfWriter::~XsvfWriter()
+{
+    if ( HostDelayHookCtx == this )
+    {
+        HostDelayHook    = 0;
+        HostDelayHookCtx = 0;
+    }
+}
+
+void XsvfWriter::DelayHook(void * ctx, unsigned long ms)
+{
+    static_cast<XsvfWriter *>(ctx)->Wait( ms * 1000 );
+}
+
+void XsvfWriter::Long(uint32_t v)
+{
+    Byte( v >> 24 );
+    Byte( v >> 16 );
+    Byte( v >> 8 );
+    Byte( v );
+}
+
+    // XSVF vectors are sent most significant byte first
+void XsvfWriter::Vector(uint64_t v, unsigned bits)
+{
+    for ( int i = (bits + 7) / 8 - 1; i >= 0; --i )
+    {
+        Byte( v >> ( 8 * i ) );
+    }
+}
+
+void XsvfWriter::SdrSize(unsigned bits)
+{
+    if ( bits > XSVF_MAX_BITS )
+    {
+        throw std::runtime_error( "xsvf: scan longer than the player supports" );
+    }
+    if ( bits != sdrBits_ )
+    {
+        Byte( XSDRSIZE );
+        Long( bits );
+        sdrBits_   = bits;
+        maskValid_ = false;
+    }
+}
+
+void XsvfWriter::Mask(uint64_t mask, unsigned bits)
+{
+    if ( !maskValid_ || mask != mask_ )
+    {
+        Byte( XTDOMASK );
+        Vector( mask, bits );
+        mask_      = mask;
+        maskValid_ = true;
+    }
+}
+
+void XsvfWriter::Repeat(uint8_t n)
+{
+    if ( n != repeat_ )
+    {
+        Byte( XREPEAT );
+        Byte( n );
+        repeat_ = n;
+    }
+}
+
+void XsvfWriter::RunTest(uint32_t us)
+{
+    if ( us != runTest_ )
+    {
+        Byte( XRUNTEST );
+        Long( us );
+        runTest_ = us;
+    }
+}
+
+void XsvfWriter::ExpectNext(uint32_t value, uint32_t mask, uint8_t repeat, uint32_t runTestUs)
+{
+    Expect e = { value, mask, repeat, runTestUs };
+    expect_.push_back( e );
+}
+
+uint32_t XsvfWriter::Sdr(unsigned bits, uint64_t tdi, bool lead)
+{
+    Expect e = { 0, 0, 0, 0 };
+    unsigned total = bits + lead;
+
+    if ( !expect_.empty() )
+    {
+        e = expect_.front();
+        expect_.pop_front();
+    }
+
+    SdrSize( total );
+    RunTest( e.runTestUs );
+    if ( e.mask )
+    {
+        Repeat( e.repeat );
+    }
+    Mask( (uint64_t)e.mask << lead, total );
+
+    if ( e.mask )
+    {
+        Byte( XSDRTDO );
+        Vector( tdi << lead, total );
+        Vector( (uint64_t)e.value << lead, total );
+    }
+    else
+    {
+        Byte( XSDR );
+        Vector( tdi << lead, total );
+    }
+    return e.value;
+}
+
+void XsvfWriter::Wait(uint32_t us)
+{
+    Byte( XWAIT );
+    Byte( XSVF_RTI );
+    Byte( XSVF_RTI );
+    Long( us );
+}
+
+void XsvfWriter::Complete()
+{
+    Byte( XCOMPLETE );
+}
+
+void XsvfWriter::SetMCLR(bool level)
+{
+    Byte( XPIC_MCLR );
+    Byte( level );
+}
+
+    // Only the reset sequences Pic32JTAG uses can be expressed in XSVF
+uint32_t XsvfWriter::ShiftTMS(unsigned char bits, uint32_t tms)
+{
+    if ( bits < 5 || ( tms & 0x1f ) != 0x1f || ( bits > 6 ) ||
+         ( bits == 6 && ( tms & 0x20 ) ) )
+    {
+        throw std::runtime_error( "xsvf: unsupported TMS sequence" );
+    }
+
+    Byte( XSTATE );
+    Byte( XSVF_TLR );
+    if ( bits == 6 )
+    {
+        Byte( XSTATE );
+        Byte( XSVF_RTI );
+    }
+    return 0;
+}
+
+uint32_t XsvfWriter::ScanIR(unsigned char bits, uint32_t tdi)
+{
+    Byte( XSIR );
+    Byte( bits );
+    Vector( tdi, bits );
+    return 0;
+}
+
+uint32_t XsvfWriter::ScanDR(unsigned char bits, uint32_t tdi)
+{
+    return Sdr( bits, tdi, false );
+}
+
+uint32_t XsvfWriter::ScanDR(unsigned char bits, uint32_t tdi, bool & lead)
+{
+    lead = true;
+    return Sdr( bits, tdi, true );
+}
+
+void XsvfWriter::WriteDR(unsigned char bits, uint32_t tdi)
+{
+    SdrSize( bits );
+    RunTest( 0 );
+    Mask( 0, bits );
+    Byte( XSDR );
+    Vector( tdi, bits );
+}
+
+    // Compares all mask bits set, fine for the single PrAcc bit polled
+bool XsvfWriter::PollDR(unsigned char bits, uint32_t tdi, uint32_t mask, uint16_t tries)
+{
+    (void)tries;
+
+    SdrSize( bits );
+    RunTest( 0 );
+    Repeat( pollRepeat_ );
+    Mask( mask, bits );
+    Byte( XSDRTDO );
+    Vector( tdi, bits );
+    Vector( mask, bits );
+    return true;
+}
@@ -0,0 +1,106 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+/*
+ * JTAGBackend that records the scans as an XSVF stream for the sketch's
+ * XsvfPlayer.h instead of executing them.
+ *
+ * Scans returning data have no target to ask, so the generator states
+ * what it expects before each such scan with ExpectNext(). The value is
+ * returned to the calling Pic32JTAGDevice code and the compare (with
+ * retries) is left to the player.
+ */
+#ifndef ARDUPIC32_XSVF_WRITER_H
+#define ARDUPIC32_XSVF_WRITER_H
+
+#include "HostJTAG.h"
+
+#include <deque>
+#include <vector>
+
+class XsvfWriter: public JTAGBackend
+{
+private:
+    struct Expect
+    {
+        uint32_t value;
+        uint32_t mask;
+        uint8_t  repeat;
+        uint32_t runTestUs;
+    };
+
+    std::vector<uint8_t> out_;
+    std::deque<Expect>   expect_;
+
+    uint32_t sdrBits_;
+    uint64_t mask_;
+    bool     maskValid_;
+    uint8_t  repeat_;
+    uint32_t runTest_;
+    uint8_t  pollRepeat_;
+
+    void Byte(uint8_t b)      { out_.push_back( b ); }
+    void Long(uint32_t v);
+    void Vector(uint64_t v, unsigned bits);
+
+    void SdrSize(unsigned bits);
+    void Mask(uint64_t mask, unsigned bits);
+    void Repeat(uint8_t n);
+    void RunTest(uint32_t us);
+
+    uint32_t Sdr(unsigned bits, uint64_t tdi, bool lead);
+
+    static void DelayHook(void * ctx, unsigned long ms);
+
+public:
+    XsvfWriter();
+    ~XsvfWriter();
+
+        // Expectation for the next scan returning data. A zero mask
+        // means "don't care".
+    void ExpectNext(uint32_t value, uint32_t mask, uint8_t repeat = 0, uint32_t runTestUs = 0);
+
+        // Retries allowed for PrAcc polls
+    void SetPollRepeat(uint8_t n) { pollRepeat_ = n; }
+
+    void Wait(uint32_t us);
+    void Complete();
+
+    const std::vector<uint8_t> & Data() const { return out_; }
+
+    void     SetMCLR(bool level) override;
+    uint32_t ShiftTMS(unsigned char bits, uint32_t tms) override;
+    uint32_t ScanIR(unsigned char bits, uint32_t tdi) override;
+    uint32_t ScanDR(unsigned char bits, uint32_t tdi) override;
+    uint32_t ScanDR(unsigned char bits, uint32_t tdi, bool & lead) override;
+    void     WriteDR(unsigned char bits, uint32_t tdi) override;
+    bool     PollDR(unsigned char bits, uint32_t tdi, uint32_t mask, uint16_t tries) override;
+};
+
+#endif
@@ -0,0 +1,182 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+/*
+ * Minimal Arduino core for building the ArduPIC32 headers on a Linux
+ * host. Only what the sketch headers use is provided. Serial output
+ * goes to stdout and there is no Serial input, unless a tool puts a
+ * link of its own behind Serial (HostSerialHook, see host/linksim.cpp).
+ */
+#ifndef ARDUPIC32_HOST_ARDUINO_H
+#define ARDUPIC32_HOST_ARDUINO_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h>
+
+typedef uint8_t byte;
+typedef bool    boolean;
+
+#define PROGMEM
+#define HEX 16
+#define DEC 10
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper *>(s))
+
+#define memcpy_P          memcpy
+#define pgm_read_byte(p)  (*(const uint8_t  *)(p))
+#define pgm_read_word(p)  (*(const uint16_t *)(p))
+#define pgm_read_dword(p) (*(const uint32_t *)(p))
+#define pgm_read_ptr(p)   (*(const void * const *)(p))
+#define strcmp_P          strcmp
+#define PSTR(s)           (s)
+
+    // Lets a JTAG backend keep delay() ordered with its queued scans
+typedef void (*HostDelayHook_t)(void *ctx, unsigned long ms);
+inline thread_local HostDelayHook_t HostDelayHook    = 0;
+inline thread_local void           *HostDelayHookCtx = 0;
+
+    // Lets a simulation run the sketch code on a clock of its own
+typedef unsigned long (*HostClockHook_t)(void *ctx);
+inline thread_local HostClockHook_t HostClockHook    = 0;
+inline thread_local void           *HostClockHookCtx = 0;
+
+inline unsigned long micros()
+{
+    if ( HostClockHook )
+    {
+        return HostClockHook( HostClockHookCtx );
+    }
+
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long)(ts.tv_sec * 1000000ull + ts.tv_nsec / 1000);
+}
+
+inline unsigned long millis()
+{
+    return micros() / 1000;
+}
+
+inline void delay(unsigned long ms)
+{
+    if ( HostDelayHook )
+    {
+        HostDelayHook( HostDelayHookCtx, ms );
+    }
+    else
+    {
+        usleep( ms * 1000 );
+    }
+}
+
+inline void delayMicroseconds(unsigned int us)
+{
+    usleep( us );
+}
+
+    // Serial port seen by the sketch code
+class HostSerialLink
+{
+public:
+    virtual ~HostSerialLink() {}
+
+    virtual int    Available() = 0;
+    virtual int    Read() = 0;
+    virtual int    AvailableForWrite() = 0;
+    virtual size_t Write(const uint8_t *buf, size_t len) = 0;
+};
+
+inline thread_local HostSerialLink *HostSerialHook = 0;
+
+class HostSerial
+{
+private:
+    size_t PrintNumber(unsigned long long n, int base)
+    {
+        char buf[66];
+        char *p = &buf[sizeof(buf) - 1];
+        *p = 0;
+        do
+        {
+            unsigned d = n % base;
+            *--p = d < 10 ? '0' + d : 'A' + d - 10;
+            n /= base;
+        } while ( n );
+        return print( p );
+    }
+
+public:
+    int  available()        { return HostSerialHook ? HostSerialHook->Available() : 0; }
+    int  read()             { return HostSerialHook ? HostSerialHook->Read() : -1; }
+    int  availableForWrite(){ return HostSerialHook ? HostSerialHook->AvailableForWrite() : 64; }
+    void flush()            { fflush( stdout ); }
+
+    size_t write(uint8_t c)
+    {
+        return write( &c, 1 );
+    }
+    size_t write(const uint8_t *buf, size_t len)
+    {
+        if ( HostSerialHook )
+        {
+            return HostSerialHook->Write( buf, len );
+        }
+        return fwrite( buf, 1, len, stdout );
+    }
+
+    size_t print(const char *s)                { return write( (const uint8_t *)s, strlen( s ) ); }
+    size_t print(const __FlashStringHelper *s) { return print( reinterpret_cast<const char *>(s) ); }
+    size_t print(char c)                       { return write( c ); }
+
+    size_t print(unsigned long long n, int base = DEC) { return PrintNumber( n, base ); }
+    size_t print(unsigned long n, int base = DEC)      { return PrintNumber( n, base ); }
+    size_t print(unsigned int n, int base = DEC)       { return PrintNumber( n, base ); }
+    size_t print(unsigned char n, int base = DEC)      { return PrintNumber( n, base ); }
+    size_t print(long n, int base = DEC)
+    {
+        if ( base == DEC && n < 0 )
+        {
+            return write( '-' ) + PrintNumber( -(long long)n, DEC );
+        }
+        return PrintNumber( (unsigned long)n, base );
+    }
+    size_t print(int n, int base = DEC)                { return print( (long)n, base ); }
+
+    size_t println()                                   { return write( '\n' ); }
+    template <typename T> size_t println(T v)          { return print( v ) + println(); }
+    template <typename T> size_t println(T v, int b)   { return print( v, b ) + println(); }
+};
+
+inline HostSerial Serial;
+
+#endif
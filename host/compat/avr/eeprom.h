@@ -0,0 +1,76 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+/*
+ * AVR EEPROM in host RAM, erased (0xFF) at start, gone at exit.
+ */
+#ifndef ARDUPIC32_HOST_EEPROM_H
+#define ARDUPIC32_HOST_EEPROM_H
+
+#include <stdint.h>
+#include <string.h>
+
+#define E2END 0x1FF
+
+struct HostEEPROM_t
+{
+    uint8_t Data[E2END + 1];
+
+    HostEEPROM_t() { memset( Data, 0xff, sizeof(Data) ); }
+};
+
+inline HostEEPROM_t HostEEPROM;
+
+inline uint8_t eeprom_read_byte(const uint8_t *p)
+{
+    return HostEEPROM.Data[(uintptr_t)p & E2END];
+}
+
+inline void eeprom_update_byte(uint8_t *p, uint8_t value)
+{
+    HostEEPROM.Data[(uintptr_t)p & E2END] = value;
+}
+
+inline void eeprom_read_block(void *dst, const void *src, size_t len)
+{
+    for ( size_t i = 0; i < len; ++i )
+    {
+        ((uint8_t *)dst)[i] = eeprom_read_byte( (const uint8_t *)src + i );
+    }
+}
+
+inline void eeprom_update_block(const void *src, void *dst, size_t len)
+{
+    for ( size_t i = 0; i < len; ++i )
+    {
+        eeprom_update_byte( (uint8_t *)dst + i, ((const uint8_t *)src)[i] );
+    }
+}
+
+#endif
@@ -0,0 +1,625 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+/*
+ * linksim: runs the sketch's own image loaders (HexPgm, PackedPgm,
+ * RowPgm) against a simulated serial link and a simulated target, on a
+ * virtual clock, to compare the upload modes for a given link.
+ *
+ *   linksim -t <device> [-b baud] [-l latency_us] [-r rx_buffer]
+ *           [-d drop_rate] [-e bit_error_rate] [-k tck_ns] [-c byte_us]
+ *           [-s seed] [-q] [-F] [-p poll] [-m paste,packed,rows] file.hex
+ *
+ * The link is 8N1 at -b baud in both directions. Each host write, and
+ * each byte to the host, is delayed by -l (USB-serial latency). The
+ * sketch's RX buffer holds -r bytes, anything arriving while it is full
+ * is lost (overrun). -d and -e are per byte probabilities of losing a
+ * byte or flipping one of its bits on the wire, both directions.
+ *
+ * The target answers like a healthy part, and every scan costs its bit
+ * count (plus the TAP moves) at -k ns per TCK; take it from the
+ * station's 'k' calibration. -c is the sketch's time per received byte.
+ * Images are programmed without verify, a read-back needs a model of
+ * the flash which the target here does not have.
+ *
+ * The scan/ins column is JTAG scans (IR, DR and PrAcc polls) per CPU
+ * instruction fed over PrAcc. -F turns off the PrAcc handshake fusion,
+ * every instruction selects ETAP_CONTROL again, for a before/after.
+ * -p makes the target miss PrAcc poll number 'poll' (from 1), as a part
+ * that stopped fetching would; the loader has to end with an error.
+ *
+ * Modes, as the host tools send them:
+ *   paste   the HEX file as text, no flow control ('P')
+ *   packed  p32pack stream with XON credits ('z')
+ *   rows    p32rows image with XON credits ('w')
+ *
+ * A run ends when the loader returns, or as "stalled" once the sketch
+ * waits for data that can no longer come (the host side has given up
+ * or has nothing left to send).
+ */
+#include "HostJTAG.h"
+#include "IntelHex.h"
+#include "Packer.h"
+#include "RowLayout.h"
+
+#include "MySerial.h"
+#include "PackedImage.h"
+#include "RowImage.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <deque>
+#include <fstream>
+#include <random>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+static const uint64_t NEVER = ~0ull;
+static const uint64_t MS    = 1000000ull;   // virtual time is in ns
+
+struct LinkConfig
+{
+    unsigned long Baud        = 1200;
+    unsigned long LatencyUs   = 0;
+    unsigned      RxBuffer    = 64;
+    unsigned      TxBuffer    = 64;
+    double        DropRate    = 0;
+    double        BitErrors   = 0;
+    unsigned long TckNs       = 5000;
+    unsigned long ByteUs      = 20;
+    unsigned long CreditMs    = 10000;  // CreditStream's send timeout
+    unsigned long LimitSec    = 36000;
+    bool          Fuse        = true;
+    unsigned long FailPoll    = 0;      // PrAcc poll that times out, 0 none
+};
+
+struct SimStall {};
+
+class SimLink;
+
+    // The host tool's side of a transfer
+class HostAgent
+{
+public:
+    std::string Failure;
+
+    virtual ~HostAgent() {}
+    virtual void     Start(SimLink & link) = 0;
+    virtual void     Receive(SimLink & link, uint8_t c) = 0;
+    virtual uint64_t Deadline() const { return NEVER; }
+    virtual void     Timer(SimLink &) {}
+};
+
+class SimLink: public HostSerialLink, public JTAGBackend
+{
+private:
+    typedef std::deque<std::pair<uint64_t, uint8_t> > Wire;
+
+    const LinkConfig & cfg_;
+    HostAgent &        agent_;
+    std::mt19937       rng_;
+    uint64_t           now_;
+    uint64_t           byteNs_;
+    Wire               toSketch_, toHost_;
+    uint64_t           hostTxFree_, sketchTxFree_;
+    std::deque<uint8_t>  rx_;
+    std::deque<uint64_t> tx_;       // sketch bytes not yet sent
+    uint32_t           ir_;
+    uint32_t           idcode_;
+    unsigned long      polls_;
+
+    bool Chance(double p)
+    {
+        return p > 0 && std::uniform_real_distribution<double>( 0, 1 )( rng_ ) < p;
+    }
+
+        // Queues one byte on a wire, with the configured damage
+    void Put(Wire & wire, uint64_t arrival, uint8_t c)
+    {
+        if ( Chance( cfg_.DropRate ) )
+        {
+            ++Dropped;
+            return;
+        }
+        if ( Chance( cfg_.BitErrors ) )
+        {
+            c ^= 1 << std::uniform_int_distribution<int>( 0, 7 )( rng_ );
+            ++Flipped;
+        }
+        wire.push_back( std::make_pair( arrival, c ) );
+    }
+
+    uint64_t NextEvent() const
+    {
+        uint64_t t = agent_.Deadline();
+        if ( !toSketch_.empty() && toSketch_.front().first < t ) t = toSketch_.front().first;
+        if ( !toHost_.empty() && toHost_.front().first < t )     t = toHost_.front().first;
+        return t;
+    }
+
+    void Scan(unsigned bits)
+    {
+        ++Scans;
+            // TAP moves from and back to Run-Test/Idle
+        Advance( now_ + ( bits + 6 ) * (uint64_t)cfg_.TckNs );
+    }
+
+public:
+    unsigned long SentToSketch = 0, SentToHost = 0;
+    unsigned long Overruns = 0, Dropped = 0, Flipped = 0;
+    unsigned long Scans = 0;
+
+    SimLink(const LinkConfig & cfg, HostAgent & agent, unsigned seed, uint32_t idcode)
+        : cfg_( cfg ),
+          agent_( agent ),
+          rng_( seed ),
+          now_( 0 ),
+          byteNs_( 10 * 1000000000ull / cfg.Baud ),
+          hostTxFree_( 0 ),
+          sketchTxFree_( 0 ),
+          ir_( 0 ),
+          idcode_( idcode ),
+          polls_( 0 )
+    {
+    }
+
+    uint64_t Now() const { return now_; }
+
+        // Moves the clock to 't', delivering whatever arrives meanwhile
+    void Advance(uint64_t t)
+    {
+        uint64_t next;
+
+        while ( ( next = NextEvent() ) <= t )
+        {
+            now_ = next;
+            while ( !toSketch_.empty() && toSketch_.front().first <= now_ )
+            {
+                if ( rx_.size() < cfg_.RxBuffer )
+                {
+                    rx_.push_back( toSketch_.front().second );
+                }
+                else
+                {
+                    ++Overruns;
+                }
+                toSketch_.pop_front();
+            }
+            while ( !toHost_.empty() && toHost_.front().first <= now_ )
+            {
+                uint8_t c = toHost_.front().second;
+                toHost_.pop_front();
+                agent_.Receive( *this, c );
+            }
+            if ( agent_.Deadline() <= now_ )
+            {
+                agent_.Timer( *this );
+            }
+        }
+        now_ = t;
+        if ( now_ > cfg_.LimitSec * 1000 * MS )
+        {
+            throw SimStall();
+        }
+    }
+
+        // One host write() call
+    void HostWrite(const uint8_t * data, size_t len)
+    {
+        uint64_t t = std::max( now_ + cfg_.LatencyUs * 1000, hostTxFree_ );
+
+        for ( size_t i = 0; i < len; ++i )
+        {
+            t += byteNs_;
+            Put( toSketch_, t, data[i] );
+        }
+        hostTxFree_   = t;
+        SentToSketch += len;
+    }
+
+        // Lets the host side finish reading after the sketch is done
+    void Drain()
+    {
+        while ( !toHost_.empty() )
+        {
+            Advance( toHost_.back().first );
+        }
+    }
+
+        //
+        // Serial, as the sketch sees it
+        //
+    int Available() override
+    {
+        Advance( now_ + 1000 );
+        if ( rx_.empty() )
+        {
+            uint64_t next = NextEvent();
+            if ( next == NEVER )
+            {
+                throw SimStall();
+            }
+            Advance( next );
+        }
+        return rx_.size();
+    }
+
+    int Read() override
+    {
+        if ( rx_.empty() )
+        {
+            return -1;
+        }
+        uint8_t c = rx_.front();
+        rx_.pop_front();
+        Advance( now_ + cfg_.ByteUs * 1000 );
+        return c;
+    }
+
+    int AvailableForWrite() override
+    {
+        while ( !tx_.empty() && tx_.front() <= now_ )
+        {
+            tx_.pop_front();
+        }
+        return cfg_.TxBuffer - tx_.size();
+    }
+
+    size_t Write(const uint8_t * buf, size_t len) override
+    {
+        for ( size_t i = 0; i < len; ++i )
+        {
+                // A full TX buffer blocks until a byte has gone out
+            if ( AvailableForWrite() <= 0 )
+            {
+                Advance( tx_.front() );
+                AvailableForWrite();
+            }
+            uint64_t start = std::max( now_, sketchTxFree_ );
+            sketchTxFree_ = start + byteNs_;
+            tx_.push_back( start );
+            Put( toHost_, sketchTxFree_ + cfg_.LatencyUs * 1000, buf[i] );
+        }
+        SentToHost += len;
+        return len;
+    }
+
+        //
+        // JTAG, a target that always answers as expected, but for -p
+        //
+    void SetMCLR(bool) override {}
+
+    uint32_t ShiftTMS(unsigned char bits, uint32_t) override
+    {
+        Advance( now_ + bits * (uint64_t)cfg_.TckNs );
+        return 0;
+    }
+
+    uint32_t ScanIR(unsigned char bits, uint32_t tdi) override
+    {
+        Scan( bits );
+        ir_ = tdi;
+        return 0;
+    }
+
+    uint32_t ScanDR(unsigned char bits, uint32_t) override
+    {
+        Scan( bits );
+        return ir_ == 0x01 ? idcode_ : 0;
+    }
+
+    uint32_t ScanDR(unsigned char bits, uint32_t, bool & lead) override
+    {
+        Scan( bits + 1 );
+        lead = true;
+        return 0;
+    }
+
+    bool PollDR(unsigned char bits, uint32_t, uint32_t, uint16_t tries) override
+    {
+        if ( ++polls_ == cfg_.FailPoll )
+        {
+            while ( tries-- )
+            {
+                Scan( bits );
+            }
+            return false;
+        }
+        Scan( bits );
+        return true;
+    }
+};
+
+class PasteAgent: public HostAgent
+{
+private:
+    const std::string & text_;
+
+public:
+    explicit PasteAgent(const std::string & text) : text_( text ) {}
+
+    void Start(SimLink & link) override
+    {
+        link.HostWrite( (const uint8_t *)text_.data(), text_.size() );
+    }
+
+    void Receive(SimLink &, uint8_t) override {}
+};
+
+    // CreditStream::Send(): one 32 byte chunk per XON
+class CreditAgent: public HostAgent
+{
+private:
+    const std::vector<uint8_t> & data_;
+    unsigned long timeoutMs_;
+    size_t        sent_;
+    uint64_t      deadline_;
+
+public:
+    CreditAgent(const std::vector<uint8_t> & data, unsigned long timeoutMs)
+        : data_( data ),
+          timeoutMs_( timeoutMs ),
+          sent_( 0 ),
+          deadline_( NEVER )
+    {
+    }
+
+    void Start(SimLink & link) override
+    {
+        deadline_ = link.Now() + timeoutMs_ * MS;
+    }
+
+    void Receive(SimLink & link, uint8_t c) override
+    {
+        if ( sent_ == data_.size() || !Failure.empty() )
+        {
+            return;
+        }
+        if ( c != XON )
+        {
+                // Pump() starts its timeout over on any byte
+            deadline_ = link.Now() + timeoutMs_ * MS;
+            return;
+        }
+        size_t n = std::min( (size_t)RX_CREDIT_BYTES, data_.size() - sent_ );
+        link.HostWrite( data_.data() + sent_, n );
+        sent_    += n;
+        deadline_ = sent_ == data_.size() ? NEVER : link.Now() + timeoutMs_ * MS;
+    }
+
+    uint64_t Deadline() const override { return deadline_; }
+
+    void Timer(SimLink &) override
+    {
+        Failure   = "host timed out waiting for credits";
+        deadline_ = NEVER;
+    }
+};
+
+enum sim_mode_e {
+    MODE_PASTE,
+    MODE_PACKED,
+    MODE_ROWS
+};
+
+static const char * const ModeNames[] = { "paste", "packed", "rows" };
+
+struct SimResult
+{
+    double        Seconds = 0;
+    unsigned long Wire    = 0;
+    unsigned long Overruns = 0, Dropped = 0, Flipped = 0;
+    double        ScansPerInsn = 0;
+    bool          Stalled = false;
+    unsigned      Error   = 0;
+    std::string   Failure;
+};
+
+static SimResult Run(int mode, const LinkConfig & cfg, unsigned seed, const Pic32DevID_t & dev,
+                     const std::string & hexText, const std::vector<uint8_t> & packed,
+                     const std::vector<uint8_t> & rows)
+{
+    PasteAgent  paste( hexText );
+    CreditAgent credit( mode == MODE_PACKED ? packed : rows, cfg.CreditMs );
+    HostAgent & agent = mode == MODE_PASTE ? (HostAgent &)paste : (HostAgent &)credit;
+    SimLink     link( cfg, agent, seed, dev.DevID );
+    SimResult   r;
+
+    memset( HostEEPROM.Data, 0xff, sizeof(HostEEPROM.Data) );
+    memset( &SessionState, 0, sizeof(SessionState) );
+    memset( &ProgressState, 0, sizeof(ProgressState) );
+
+    HostSerialHook   = &link;
+    HostClockHook    = [](void * ctx) { return (unsigned long)( static_cast<SimLink *>( ctx )->Now() / 1000 ); };
+    HostClockHookCtx = &link;
+    HostDelayHook    = [](void * ctx, unsigned long ms) { SimLink & l = *static_cast<SimLink *>( ctx ); l.Advance( l.Now() + ms * MS ); };
+    HostDelayHookCtx = &link;
+    ArduinoJTAG::SetBackend( &link );
+
+    try
+    {
+        Pic32JTAGDevice pic32( false );
+        pic32.SetPrAccFusion( cfg.Fuse );
+        pic32.AutoDetect();
+        unsigned long scans = link.Scans;
+        uint32_t      insns = pic32.GetInstructionCount();
+
+        agent.Start( link );
+        switch ( mode )
+        {
+            case MODE_PASTE:  HexPgm( pic32, true, false );    break;
+            case MODE_PACKED: PackedPgm( pic32, true, false ); break;
+            case MODE_ROWS:   RowPgm( pic32, true, false );    break;
+        }
+        r.Seconds = link.Now() / 1e9;
+        r.Error   = ProgressState.Error;
+        insns     = pic32.GetInstructionCount() - insns;
+        r.ScansPerInsn = insns ? (double)( link.Scans - scans ) / insns : 0;
+        link.Drain();
+    }
+    catch ( SimStall & )
+    {
+            // Stalls while throwing away the rest of the file count as
+            // the error the loader ended with
+        r.Seconds = link.Now() / 1e9;
+        r.Error   = ProgressState.Phase == PHASE_FAIL ? ProgressState.Error : 0;
+        r.Stalled = !r.Error;
+    }
+
+    HostSerialHook = 0;
+    HostClockHook  = 0;
+    HostDelayHook  = 0;
+
+    r.Wire     = link.SentToSketch;
+    r.Overruns = link.Overruns;
+    r.Dropped  = link.Dropped;
+    r.Flipped  = link.Flipped;
+    r.Failure  = agent.Failure;
+    return r;
+}
+
+static void Usage()
+{
+    fprintf( stderr,
+        "usage: linksim -t <device> [-b baud] [-l latency_us] [-r rx_buffer]\n"
+        "               [-d drop_rate] [-e bit_error_rate] [-k tck_ns] [-c byte_us]\n"
+        "               [-s seed] [-q] [-F] [-p poll] [-m paste,packed,rows] <file.hex>\n" );
+    exit( 2 );
+}
+
+static bool FindDevice(const char * name, Pic32DevID_t & dev)
+{
+    for ( int n = 0; Pic32DevIDList[n].DevID; ++n )
+    {
+        if ( !strcasecmp( Pic32DevIDList[n].DevName, name ) )
+        {
+            dev = Pic32DevIDList[n];
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char ** argv)
+{
+    LinkConfig  cfg;
+    std::string device, modes = "paste,packed,rows";
+    unsigned    seed = 1;
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "t:b:l:r:d:e:k:c:s:qFp:m:" ) ) != -1 )
+    {
+        switch ( opt )
+        {
+            case 't': device        = optarg; break;
+            case 'b': cfg.Baud      = strtoul( optarg, 0, 0 ); break;
+            case 'l': cfg.LatencyUs = strtoul( optarg, 0, 0 ); break;
+            case 'r': cfg.RxBuffer  = strtoul( optarg, 0, 0 ); break;
+            case 'd': cfg.DropRate  = atof( optarg ); break;
+            case 'e': cfg.BitErrors = atof( optarg ); break;
+            case 'k': cfg.TckNs     = strtoul( optarg, 0, 0 ); break;
+            case 'c': cfg.ByteUs    = strtoul( optarg, 0, 0 ); break;
+            case 's': seed          = strtoul( optarg, 0, 0 ); break;
+            case 'q': QuietMode     = true; break;
+            case 'F': cfg.Fuse      = false; break;
+            case 'p': cfg.FailPoll  = strtoul( optarg, 0, 0 ); break;
+            case 'm': modes         = optarg; break;
+            default:  Usage();
+        }
+    }
+    if ( device.empty() || optind != argc - 1 || !cfg.Baud || !cfg.RxBuffer )
+    {
+        Usage();
+    }
+
+    Pic32DevID_t dev;
+    if ( !FindDevice( device.c_str(), dev ) )
+    {
+        fprintf( stderr, "Unknown device %s\n", device.c_str() );
+        return 1;
+    }
+    const Pic32Family_t & fam = Pic32FamilyList[dev.Family];
+
+    std::ifstream in( argv[optind], std::ios::binary );
+    std::stringstream ss;
+    ss << in.rdbuf();
+    std::string hexText = ss.str();
+
+    IntelHex hex;
+    RowLayout layout;
+    RowGeometry geo = { dev.DevID, fam.RowSize * 4u, dev.PFMSize, dev.BFMSize };
+    std::string err;
+    if ( !in || !hex.Parse( hexText, err ) || !layout.Build( hex, geo, err ) )
+    {
+        fprintf( stderr, "%s\n", err.empty() ? argv[optind] : err.c_str() );
+        return 1;
+    }
+    Packer packer( hex );
+
+    printf( "%lu baud, %lu us latency, %u byte RX buffer, drop %g, bit errors %g, TCK %lu ns\n",
+            cfg.Baud, cfg.LatencyUs, cfg.RxBuffer, cfg.DropRate, cfg.BitErrors, cfg.TckNs );
+    printf( "%-7s %9s %9s %11s %8s %6s %6s %8s  %s\n",
+            "mode", "wire B", "time s", "image B/s", "overrun", "drop", "flip", "scan/ins", "result" );
+
+    int failed = 0;
+    for ( int mode = MODE_PASTE; mode <= MODE_ROWS; ++mode )
+    {
+        if ( ( "," + modes + "," ).find( std::string( "," ) + ModeNames[mode] + "," ) == std::string::npos )
+        {
+            continue;
+        }
+
+        SimResult r = Run( mode, cfg, seed, dev, hexText, packer.Data(), layout.Data() );
+        char result[80];
+
+        if ( r.Stalled )
+        {
+            snprintf( result, sizeof(result), "stalled, %s",
+                      r.Failure.empty() ? "sketch waiting for data" : r.Failure.c_str() );
+        }
+        else if ( r.Error )
+        {
+            snprintf( result, sizeof(result), "error %u", r.Error );
+        }
+        else
+        {
+            snprintf( result, sizeof(result), "ok" );
+        }
+        failed += r.Stalled || r.Error;
+
+        printf( "%-7s %9lu %9.2f %11.1f %8lu %6lu %6lu %8.2f  %s\n",
+                ModeNames[mode], r.Wire, r.Seconds, r.Seconds > 0 ? hex.ByteCount() / r.Seconds : 0.0,
+                r.Overruns, r.Dropped, r.Flipped, r.ScansPerInsn, result );
+    }
+    return failed ? 1 : 0;
+}
@@ -0,0 +1,150 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+
+/*
+ * p32devgen: writes Pic32DevList.h from pic32devices.txt, sorted by the
+ * revision masked IDCODE so AutoDetect() can binary search it.
+ *
+ *   p32devgen pic32devices.txt > ../Pic32DevList.h
+ */
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+struct Device
+{
+    uint32_t    ID;
+    std::string Name, Family, Flags;
+    unsigned    RAM, BFM, PFM;
+
+    bool operator<(const Device & o) const { return ID < o.ID; }
+};
+
+static int Fail(const std::string & file, unsigned line, const char * what)
+{
+    fprintf( stderr, "%s:%u: %s\n", file.c_str(), line, what );
+    return 1;
+}
+
+int main(int argc, char ** argv)
+{
+    if ( argc != 2 )
+    {
+        fprintf( stderr, "usage: p32devgen <devices.txt>\n" );
+        return 2;
+    }
+
+    std::ifstream in( argv[1] );
+    if ( !in )
+    {
+        perror( argv[1] );
+        return 1;
+    }
+
+    std::vector<Device> devs;
+    std::string text;
+    unsigned lineNo = 0;
+
+    while ( std::getline( in, text ) )
+    {
+        ++lineNo;
+        if ( text.empty() || text[0] == '#' )
+        {
+            continue;
+        }
+
+        std::istringstream line( text );
+        std::string id;
+        Device d;
+        if ( !( line >> id >> d.Name >> d.Family >> d.RAM >> d.BFM >> d.PFM >> d.Flags ) )
+        {
+            return Fail( argv[1], lineNo, "expected 7 columns" );
+        }
+        d.ID = strtoul( id.c_str(), 0, 0 );
+        if ( d.ID & 0xF0000000 )
+        {
+            return Fail( argv[1], lineNo, "IDCODE must not include the revision nibble" );
+        }
+        if ( !( d.ID & 1 ) )
+        {
+            return Fail( argv[1], lineNo, "IDCODE bit 0 must be set" );
+        }
+        if ( d.Name.size() > 10 )
+        {
+            return Fail( argv[1], lineNo, "name longer than 10 characters" );
+        }
+        if ( d.Family.compare( 0, 7, "FAMILY_" ) )
+        {
+            return Fail( argv[1], lineNo, "family must be a FAMILY_ constant" );
+        }
+        if ( d.RAM > 0xffff || d.BFM > 0xffff || d.PFM > 0xffff )
+        {
+            return Fail( argv[1], lineNo, "sizes are 16 bit KB counts" );
+        }
+        d.Flags = d.Flags == "-" ? "0" : "DEV_" + d.Flags;
+        devs.push_back( d );
+    }
+
+    std::sort( devs.begin(), devs.end() );
+    for ( size_t i = 1; i < devs.size(); ++i )
+    {
+        if ( devs[i].ID == devs[i - 1].ID )
+        {
+            fprintf( stderr, "duplicate IDCODE 0x%X: %s and %s\n", devs[i].ID,
+                     devs[i - 1].Name.c_str(), devs[i].Name.c_str() );
+            return 1;
+        }
+    }
+
+    printf( "/* Generated by host/p32devgen from host/pic32devices.txt, do not edit. */\n\n" );
+    printf( "#ifndef PIC32_DEV_LIST\n#define PIC32_DEV_LIST\n\n" );
+    printf( "#define PIC32_DEVICE_COUNT %zu\n\n", devs.size() );
+    printf( "    // Sorted by DevID, the \"Unknown\" entry after the last one\n" );
+    printf( "PROGMEM const Pic32DevID_t Pic32DevIDList[] =\n{\n" );
+    printf( "   // DevID      DevName       Family         RAM  BFM  PFM  Flags\n" );
+    for ( size_t i = 0; i < devs.size(); ++i )
+    {
+        const Device & d = devs[i];
+        char id[16];
+        snprintf( id, sizeof(id), "0x%X,", d.ID );
+        std::string name = "\"" + d.Name + "\",";
+        std::string fam  = d.Family + ",";
+        printf( "    { %-11s %-13s %-13s %3u, %3u, %3u, %s },\n",
+                id, name.c_str(), fam.c_str(), d.RAM, d.BFM, d.PFM, d.Flags.c_str() );
+    }
+    printf( "    { %-11s %-13s %-13s %3u, %3u, %3u, %s }\n", "0,", "\"Unknown\",", "FAMILY_MX12,", 0, 0, 0, "0" );
+    printf( "};\n\n#endif\n" );
+    return 0;
+}
@@ -0,0 +1,384 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+/*
+ * p32farm: programs the boards on several ArduPIC32 stations at once.
+ *
+ *   p32farm [-b baud] [-n max_baud] [-g gap] [-l] [-d port]... image.hex
+ *
+ * The image is read and packed (Packer.h) once, every station is fed
+ * from the same read-only buffer. Without -d all /dev/ttyUSB* and
+ * /dev/ttyACM* ports are used. Each port has a worker thread of its
+ * own that waits for the start prompt, then sends "Hcmz" and the packed
+ * stream and follows the status frames; the main thread only prints.
+ * A station that stalls or fails times out on its own and has its port
+ * reopened (which resets most Arduinos), the others carry on.
+ *
+ * With -n each station is asked for the fastest rate up to max_baud
+ * its link passes (LinkSpeed.h). The station remembers it, and comes
+ * up at that rate the next time its port is opened.
+ *
+ * Without -l every station programs one board. With -l they go on with
+ * the next board until interrupted. Exits 0 if every board passed.
+ */
+#include "CreditStream.h"
+#include "IntelHex.h"
+#include "LinkSpeed.h"
+#include "Packer.h"
+#include "SerialPort.h"
+#include "StatusFrame.h"
+
+#include <glob.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <algorithm>
+#include <atomic>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+enum {
+    PROMPT_POLL_MS  = 1000,
+    PROMPT_MS       = 15000,
+    SEND_TIMEOUT_MS = 10000,
+    DONE_TIMEOUT_MS = 60000
+};
+
+enum station_state_e {
+    STATION_WAITING,
+    STATION_PROGRAMMING,
+    STATION_IDLE,
+    STATION_FAILED
+};
+
+struct Station
+{
+    std::string   Port;
+    std::thread   Worker;
+
+        // Shared with the main thread, under Lock
+    unsigned      State    = STATION_WAITING;
+    size_t        Sent     = 0;
+    unsigned      Boards   = 0;
+    unsigned      Failures = 0;
+    unsigned long Baud     = 0;
+    double        LastSec  = 0;
+    double        TotalSec = 0;
+    std::string   Message;
+};
+
+static std::mutex        Lock;
+static std::atomic<bool> Stop( false );
+
+static void Usage()
+{
+    fprintf( stderr, "usage: p32farm [-b baud] [-n max_baud] [-g gap] [-l] [-d port]... <image.hex>\n" );
+    exit( 2 );
+}
+
+static double Now()
+{
+    struct timeval tv;
+    gettimeofday( &tv, 0 );
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static void OnSignal(int)
+{
+    Stop = true;
+}
+
+static std::vector<std::string> FindPorts()
+{
+    std::vector<std::string> ports;
+    const char * const patterns[] = { "/dev/ttyUSB*", "/dev/ttyACM*" };
+
+    for ( const char * pattern: patterns )
+    {
+        glob_t g;
+        if ( glob( pattern, 0, 0, &g ) == 0 )
+        {
+            ports.insert( ports.end(), g.gl_pathv, g.gl_pathv + g.gl_pathc );
+        }
+        globfree( &g );
+    }
+    std::sort( ports.begin(), ports.end() );
+    return ports;
+}
+
+static void SetState(Station & st, unsigned state, const std::string & message = "")
+{
+    std::lock_guard<std::mutex> guard( Lock );
+    st.State   = state;
+    st.Message = message;
+}
+
+static void OnSent(void * ctx, size_t sent, size_t)
+{
+    Station & st = *static_cast<Station *>( ctx );
+    std::lock_guard<std::mutex> guard( Lock );
+    st.Sent = sent;
+}
+
+static bool Finished(const std::string & text)
+{
+        // Frames are only ever appended, the last two are enough
+    size_t from = text.size() > 2 * STATUS_FRAME_LEN ? text.size() - 2 * STATUS_FRAME_LEN : 0;
+    std::vector<StatusFrame> frames = ParseStatusFrames( text.substr( from ) );
+    return !frames.empty() && frames.back().Final();
+}
+
+    // One board: false if the station has to be reset
+static bool ProgramBoard(Station & st, SerialPort & serial, const std::vector<uint8_t> & image)
+{
+    CreditStream stream( serial, false );
+
+    SetState( st, STATION_WAITING );
+    while ( !stream.WaitFor( "to start!", PROMPT_POLL_MS ) )
+    {
+        if ( Stop )
+        {
+            SetState( st, STATION_IDLE, "stopped" );
+            return true;
+        }
+    }
+
+    double start = Now();
+    {
+        std::lock_guard<std::mutex> guard( Lock );
+        st.State = STATION_PROGRAMMING;
+        st.Sent  = 0;
+        st.Message.clear();
+    }
+
+    serial.Write( "Hcmz", 4 );
+    if ( !stream.Send( image.data(), image.size(), SEND_TIMEOUT_MS, OnSent, &st )
+         || !stream.WaitUntil( Finished, DONE_TIMEOUT_MS ) )
+    {
+        std::lock_guard<std::mutex> guard( Lock );
+        ++st.Failures;
+        st.State   = STATION_FAILED;
+        st.Message = "no response";
+        return false;
+    }
+
+    std::vector<StatusFrame> frames = ParseStatusFrames( stream.Text() );
+    const StatusFrame & f = frames.back();
+    double secs = Now() - start;
+
+        // Text mode again, and release the board
+    serial.Write( "mx", 2 );
+
+    std::lock_guard<std::mutex> guard( Lock );
+    ++st.Boards;
+    st.LastSec   = secs;
+    st.TotalSec += secs;
+    if ( f.Error )
+    {
+        char text[48];
+        snprintf( text, sizeof(text), "error %u near 0x%08x", f.Error, f.Addr );
+        ++st.Failures;
+        st.State   = STATION_FAILED;
+        st.Message = text;
+    }
+    else
+    {
+        st.State = STATION_IDLE;
+        st.Message.clear();
+    }
+    return true;
+}
+
+static void RunStation(Station & st, const std::vector<uint8_t> & image, unsigned long baud,
+                       unsigned long maxBaud, bool loop)
+{
+    SerialPort serial;
+
+    do
+    {
+        if ( !serial.IsOpen() )
+        {
+            if ( !serial.Open( st.Port, baud ) )
+            {
+                std::lock_guard<std::mutex> guard( Lock );
+                st.State   = STATION_FAILED;
+                st.Message = "cannot open";
+                return;
+            }
+
+            unsigned long rate = baud;
+            if ( maxBaud )
+            {
+                rate = LinkAttach( serial );
+                if ( rate < maxBaud && serial.WaitFor( "to start!", PROMPT_MS ) )
+                {
+                    rate = LinkNegotiate( serial, rate, maxBaud );
+                }
+            }
+            std::lock_guard<std::mutex> guard( Lock );
+            st.Baud = rate;
+        }
+        if ( !ProgramBoard( st, serial, image ) )
+        {
+            serial.Close();
+        }
+    } while ( loop && !Stop );
+}
+
+static const char * ShortName(const std::string & port)
+{
+    size_t slash = port.rfind( '/' );
+    return port.c_str() + ( slash == std::string::npos ? 0 : slash + 1 );
+}
+
+static void PrintStatus(std::list<Station> & stations, size_t total, bool final)
+{
+    static const char * const names[] = { "waiting", "", "idle", "FAILED" };
+    std::lock_guard<std::mutex> guard( Lock );
+
+    for ( Station & st: stations )
+    {
+        if ( final )
+        {
+            printf( "%-14s %6lu %4u boards %4u failed  last %5.1f s  mean %5.1f s  %s\n",
+                    st.Port.c_str(), st.Baud, st.Boards, st.Failures, st.LastSec,
+                    st.Boards ? st.TotalSec / st.Boards : 0.0, st.Message.c_str() );
+        }
+        else if ( st.State == STATION_PROGRAMMING )
+        {
+            printf( "%s %3zu%%  ", ShortName( st.Port ), total ? st.Sent * 100 / total : 0 );
+        }
+        else
+        {
+            printf( "%s %s  ", ShortName( st.Port ), names[st.State] );
+        }
+    }
+    if ( !final )
+    {
+        printf( "\r" );
+    }
+    fflush( stdout );
+}
+
+int main(int argc, char ** argv)
+{
+    std::vector<std::string> ports;
+    unsigned long baud = LINK_BASE_BAUD, maxBaud = 0, gap = 64;
+    bool loop = false;
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "b:n:g:ld:" ) ) != -1 )
+    {
+        switch ( opt )
+        {
+            case 'b': baud    = strtoul( optarg, 0, 0 ); break;
+            case 'n': maxBaud = strtoul( optarg, 0, 0 ); break;
+            case 'g': gap     = strtoul( optarg, 0, 0 ); break;
+            case 'l': loop    = true; break;
+            case 'd': ports.push_back( optarg ); break;
+            default:  Usage();
+        }
+    }
+    if ( optind != argc - 1 )
+    {
+        Usage();
+    }
+    if ( ports.empty() )
+    {
+        ports = FindPorts();
+    }
+    if ( ports.empty() )
+    {
+        fprintf( stderr, "No serial ports found\n" );
+        return 1;
+    }
+
+    IntelHex hex;
+    std::string err;
+    if ( !hex.Load( argv[optind], err ) )
+    {
+        fprintf( stderr, "%s\n", err.c_str() );
+        return 1;
+    }
+    Packer packer( hex, gap );
+    const std::vector<uint8_t> & image = packer.Data();
+
+    printf( "%zu image bytes, %zu packed, %zu stations\n", hex.ByteCount(), image.size(), ports.size() );
+
+    signal( SIGINT, OnSignal );
+    signal( SIGTERM, OnSignal );
+
+        // std::list: the workers keep references to their Station
+    std::list<Station> stations;
+    for ( const std::string & port: ports )
+    {
+        stations.emplace_back();
+        stations.back().Port = port;
+    }
+    for ( Station & st: stations )
+    {
+        st.Worker = std::thread( RunStation, std::ref( st ), std::cref( image ), baud, maxBaud, loop );
+    }
+
+    bool running = true;
+    while ( running )
+    {
+        usleep( 500000 );
+        PrintStatus( stations, image.size(), false );
+
+        std::lock_guard<std::mutex> guard( Lock );
+        running = false;
+        for ( Station & st: stations )
+        {
+            running |= loop ? !Stop.load() : st.State < STATION_IDLE;
+        }
+    }
+
+    Stop = true;
+    for ( Station & st: stations )
+    {
+        st.Worker.join();
+    }
+
+    printf( "\n" );
+    PrintStatus( stations, image.size(), true );
+
+    unsigned failures = 0, boards = 0;
+    for ( const Station & st: stations )
+    {
+        failures += st.Failures;
+        boards   += st.Boards;
+    }
+    return failures || !boards ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+
+/*
+ * p32pack: converts an Intel HEX file into the packed stream loaded by
+ * the sketch's 'z' command (PackedImage.h), checks it by unpacking, and
+ * reports how much serial time it saves.
+ *
+ *   p32pack [-b baud] [-g gap] file.hex out.p32z
+ *   p32send -d /dev/ttyUSB0 -w " >" -c z out.p32z
+ */
+#include "IntelHex.h"
+#include "Packer.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+
+static void Usage()
+{
+    fprintf( stderr, "usage: p32pack [-b baud] [-g gap] <file.hex> <out.p32z>\n" );
+    exit( 2 );
+}
+
+int main(int argc, char ** argv)
+{
+    unsigned long baud = 1200, gap = 64;
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "b:g:" ) ) != -1 )
+    {
+        switch ( opt )
+        {
+            case 'b': baud = strtoul( optarg, 0, 0 ); break;
+            case 'g': gap  = strtoul( optarg, 0, 0 ); break;
+            default:  Usage();
+        }
+    }
+    if ( optind != argc - 2 || !baud )
+    {
+        Usage();
+    }
+
+    std::ifstream in( argv[optind], std::ios::binary | std::ios::ate );
+    if ( !in )
+    {
+        perror( argv[optind] );
+        return 1;
+    }
+    size_t hexSize = in.tellg();
+
+    IntelHex hex;
+    std::string err;
+    if ( !hex.Load( argv[optind], err ) )
+    {
+        fprintf( stderr, "%s\n", err.c_str() );
+        return 1;
+    }
+
+    Packer packer( hex, gap );
+    const std::vector<uint8_t> & packed = packer.Data();
+
+        // Round trip: every image byte must come back, holes as 0xFF
+    IntelHex::Extents check;
+    if ( !Packer::Unpack( packed, check, err ) )
+    {
+        fprintf( stderr, "internal error: %s\n", err.c_str() );
+        return 1;
+    }
+    for ( IntelHex::Extents::const_iterator it = hex.Data().begin(); it != hex.Data().end(); ++it )
+    {
+        for ( size_t k = 0; k < it->second.size(); ++k )
+        {
+            uint32_t a = it->first + k;
+            IntelHex::Extents::const_iterator seg = check.upper_bound( a );
+            if ( seg == check.begin() || (--seg, a - seg->first >= seg->second.size())
+                 || seg->second[a - seg->first] != it->second[k] )
+            {
+                fprintf( stderr, "internal error: round trip differs at 0x%08x\n", a );
+                return 1;
+            }
+        }
+    }
+
+    std::ofstream out( argv[optind + 1], std::ios::binary );
+    out.write( (const char *)packed.data(), packed.size() );
+    if ( !out )
+    {
+        perror( argv[optind + 1] );
+        return 1;
+    }
+
+        // 8N1, ten bit times per byte
+    double hexSec  = hexSize * 10.0 / baud;
+    double packSec = packed.size() * 10.0 / baud;
+
+    printf( "image    %zu bytes in %u segments\n", hex.ByteCount(), packer.Segments() );
+    printf( "hex      %zu bytes, %.1f s at %lu baud\n", hexSize, hexSec, baud );
+    printf( "packed   %zu bytes, %.1f s at %lu baud\n", packed.size(), packSec, baud );
+    printf( "ratio    %.2f : 1 against the hex file\n", packed.size() ? (double)hexSize / packed.size() : 0.0 );
+    return 0;
+}
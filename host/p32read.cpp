@@ -0,0 +1,218 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+/*
+ * p32read: saves a board's boot flash, configuration words and program
+ * flash as Intel HEX, using the sketch's read-out commands (ReadOut.h).
+ *
+ *   p32read -d /dev/ttyUSB0 [-b baud] [-w prompt] [-t] [-c cmd] out.hex
+ *
+ * By default the binary read-out ('B') is used and every block's CRC is
+ * checked. -t uses the sketch's own Intel HEX output ('b') instead. The
+ * command string is sent after the prompt, by default "cB" ("cb" with
+ * -t) so programming mode is entered first.
+ */
+#include "IntelHex.h"
+#include "SerialPort.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <util/crc16.h>
+#include <string>
+#include <vector>
+
+enum {
+    READ_TIMEOUT_MS = 10000
+};
+
+static void Usage()
+{
+    fprintf( stderr, "usage: p32read -d <port> [-b baud] [-w prompt] [-t] [-c cmd] <out.hex>\n" );
+    exit( 2 );
+}
+
+static double Now()
+{
+    struct timeval tv;
+    gettimeofday( &tv, 0 );
+    return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+static bool ReadFull(SerialPort & serial, uint8_t * buf, size_t len)
+{
+    while ( len )
+    {
+        long n = serial.Read( buf, len, READ_TIMEOUT_MS );
+        if ( n <= 0 )
+        {
+            return false;
+        }
+        buf += n;
+        len -= n;
+    }
+    return true;
+}
+
+static bool ReadBinary(SerialPort & serial, IntelHex & hex)
+{
+    if ( !serial.WaitFor( "Binary read-out\r\n", READ_TIMEOUT_MS ) )
+    {
+        fprintf( stderr, "No read-out from %s\n", serial.Path().c_str() );
+        return false;
+    }
+
+    for ( ;; )
+    {
+        uint8_t tag, head[5], crc[2];
+
+        if ( !ReadFull( serial, &tag, 1 ) )
+        {
+            fprintf( stderr, "\nTimeout\n" );
+            return false;
+        }
+        if ( tag == 'E' )
+        {
+            return true;
+        }
+        if ( tag != 'B' || !ReadFull( serial, head, sizeof(head) ) )
+        {
+            fprintf( stderr, "\nBad frame\n" );
+            return false;
+        }
+
+        uint32_t addr = head[0] | head[1] << 8 | head[2] << 16 | (uint32_t)head[3] << 24;
+        std::vector<uint8_t> data( 4 * head[4] );
+        uint16_t sum = 0xffff;
+
+        if ( !ReadFull( serial, data.data(), data.size() ) || !ReadFull( serial, crc, 2 ) )
+        {
+            fprintf( stderr, "\nTimeout\n" );
+            return false;
+        }
+        for ( size_t i = 0; i < sizeof(head); ++i )
+        {
+            sum = _crc_ccitt_update( sum, head[i] );
+        }
+        for ( size_t i = 0; i < data.size(); ++i )
+        {
+            sum = _crc_ccitt_update( sum, data[i] );
+        }
+        if ( sum != ( crc[0] | crc[1] << 8 ) )
+        {
+            fprintf( stderr, "\nCRC error at 0x%08x\n", addr );
+            return false;
+        }
+
+        hex.Add( addr, data.data(), data.size() );
+        printf( "\r0x%08x %8zu bytes", addr, hex.ByteCount() );
+        fflush( stdout );
+    }
+}
+
+static bool ReadText(SerialPort & serial, IntelHex & hex)
+{
+    std::string text, error;
+
+    if ( !serial.WaitFor( ":00000001FF", READ_TIMEOUT_MS * 6, &text ) )
+    {
+        fprintf( stderr, "No end record from %s\n", serial.Path().c_str() );
+        return false;
+    }
+
+        // Skip the menu's echo in front of the first record
+    text.erase( 0, text.find( ':' ) );
+    if ( !hex.Parse( text, error ) )
+    {
+        fprintf( stderr, "%s\n", error.c_str() );
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char ** argv)
+{
+    std::string port, prompt = "to start!", cmd;
+    unsigned long baud = 1200;
+    bool text = false;
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "d:b:w:tc:" ) ) != -1 )
+    {
+        switch ( opt )
+        {
+            case 'd': port   = optarg; break;
+            case 'b': baud   = strtoul( optarg, 0, 0 ); break;
+            case 'w': prompt = optarg; break;
+            case 't': text   = true; break;
+            case 'c': cmd    = optarg; break;
+            default:  Usage();
+        }
+    }
+    if ( port.empty() || optind != argc - 1 )
+    {
+        Usage();
+    }
+    if ( cmd.empty() )
+    {
+        cmd = text ? "cb" : "cB";
+    }
+
+    SerialPort serial;
+    if ( !serial.Open( port, baud ) )
+    {
+        perror( port.c_str() );
+        return 1;
+    }
+    if ( !prompt.empty() && !serial.WaitFor( prompt.c_str(), 15000 ) )
+    {
+        fprintf( stderr, "No \"%s\" from %s\n", prompt.c_str(), port.c_str() );
+        return 1;
+    }
+
+    IntelHex hex;
+    double start = Now();
+
+    serial.Write( cmd.data(), cmd.size() );
+    if ( !( text ? ReadText( serial, hex ) : ReadBinary( serial, hex ) ) )
+    {
+        return 1;
+    }
+
+    double secs = Now() - start;
+    printf( "\n%zu bytes in %.1f s, %.0f bytes/s\n", hex.ByteCount(), secs, hex.ByteCount() / secs );
+
+    if ( !hex.Save( argv[optind] ) )
+    {
+        perror( argv[optind] );
+        return 1;
+    }
+    return 0;
+}
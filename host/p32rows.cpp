@@ -0,0 +1,152 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+/*
+ * p32rows: lays an Intel HEX file out in one device's flash rows for the
+ * sketch's 'w' command (RowImage.h). Blank rows are left out.
+ *
+ *   p32rows -t <device> [-b baud] file.hex out.p32r
+ *   p32send -d /dev/ttyUSB0 -w " >" -c w out.p32r
+ *
+ * The device is a name from Pic32DevList.h (e.g. MX270F256B, the PIC32
+ * prefix is optional) or its IDCODE. The sketch refuses a file made
+ * for another device.
+ */
+#include "IntelHex.h"
+#include "RowLayout.h"
+#include "Pic32.h"
+
+#include <ctype.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+
+static void Usage()
+{
+    fprintf( stderr, "usage: p32rows -t <device> [-b baud] <file.hex> <out.p32r>\n" );
+    exit( 2 );
+}
+
+static bool FindDevice(const std::string & what, RowGeometry & geo)
+{
+    std::string name;
+    uint32_t id = 0;
+
+    for ( char c: what )
+    {
+        name += toupper( (unsigned char)c );
+    }
+    if ( name.compare( 0, 2, "0X" ) == 0 )
+    {
+        id = strtoul( name.c_str(), 0, 16 ) & ~PIC32_REVISION_MASK;
+    }
+    if ( name.compare( 0, 5, "PIC32" ) == 0 )
+    {
+        name.erase( 0, 5 );
+    }
+
+    for ( unsigned n = 0; n < PIC32_DEVICE_COUNT; ++n )
+    {
+        const Pic32DevID_t & dev = Pic32DevIDList[n];
+        const Pic32Family_t & fam = Pic32FamilyList[dev.Family];
+
+        if ( dev.DevID == id || name == dev.DevName || name == std::string( fam.Prefix ) + dev.DevName )
+        {
+            geo.DevID    = dev.DevID;
+            geo.RowBytes = fam.RowSize * 4;
+            geo.PfmKB    = dev.PFMSize;
+            geo.BfmKB    = dev.BFMSize;
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char ** argv)
+{
+    std::string device;
+    unsigned long baud = 1200;
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "t:b:" ) ) != -1 )
+    {
+        switch ( opt )
+        {
+            case 't': device = optarg; break;
+            case 'b': baud   = strtoul( optarg, 0, 0 ); break;
+            default:  Usage();
+        }
+    }
+    if ( device.empty() || optind != argc - 2 || !baud )
+    {
+        Usage();
+    }
+
+    RowGeometry geo;
+    if ( !FindDevice( device, geo ) )
+    {
+        fprintf( stderr, "Unknown device %s\n", device.c_str() );
+        return 1;
+    }
+
+    std::ifstream in( argv[optind], std::ios::binary | std::ios::ate );
+    if ( !in )
+    {
+        perror( argv[optind] );
+        return 1;
+    }
+    size_t hexSize = in.tellg();
+
+    IntelHex hex;
+    RowLayout rows;
+    std::string err;
+    if ( !hex.Load( argv[optind], err ) || !rows.Build( hex, geo, err ) )
+    {
+        fprintf( stderr, "%s\n", err.c_str() );
+        return 1;
+    }
+
+    std::ofstream out( argv[optind + 1], std::ios::binary );
+    out.write( (const char *)rows.Data().data(), rows.Data().size() );
+    if ( !out )
+    {
+        perror( argv[optind + 1] );
+        return 1;
+    }
+
+        // 8N1, ten bit times per byte
+    printf( "device   IDCODE 0x%07x, %u byte rows\n", geo.DevID, geo.RowBytes );
+    printf( "image    %zu bytes, %u rows sent, %u blank rows skipped\n", hex.ByteCount(), rows.Rows(), rows.BlankRows() );
+    printf( "hex      %zu bytes, %.1f s at %lu baud\n", hexSize, hexSize * 10.0 / baud, baud );
+    printf( "rows     %zu bytes, %.1f s at %lu baud\n", rows.Data().size(), rows.Data().size() * 10.0 / baud, baud );
+    return 0;
+}
@@ -0,0 +1,268 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+/*
+ * p32send: streams a binary file to one of the sketch's stream modes
+ * with RXStreamByte() flow control, echoing what the sketch prints.
+ *
+ *   p32send -d /dev/ttyUSB0 [-b baud] [-n max_baud] [-w prompt] [-q] -c S session.xsvf
+ *   p32send -d /dev/ttyUSB0 [-b baud] [-w prompt] -r firmware.hex
+ *
+ * -w is the text to wait for before sending the -c command character,
+ * by default the start prompt. Exits 0 if the sketch reported "OK".
+ *
+ * -r resumes a broken off HEX session ('r'). The sketch reports its
+ * checkpoint record, and only the file from that record on is sent,
+ * after the type 02/04 record in force there, so a failure costs the
+ * rest of the file instead of all of it. Records are counted as the
+ * sketch counts them, by their ':'. Exits 0 on "Done!".
+ *
+ * -n picks up a station that remembers a faster rate, and asks it for
+ * the fastest rate up to max_baud its link passes (LinkSpeed.h).
+ *
+ * -q switches the menu to quiet mode ('m') first and follows the status
+ * frames instead of the text; the exit code then comes from the final
+ * frame.
+ */
+#include "CreditStream.h"
+#include "LinkSpeed.h"
+#include "SerialPort.h"
+#include "StatusFrame.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+static void Usage()
+{
+    fprintf( stderr, "usage: p32send -d <port> [-b baud] [-n max_baud] [-w prompt] [-q] -c <cmd> <file>\n"
+                     "       p32send -d <port> [-b baud] [-n max_baud] [-w prompt] -r <file.hex>\n" );
+    exit( 2 );
+}
+
+    // The HEX file cut into records, each from its ':' to the next one
+static std::vector<std::string> HexRecords(const std::vector<uint8_t> & data)
+{
+    std::vector<std::string> records;
+
+    for ( uint8_t c : data )
+    {
+        if ( c == ':' || records.empty() )
+        {
+            records.push_back( std::string() );
+        }
+        records.back() += (char)c;
+    }
+    if ( !records.empty() && records.front()[0] != ':' )
+    {
+        records.erase( records.begin() );
+    }
+    return records;
+}
+
+    // 'r' with the file from the sketch's checkpoint record on
+static int Resume(SerialPort & serial, CreditStream & stream, const std::vector<uint8_t> & data)
+{
+    static const char found[] = "Resume after line ";
+    std::vector<std::string> records = HexRecords( data );
+    std::string answer = "\r", tail;
+    size_t      at;
+    unsigned long line;
+
+    serial.Write( "r", 1 );
+    if ( !stream.WaitFor( "Start line", 5000 ) ||
+         ( at = stream.Text().rfind( found ) ) == std::string::npos )
+    {
+        fprintf( stderr, "\nNo checkpoint to resume from\n" );
+        return 1;
+    }
+    line = strtoul( stream.Text().c_str() + at + sizeof(found) - 1, 0, 10 );
+
+    if ( line > 1 && line <= records.size() )
+    {
+            // 16 bit addresses if no address record comes before it
+        std::string base = ":020000040000FA\r\n";
+        for ( size_t i = 0; i + 1 < line; ++i )
+        {
+            if ( records[i].size() > 9 &&
+                 ( !records[i].compare( 7, 2, "02" ) || !records[i].compare( 7, 2, "04" ) ) )
+            {
+                base = records[i];
+            }
+        }
+        tail = base;
+        for ( size_t i = line - 1; i < records.size(); ++i )
+        {
+            tail += records[i];
+        }
+        answer = std::to_string( line ) + "\r";
+        fprintf( stderr, "\nResuming at record %lu, %zu of %zu bytes\n", line, tail.size(), data.size() );
+    }
+    else
+    {
+        tail.assign( data.begin(), data.end() );
+    }
+
+    serial.Write( answer.data(), answer.size() );
+    if ( !stream.WaitFor( "hex -file now", 5000 ) )
+    {
+        fprintf( stderr, "\nNo file prompt\n" );
+        return 1;
+    }
+    serial.Write( tail.data(), tail.size() );
+    stream.WaitFor( "Done!", 30000 );
+    return stream.Text().find( "Done!" ) != std::string::npos ? 0 : 1;
+}
+
+static bool LastFrame(const std::string & text, StatusFrame & frame)
+{
+    std::vector<StatusFrame> frames = ParseStatusFrames( text );
+    if ( frames.empty() )
+    {
+        return false;
+    }
+    frame = frames.back();
+    return true;
+}
+
+static void ShowFrame(void * ctx, size_t, size_t)
+{
+    StatusFrame f;
+    if ( LastFrame( static_cast<CreditStream *>( ctx )->Text(), f ) )
+    {
+        printf( "\r%-8s 0x%08x %8u bytes", f.PhaseName(), f.Addr, f.Done );
+        fflush( stdout );
+    }
+}
+
+static bool Finished(const std::string & text)
+{
+    StatusFrame f;
+    return LastFrame( text, f ) && f.Final();
+}
+
+int main(int argc, char ** argv)
+{
+    std::string port, prompt = "to start!", cmd;
+    unsigned long baud = LINK_BASE_BAUD, maxBaud = 0;
+    bool quiet = false, resume = false;
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "d:b:n:w:qc:r" ) ) != -1 )
+    {
+        switch ( opt )
+        {
+            case 'd': port    = optarg; break;
+            case 'b': baud    = strtoul( optarg, 0, 0 ); break;
+            case 'n': maxBaud = strtoul( optarg, 0, 0 ); break;
+            case 'w': prompt  = optarg; break;
+            case 'q': quiet   = true; break;
+            case 'c': cmd     = optarg; break;
+            case 'r': resume  = true; break;
+            default:  Usage();
+        }
+    }
+    if ( port.empty() || cmd.empty() == !resume || ( resume && quiet ) || optind != argc - 1 )
+    {
+        Usage();
+    }
+
+    std::ifstream in( argv[optind], std::ios::binary );
+    if ( !in )
+    {
+        perror( argv[optind] );
+        return 1;
+    }
+    std::vector<uint8_t> data( (std::istreambuf_iterator<char>( in )), std::istreambuf_iterator<char>() );
+
+    SerialPort serial;
+    if ( !serial.Open( port, baud ) )
+    {
+        perror( port.c_str() );
+        return 1;
+    }
+
+    if ( maxBaud )
+    {
+        baud = LinkAttach( serial );
+        if ( baud < maxBaud && serial.WaitFor( "to start!", 15000 ) )
+        {
+            baud = LinkNegotiate( serial, baud, maxBaud );
+        }
+        fprintf( stderr, "%s at %lu baud\n", port.c_str(), baud );
+    }
+
+    CreditStream stream( serial, !quiet );
+    if ( !prompt.empty() && !stream.WaitFor( prompt.c_str(), 15000 ) )
+    {
+        fprintf( stderr, "No \"%s\" from %s\n", prompt.c_str(), port.c_str() );
+        return 1;
+    }
+
+    if ( resume )
+    {
+        return Resume( serial, stream, data );
+    }
+
+    if ( quiet )
+    {
+        cmd = "m" + cmd;
+    }
+    serial.Write( cmd.data(), cmd.size() );
+    if ( !stream.Send( data.data(), data.size(), 10000, quiet ? ShowFrame : 0, &stream ) )
+    {
+        fprintf( stderr, "\nProgrammer stopped taking data\n" );
+        return 1;
+    }
+
+    if ( quiet )
+    {
+        StatusFrame f;
+        stream.WaitUntil( Finished, 30000 );
+        ShowFrame( &stream, 0, 0 );
+        printf( "\n" );
+        if ( !LastFrame( stream.Text(), f ) || !f.Final() )
+        {
+            fprintf( stderr, "No final status frame\n" );
+            return 1;
+        }
+        if ( f.Error )
+        {
+            fprintf( stderr, "Failed, error %u near 0x%08x\n", f.Error, f.Addr );
+        }
+        return f.Error ? 1 : 0;
+    }
+
+    stream.WaitFor( "OK", 30000 );
+    return stream.Text().find( "OK" ) != std::string::npos ? 0 : 1;
+}
@@ -0,0 +1,237 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+/*
+ * pic32bridge: runs Pic32JTAGDevice on the host against a sketch in
+ * bridge mode (JTAGBridge.h). The Arduino only shifts bit vectors.
+ *
+ *   pic32bridge -d /dev/ttyUSB0 [-b baud] [-e] [-p file.hex] [-v file.hex]
+ */
+#include "HostJTAG.h"
+#include "BridgeLink.h"
+#include "IntelHex.h"
+#include "SerialPort.h"
+
+#include "Pic32JTAGDevice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdexcept>
+#include <string>
+
+static void Usage()
+{
+    fprintf( stderr,
+        "usage: pic32bridge -d <port> [-b baud] [-e] [-p file.hex] [-v file.hex]\n"
+        "   -e  MCHP_ERASE the chip\n"
+        "   -p  program (and verify) an image\n"
+        "   -v  verify only\n" );
+    exit( 2 );
+}
+
+    // Calls fn once for every 'step' byte aligned chunk that holds image
+    // data, with its step/4 words (holes 0xFF filled)
+static bool ForEachChunk(const IntelHex & hex, uint32_t step,
+                         bool (*fn)(void *, uint32_t, const uint32_t *), void * ctx)
+{
+    uint32_t next = 0;
+
+    for ( IntelHex::Extents::const_iterator it = hex.Data().begin(); it != hex.Data().end(); ++it )
+    {
+        uint32_t start = it->first & ~( step - 1 );
+        uint32_t end   = it->first + it->second.size();
+
+            // Extents closer than a chunk share it
+        if ( it != hex.Data().begin() && start < next )
+        {
+            start = next;
+        }
+        for ( uint32_t a = start; a < end; a += step )
+        {
+            uint32_t words[4];
+            for ( uint32_t k = 0; k < step / 4; ++k )
+            {
+                hex.Word( a + 4 * k, words[k] );
+            }
+            if ( !fn( ctx, a, words ) )
+            {
+                return false;
+            }
+            next = a + step;
+        }
+    }
+    return true;
+}
+
+    // With the family's widest write, words already erased are skipped
+static bool ProgramChunk(void * ctx, uint32_t addr, const uint32_t * words)
+{
+    Pic32JTAGDevice & pic32 = *static_cast<Pic32JTAGDevice *>(ctx);
+    for ( uint32_t k = 0; k < pic32.GetWriteBytes() / 4u; ++k )
+    {
+        if ( words[k] != 0xffffffff )
+        {
+            pic32.WriteWide( addr, words );
+            break;
+        }
+    }
+    return true;
+}
+
+static bool VerifyWord(void * ctx, uint32_t addr, const uint32_t * words)
+{
+    Pic32JTAGDevice & pic32 = *static_cast<Pic32JTAGDevice *>(ctx);
+    uint32_t word = words[0];
+    uint32_t fdata = pic32.ReadFlashData( addr );
+    if ( fdata != word )
+    {
+        fprintf( stderr, "Verify failed at 0x%08X 0x%08X <> 0x%08X\n", addr, fdata, word );
+        return false;
+    }
+    return true;
+}
+
+int main(int argc, char ** argv)
+{
+    std::string port, pgmFile, verFile;
+    unsigned long baud = 1200;
+    bool erase = false;
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "d:b:ep:v:" ) ) != -1 )
+    {
+        switch ( opt )
+        {
+            case 'd': port  = optarg; break;
+            case 'b': baud  = strtoul( optarg, 0, 0 ); break;
+            case 'e': erase = true; break;
+            case 'p': pgmFile = optarg; break;
+            case 'v': verFile = optarg; break;
+            default:  Usage();
+        }
+    }
+    if ( port.empty() )
+    {
+        Usage();
+    }
+
+    IntelHex hex;
+    std::string err;
+    const std::string & image = pgmFile.empty() ? verFile : pgmFile;
+    if ( !image.empty() && !hex.Load( image, err ) )
+    {
+        fprintf( stderr, "%s\n", err.c_str() );
+        return 1;
+    }
+
+    SerialPort serial;
+    if ( !serial.Open( port, baud ) )
+    {
+        perror( port.c_str() );
+        return 1;
+    }
+    if ( !serial.WaitFor( "to start!", 15000 ) )
+    {
+        fprintf( stderr, "No ArduPIC32 prompt on %s\n", port.c_str() );
+        return 1;
+    }
+    usleep( 100000 );
+    serial.Discard();
+
+    BridgeLink link( serial );
+    if ( !link.Enter() )
+    {
+        fprintf( stderr, "Programmer did not enter bridge mode\n" );
+        return 1;
+    }
+    ArduinoJTAG::SetBackend( &link );
+
+    unsigned long t0 = millis();
+    int rc = 0;
+
+    try
+    {
+        Pic32JTAGDevice pic32;
+
+        printf( "DeviceID:      0x%08X\n", pic32.GetDeviceID() );
+        printf( "Detected:      PIC32%s%s\n", pic32.GetFamilyName(), pic32.GetDeviceName() );
+        printf( "Row size:      %uB\n", pic32.GetRowSize() );
+
+        if ( erase )
+        {
+            printf( "MCHP_ERASE\n" );
+            pic32.JTAGErase();
+        }
+
+        if ( !image.empty() )
+        {
+            if ( pic32.NeedsErase() )
+            {
+                fprintf( stderr, "Code protected, needs -e\n" );
+                rc = 1;
+            }
+            else
+            {
+                pic32.EnterPgmMode();
+                pic32.FlashOperation( NVMOP_NOP, 0, 0 );
+
+                if ( !pgmFile.empty() )
+                {
+                    printf( "Programming %zu bytes\n", hex.ByteCount() );
+                    ForEachChunk( hex, pic32.GetWriteBytes(), ProgramChunk, &pic32 );
+                }
+                if ( !ForEachChunk( hex, 4, VerifyWord, &pic32 ) )
+                {
+                    rc = 1;
+                }
+                else
+                {
+                    printf( "Verify OK\n" );
+                }
+                pic32.ExitPgmMode();
+            }
+        }
+
+        pic32.SetReset( false );
+        link.Leave();
+    }
+    catch ( const std::exception & e )
+    {
+        fprintf( stderr, "%s\n", e.what() );
+        return 1;
+    }
+
+    printf( "%lu frames in %lu batches, %lu poll timeouts, %lu ms\n",
+            link.Frames(), link.Flushes(), link.PollTimeouts(), millis() - t0 );
+    if ( link.PollTimeouts() )
+    {
+        rc = 1;
+    }
+    return rc;
+}
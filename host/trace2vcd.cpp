@@ -0,0 +1,287 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+/*
+ * trace2vcd: converts the sketch's scan trace dump ('T', JTAGTrace.h)
+ * into a VCD file for a waveform viewer.
+ *
+ *   trace2vcd [-p period_ns] dump.txt > trace.vcd
+ *
+ * The dump can be a whole terminal log, the last "Trace" block in it is
+ * used. Every entry is one TCK period, -p sets its length (default
+ * 1000 ns, see 'k' for the station's actual rate). Besides the pins the
+ * file has the scan kind from the markers and the TAP state, which is
+ * followed from the first marker on (scans start in Run-Test/Idle) or
+ * from five TMS high clocks (Test-Logic-Reset).
+ */
+#include "JTAGTrace.h"
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <ctype.h>
+#include <unistd.h>
+#include <fstream>
+#include <string>
+#include <vector>
+
+enum tap_state_e {
+    TAP_RESET, TAP_IDLE,
+    TAP_SELECT_DR, TAP_CAPTURE_DR, TAP_SHIFT_DR, TAP_EXIT1_DR,
+    TAP_PAUSE_DR, TAP_EXIT2_DR, TAP_UPDATE_DR,
+    TAP_SELECT_IR, TAP_CAPTURE_IR, TAP_SHIFT_IR, TAP_EXIT1_IR,
+    TAP_PAUSE_IR, TAP_EXIT2_IR, TAP_UPDATE_IR,
+    TAP_UNKNOWN
+};
+
+    // Next state for TMS low / high
+static const uint8_t TapNext[16][2] = {
+    { TAP_IDLE,       TAP_RESET     },  // Test-Logic-Reset
+    { TAP_IDLE,       TAP_SELECT_DR },  // Run-Test/Idle
+    { TAP_CAPTURE_DR, TAP_SELECT_IR },
+    { TAP_SHIFT_DR,   TAP_EXIT1_DR  },
+    { TAP_SHIFT_DR,   TAP_EXIT1_DR  },
+    { TAP_PAUSE_DR,   TAP_UPDATE_DR },
+    { TAP_PAUSE_DR,   TAP_EXIT2_DR  },
+    { TAP_SHIFT_DR,   TAP_UPDATE_DR },
+    { TAP_IDLE,       TAP_SELECT_DR },
+    { TAP_CAPTURE_IR, TAP_RESET     },
+    { TAP_SHIFT_IR,   TAP_EXIT1_IR  },
+    { TAP_SHIFT_IR,   TAP_EXIT1_IR  },
+    { TAP_PAUSE_IR,   TAP_UPDATE_IR },
+    { TAP_PAUSE_IR,   TAP_EXIT2_IR  },
+    { TAP_SHIFT_IR,   TAP_UPDATE_IR },
+    { TAP_IDLE,       TAP_SELECT_DR },
+};
+
+struct Trace
+{
+    std::vector<uint8_t> Entries;
+    unsigned long        Dropped = 0;
+};
+
+static void Usage()
+{
+    fprintf( stderr, "usage: trace2vcd [-p period_ns] <dump.txt>\n" );
+    exit( 2 );
+}
+
+static bool HexLine(const std::string & line, std::vector<uint8_t> & out)
+{
+    if ( line.empty() || line.size() % 2 )
+    {
+        return false;
+    }
+    for ( char c: line )
+    {
+        if ( !isxdigit( (unsigned char)c ) )
+        {
+            return false;
+        }
+    }
+    for ( size_t i = 0; i < line.size(); i += 2 )
+    {
+        out.push_back( strtoul( line.substr( i, 2 ).c_str(), NULL, 16 ) );
+    }
+    return true;
+}
+
+    // Keeps the last complete dump in the file
+static bool ReadDump(std::istream & in, Trace & trace)
+{
+    std::string line;
+    Trace cur;
+    bool inDump = false, found = false;
+
+    while ( std::getline( in, line ) )
+    {
+        while ( !line.empty() && isspace( (unsigned char)line.back() ) )
+        {
+            line.pop_back();
+        }
+
+        unsigned long count, dropped;
+        if ( sscanf( line.c_str(), "Trace %lu %lu", &count, &dropped ) == 2 )
+        {
+            cur = Trace();
+            cur.Dropped = dropped;
+            inDump = true;
+        }
+        else if ( inDump && line == "End of trace" )
+        {
+            trace  = cur;
+            found  = true;
+            inDump = false;
+        }
+        else if ( inDump && !HexLine( line, cur.Entries ) )
+        {
+            fprintf( stderr, "trace2vcd: bad dump line '%s'\n", line.c_str() );
+            inDump = false;
+        }
+    }
+    return found;
+}
+
+static void Bits(char id, unsigned value, unsigned width)
+{
+    putchar( 'b' );
+    if ( value == TAP_UNKNOWN )
+    {
+        putchar( 'x' );
+    }
+    else
+    {
+        for ( unsigned b = width; b--; )
+        {
+            putchar( (value >> b) & 1 ? '1' : '0' );
+        }
+    }
+    printf( " %c\n", id );
+}
+
+    // Value changes only, everything on the first entry
+static void Pin(char id, int last, uint8_t e, uint8_t bit)
+{
+    if ( last < 0 || ((last ^ e) & bit) )
+    {
+        printf( "%c%c\n", e & bit ? '1' : '0', id );
+    }
+}
+
+static void WriteVCD(const Trace & trace, unsigned periodNs)
+{
+    printf( "$comment ArduPIC32 scan trace, %zu entries, %lu dropped before $end\n",
+            trace.Entries.size(), trace.Dropped );
+    printf( "$comment scan: 1 IR, 2 DR, 3 TMS sequence $end\n" );
+    printf( "$comment tap: 0 Reset 1 Idle 2-8 SelectDR..UpdateDR 9-15 SelectIR..UpdateIR $end\n" );
+    printf( "$timescale 1ns $end\n" );
+    printf( "$scope module jtag $end\n" );
+    printf( "$var wire 1 c tck $end\n" );
+    printf( "$var wire 1 m tms $end\n" );
+    printf( "$var wire 1 i tdi $end\n" );
+    printf( "$var wire 1 o tdo $end\n" );
+    printf( "$var wire 1 r mclr $end\n" );
+    printf( "$var wire 2 s scan $end\n" );
+    printf( "$var wire 4 t tap $end\n" );
+    printf( "$upscope $end\n" );
+    printf( "$enddefinitions $end\n" );
+
+    unsigned long time = 0;
+    unsigned half = periodNs / 2;
+    uint8_t  scan = 0, tap = TAP_UNKNOWN, highs = 0;
+    int      last = -1, lastScan = -1, lastTap = -1;
+
+    for ( uint8_t e: trace.Entries )
+    {
+        if ( e & TRACE_MARKER )
+        {
+            scan = e & 0x03;
+            if ( scan != TRACE_SCAN_TMS )
+            {
+                tap = TAP_IDLE;
+            }
+            continue;
+        }
+
+        bool tms = e & TRACE_TMS_BIT;
+
+            // Falling edge, TMS/TDI as driven and TDO as sampled for
+            // the rising edge that follows
+        printf( "#%lu\n0c\n", time );
+        Pin( 'm', last, e, TRACE_TMS_BIT );
+        Pin( 'i', last, e, TRACE_TDI_BIT );
+        Pin( 'o', last, e, TRACE_TDO_BIT );
+        Pin( 'r', last, e, TRACE_MCLR_BIT );
+        if ( scan != lastScan )
+        {
+            Bits( 's', scan, 2 );
+            lastScan = scan;
+        }
+        last = e;
+        time += half;
+
+            // Rising edge, the TAP moves on
+        if ( tap != TAP_UNKNOWN )
+        {
+            tap = TapNext[tap][tms];
+        }
+        highs = tms ? highs + 1 : 0;
+        if ( highs >= 5 )
+        {
+            tap = TAP_RESET;
+        }
+        printf( "#%lu\n1c\n", time );
+        if ( tap != lastTap )
+        {
+            Bits( 't', tap, 4 );
+            lastTap = tap;
+        }
+        time += periodNs - half;
+    }
+    printf( "#%lu\n", time );
+}
+
+int main(int argc, char ** argv)
+{
+    unsigned periodNs = 1000;
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "p:" ) ) != -1 )
+    {
+        switch ( opt )
+        {
+            case 'p':
+                periodNs = strtoul( optarg, NULL, 0 );
+                break;
+            default:
+                Usage();
+        }
+    }
+    if ( optind + 1 != argc || periodNs < 2 )
+    {
+        Usage();
+    }
+
+    std::ifstream in( argv[optind] );
+    if ( !in )
+    {
+        perror( argv[optind] );
+        return 1;
+    }
+
+    Trace trace;
+    if ( !ReadDump( in, trace ) )
+    {
+        fprintf( stderr, "trace2vcd: no complete trace dump in %s\n", argv[optind] );
+        return 1;
+    }
+
+    WriteVCD( trace, periodNs );
+    return 0;
+}
@@ -0,0 +1,207 @@
+/*
+ Copyright (c) 2012-2017, Tuomo Eljas Kaikkonen
+ All rights reserved.
+
+ Redistribution and use in source and binary forms, with or without
+ modification, are permitted provided that the following conditions are met:
+
+ 1. Redistributions of source code must retain the above copyright notice, this
+    list of conditions and the following disclaimer.
+ 2. Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+
+ THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS" AND
+ ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE IMPLIED
+ WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE ARE
+ DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE LIABLE FOR
+ ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES
+ (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES;
+ LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND
+ ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT
+ (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+
+ The views and conclusions contained in the software and documentation are those
+ of the authors and should not be interpreted as representing official policies,
+ either expressed or implied, of the FreeBSD Project.
+*/
+
+/*
+ * xsvfgen: precomputes a whole programming session for XsvfPlayer.h.
+ *
+ * Pic32JTAGDevice is run against XsvfWriter, so the stream contains
+ * exactly the scans the sketch itself would do. Every result the sketch
+ * would check is turned into a TDO compare:
+ *   - IDCODE of the Pic32DevIDList entry (revision bits masked)
+ *   - MCHP_STATUS ready, and not code protected unless erasing
+ *   - NVMCON error bits after every flash write
+ *   - the written data on verify
+ *
+ *   xsvfgen -t 795F512H [-e] [-p file.hex | -v file.hex] -o out.xsvf
+ */
+#include "HostJTAG.h"
+#include "IntelHex.h"
+#include "XsvfWriter.h"
+
+#include "Pic32JTAGDevice.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <stdexcept>
+#include <string>
+
+static void Usage()
+{
+    fprintf( stderr,
+        "usage: xsvfgen -t <device> [-e] [-p file.hex | -v file.hex] -o out.xsvf\n"
+        "   -t  device name as in Pic32.h, e.g. 795F512H\n"
+        "   -e  MCHP_ERASE the chip first\n"
+        "   -p  program and verify an image\n"
+        "   -v  verify only\n" );
+    exit( 2 );
+}
+
+static bool FindDevice(const char * name, Pic32DevID_t & dev)
+{
+    for ( int n = 0; Pic32DevIDList[n].DevID; ++n )
+    {
+        if ( !strcasecmp( Pic32DevIDList[n].DevName, name ) )
+        {
+            dev = Pic32DevIDList[n];
+            return true;
+        }
+    }
+    return false;
+}
+
+int main(int argc, char ** argv)
+{
+    std::string device, pgmFile, verFile, outFile;
+    bool erase = false;
+    int opt;
+
+    while ( ( opt = getopt( argc, argv, "t:ep:v:o:" ) ) != -1 )
+    {
+        switch ( opt )
+        {
+            case 't': device  = optarg; break;
+            case 'e': erase   = true; break;
+            case 'p': pgmFile = optarg; break;
+            case 'v': verFile = optarg; break;
+            case 'o': outFile = optarg; break;
+            default:  Usage();
+        }
+    }
+    if ( device.empty() || outFile.empty() )
+    {
+        Usage();
+    }
+
+    Pic32DevID_t dev;
+    if ( !FindDevice( device.c_str(), dev ) )
+    {
+        fprintf( stderr, "Unknown device %s\n", device.c_str() );
+        return 1;
+    }
+
+    IntelHex hex;
+    std::string err;
+    const std::string & image = pgmFile.empty() ? verFile : pgmFile;
+    if ( !image.empty() && !hex.Load( image, err ) )
+    {
+        fprintf( stderr, "%s\n", err.c_str() );
+        return 1;
+    }
+
+    XsvfWriter xsvf;
+    ArduinoJTAG::SetBackend( &xsvf );
+
+    try
+    {
+        uint32_t statusMask = CFGRDY | FCBUSY | ( erase ? 0 : CPS );
+
+            // CheckStatus() and AutoDetect() in the constructor
+        xsvf.ExpectNext( CFGRDY | CPS, statusMask, 255, 10000 );
+        xsvf.ExpectNext( dev.DevID, 0x0FFFFFFF );
+        Pic32JTAGDevice pic32;
+
+        if ( erase )
+        {
+            xsvf.ExpectNext( 0, 0 );                                // MCHP_ERASE
+            xsvf.ExpectNext( CFGRDY, CFGRDY | FCBUSY, 255, 10000 ); // done
+            pic32.JTAGErase();
+        }
+
+        if ( !image.empty() )
+        {
+            pic32.EnterPgmMode();
+            pic32.FlashOperation( NVMOP_NOP, 0, 0 );
+
+            uint32_t next = 0;
+            for ( IntelHex::Extents::const_iterator it = hex.Data().begin(); it != hex.Data().end(); ++it )
+            {
+                uint32_t end = it->first + it->second.size();
+                uint32_t a, w;
+
+                if ( !pgmFile.empty() )
+                {
+                        // Family's widest write; extents closer than
+                        // that share a chunk, written once
+                    uint32_t step = pic32.GetWriteBytes();
+                    a = it->first & ~( step - 1 );
+                    if ( it != hex.Data().begin() && a < next )
+                    {
+                        a = next;
+                    }
+                    for ( ; a < end; a += step )
+                    {
+                        uint32_t words[4];
+                        bool     blank = true;
+                        for ( uint32_t k = 0; k < step / 4; ++k )
+                        {
+                            hex.Word( a + 4 * k, words[k] );
+                            blank &= words[k] == 0xffffffff;
+                        }
+                        next = a + step;
+                        if ( blank )
+                        {
+                            continue;   // erased already
+                        }
+                        xsvf.ExpectNext( 0, 0x3000 );   // NVMCON WRERR, LVDERR
+                        pic32.WriteWide( a, words );
+                    }
+                }
+
+                for ( a = it->first & ~3u; a < end; a += 4 )
+                {
+                    hex.Word( a, w );
+                    xsvf.ExpectNext( w, 0xffffffff );
+                    pic32.ReadFlashData( a );
+                }
+            }
+            pic32.ExitPgmMode();
+        }
+        pic32.SetReset( false );
+        xsvf.Complete();
+    }
+    catch ( const std::exception & e )
+    {
+        fprintf( stderr, "%s\n", e.what() );
+        return 1;
+    }
+
+    FILE * f = fopen( outFile.c_str(), "wb" );
+    if ( !f || fwrite( xsvf.Data().data(), 1, xsvf.Data().size(), f ) != xsvf.Data().size() )
+    {
+        perror( outFile.c_str() );
+        return 1;
+    }
+    fclose( f );
+
+    printf( "PIC32%s%s, %zu image bytes, %zu XSVF bytes\n", Pic32FamilyList[dev.Family].Prefix,
+            dev.DevName, hex.ByteCount(), xsvf.Data().size() );
+    return 0;
+}